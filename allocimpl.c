@@ -0,0 +1,588 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+
+/*
+ * allocators of the kinds that take over from malloc on hot paths,
+ * for malloc and malloctrace to measure beside it:
+ *
+ *	pool	objects of one size, the largest the benchmark asks for
+ *	slab	objects in 32 size classes, 16 bytes to 8k
+ *
+ * both keep a free list per thread per class, and trade batches of
+ * objects with a list shared under a lock when it runs dry or grows
+ * long.  Objects are carved from 64k chunks with a header at the
+ * start saying what they hold, so a free finds its class by masking
+ * the address; anything bigger or more aligned gets a chunk of its
+ * own.  Chunks are never given back.
+ *
+ *	arena	each thread bumps a pointer through chunks of its own;
+ *		free does nothing, and reset rewinds the thread's arena
+ *		to the start, to be used once all its blocks are dead
+ */
+
+#include <sys/types.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "libmicro.h"
+#include "allocimpl.h"
+
+#define	CHUNK			(64 * 1024)
+#define	REGION			(16 * CHUNK)	/* chunks got at once */
+#define	HDR			64		/* chunk header */
+#define	BATCH			32
+#define	NCLASSES		32
+#define	POOL			NCLASSES	/* its class */
+#define	LARGE			-1
+#define	ARENA			(1024 * 1024)
+#define	ALIGN			16
+
+#define	CHUNKOF(p)	((chunk_t *)((unsigned long)(p) & ~(CHUNK - 1UL)))
+#define	ROUND(n, a)	(((n) + (a) - 1) & ~((size_t)(a) - 1))
+
+typedef struct {
+	int			ch_class;	/* or LARGE */
+	size_t			ch_size;	/* LARGE */
+} chunk_t;
+
+typedef struct obj {
+	struct obj		*o_next;
+} obj_t;
+
+/* the objects of one size that no thread holds */
+typedef struct {
+	pthread_mutex_t		cl_lock;
+	obj_t			*cl_free;
+	size_t			cl_size;
+} class_t;
+
+typedef struct {
+	obj_t			*c_free;
+	int			c_count;
+} cache_t;
+
+typedef struct achunk {
+	struct achunk		*ac_next;
+	char			*ac_end;
+} achunk_t;
+
+typedef struct {
+	achunk_t		*a_first;
+	achunk_t		*a_chunk;
+	char			*a_cur;
+	char			*a_end;
+} arena_t;
+
+static class_t			classes[NCLASSES + 1];
+static __thread cache_t		caches[NCLASSES + 1];
+static __thread arena_t		arena;
+
+static pthread_mutex_t		regionlock = PTHREAD_MUTEX_INITIALIZER;
+static char			*region;
+static char			*regionend;
+
+/*
+ * 16 to 128 by 16s, then each power of two split in four
+ */
+static int
+sizeclass(size_t size)
+{
+	size_t			s = size - 1;
+	int			msb;
+
+	if (size <= 128) {
+		return (size == 0 ? 0 : (int)(s / 16));
+	}
+
+	for (msb = 7; (s >> (msb + 1)) != 0; msb++)
+		;
+
+	return (8 + (msb - 7) * 4 + (int)((s >> (msb - 2)) & 3));
+}
+
+static size_t
+classsize(int c)
+{
+	if (c < 8) {
+		return ((c + 1) * 16);
+	}
+
+	return ((size_t)(4 + (c - 8) % 4 + 1) << (7 + (c - 8) / 4 - 2));
+}
+
+static void
+classinit(size_t poolsize)
+{
+	int			c;
+
+	for (c = 0; c <= NCLASSES; c++) {
+		(void) pthread_mutex_init(&classes[c].cl_lock, NULL);
+		classes[c].cl_size = c < NCLASSES ? classsize(c) :
+		    ROUND(poolsize ? poolsize : 1, ALIGN);
+	}
+}
+
+/*
+ * a chunk of objects of the class, with the lock held
+ */
+static obj_t *
+carve(int c)
+{
+	size_t			size = classes[c].cl_size;
+	chunk_t			*ch;
+	obj_t			*head = NULL;
+	char			*p;
+
+	if (size > CHUNK - HDR) {
+		return (NULL);
+	}
+
+	(void) pthread_mutex_lock(&regionlock);
+	if (region == regionend) {
+		if (posix_memalign((void **)&region, CHUNK, REGION) != 0) {
+			region = regionend = NULL;
+			(void) pthread_mutex_unlock(&regionlock);
+			return (NULL);
+		}
+		regionend = region + REGION;
+	}
+	ch = (chunk_t *)region;
+	region += CHUNK;
+	(void) pthread_mutex_unlock(&regionlock);
+
+	ch->ch_class = c;
+	for (p = (char *)ch + HDR; p + size <= (char *)ch + CHUNK;
+	    p += size) {
+		((obj_t *)p)->o_next = head;
+		head = (obj_t *)p;
+	}
+
+	return (head);
+}
+
+/*
+ * fills an empty cache with a batch from the shared list, carving
+ * another chunk when that runs out
+ */
+static int
+refill(int c, cache_t *ca)
+{
+	class_t			*cl = &classes[c];
+	obj_t			*o;
+
+	(void) pthread_mutex_lock(&cl->cl_lock);
+	if (cl->cl_free == NULL) {
+		cl->cl_free = carve(c);
+	}
+	while (ca->c_count < BATCH && (o = cl->cl_free) != NULL) {
+		cl->cl_free = o->o_next;
+		o->o_next = ca->c_free;
+		ca->c_free = o;
+		ca->c_count++;
+	}
+	(void) pthread_mutex_unlock(&cl->cl_lock);
+
+	return (ca->c_count == 0 ? -1 : 0);
+}
+
+static void
+drain(int c, cache_t *ca)
+{
+	class_t			*cl = &classes[c];
+	obj_t			*o;
+	int			i;
+
+	(void) pthread_mutex_lock(&cl->cl_lock);
+	for (i = 0; i < BATCH; i++) {
+		o = ca->c_free;
+		ca->c_free = o->o_next;
+		o->o_next = cl->cl_free;
+		cl->cl_free = o;
+	}
+	ca->c_count -= BATCH;
+	(void) pthread_mutex_unlock(&cl->cl_lock);
+}
+
+static void *
+class_alloc(int c)
+{
+	cache_t			*ca = &caches[c];
+	obj_t			*o;
+
+	if (ca->c_free == NULL && refill(c, ca) == -1) {
+		return (NULL);
+	}
+	o = ca->c_free;
+	ca->c_free = o->o_next;
+	ca->c_count--;
+
+	return (o);
+}
+
+/*
+ * a chunk of its own, the block align bytes in, and at least far
+ * enough for the header
+ */
+static void *
+large_alloc(size_t size, size_t align)
+{
+	size_t			off = align > HDR ? align : HDR;
+	chunk_t			*ch;
+
+	if (off >= CHUNK || posix_memalign((void **)&ch, CHUNK,
+	    off + size) != 0) {
+		return (NULL);
+	}
+	ch->ch_class = LARGE;
+	ch->ch_size = size;
+
+	return ((char *)ch + off);
+}
+
+static void
+chunk_free(void *p)
+{
+	chunk_t			*ch;
+	cache_t			*ca;
+	int			c;
+
+	if (p == NULL) {
+		return;
+	}
+	ch = CHUNKOF(p);
+	if ((c = ch->ch_class) == LARGE) {
+		free(ch);
+		return;
+	}
+
+	ca = &caches[c];
+	((obj_t *)p)->o_next = ca->c_free;
+	ca->c_free = p;
+	if (++ca->c_count >= 2 * BATCH) {
+		drain(c, ca);
+	}
+}
+
+static size_t
+chunk_size(void *p)
+{
+	chunk_t			*ch = CHUNKOF(p);
+
+	return (ch->ch_class == LARGE ? ch->ch_size :
+	    classes[ch->ch_class].cl_size);
+}
+
+static void *
+chunk_realloc(void *p, size_t size, void *(*alloc)(size_t))
+{
+	size_t			old;
+	void			*q;
+
+	if (p == NULL) {
+		return (alloc(size));
+	}
+	if ((old = chunk_size(p)) >= size) {
+		return (p);
+	}
+	if ((q = alloc(size)) != NULL) {
+		(void) memcpy(q, p, old);
+		chunk_free(p);
+	}
+
+	return (q);
+}
+
+static void *
+chunk_calloc(size_t n, size_t size, void *(*alloc)(size_t))
+{
+	void			*p;
+
+	if (size != 0 && n > (size_t)-1 / size) {
+		return (NULL);
+	}
+	if ((p = alloc(n * size)) != NULL) {
+		(void) memset(p, 0, n * size);
+	}
+
+	return (p);
+}
+
+static int
+chunk_memalign(void **pp, size_t align, size_t size,
+    void *(*alloc)(size_t))
+{
+	if (align <= ALIGN) {
+		*pp = alloc(size);
+	} else {
+		*pp = large_alloc(size, align);
+	}
+
+	return (*pp == NULL ? ENOMEM : 0);
+}
+
+/*
+ * requests above the pool's size get a chunk of their own, as
+ * they would be sent to malloc; so does everything if the pool's
+ * objects are too big to carve out of a chunk
+ */
+static void *
+pool_malloc(size_t size)
+{
+	if (size > classes[POOL].cl_size ||
+	    classes[POOL].cl_size > CHUNK - HDR) {
+		return (large_alloc(size, ALIGN));
+	}
+
+	return (class_alloc(POOL));
+}
+
+static void *
+pool_calloc(size_t n, size_t size)
+{
+	return (chunk_calloc(n, size, pool_malloc));
+}
+
+static int
+pool_memalign(void **pp, size_t align, size_t size)
+{
+	return (chunk_memalign(pp, align, size, pool_malloc));
+}
+
+static void *
+pool_realloc(void *p, size_t size)
+{
+	return (chunk_realloc(p, size, pool_malloc));
+}
+
+static void *
+slab_malloc(size_t size)
+{
+	if (size > classsize(NCLASSES - 1)) {
+		return (large_alloc(size, ALIGN));
+	}
+
+	return (class_alloc(sizeclass(size)));
+}
+
+static void *
+slab_calloc(size_t n, size_t size)
+{
+	return (chunk_calloc(n, size, slab_malloc));
+}
+
+static int
+slab_memalign(void **pp, size_t align, size_t size)
+{
+	return (chunk_memalign(pp, align, size, slab_malloc));
+}
+
+static void *
+slab_realloc(void *p, size_t size)
+{
+	return (chunk_realloc(p, size, slab_malloc));
+}
+
+/*
+ * a block of the arena, aligned, with its size in the ALIGN bytes
+ * before it; the chunks are kept for after a reset, and one is
+ * slipped in for anything too big for the next
+ */
+static void *
+arena_bump(size_t size, size_t align)
+{
+	arena_t			*a = &arena;
+	achunk_t		*ac;
+	char			*p;
+	size_t			len;
+
+	for (;;) {
+		p = (char *)ROUND((unsigned long)a->a_cur + ALIGN, align);
+		if (a->a_cur != NULL && p + size <= a->a_end) {
+			break;
+		}
+
+		len = sizeof (achunk_t) + ALIGN + align + size;
+		if (a->a_chunk != NULL && (ac = a->a_chunk->ac_next) != NULL &&
+		    ac->ac_end - (char *)ac >= len) {
+			a->a_chunk = ac;
+		} else {
+			len = len > ARENA ? len : ARENA;
+			if ((ac = malloc(len)) == NULL) {
+				return (NULL);
+			}
+			ac->ac_end = (char *)ac + len;
+			if (a->a_chunk == NULL) {
+				ac->ac_next = a->a_first;
+				a->a_first = ac;
+			} else {
+				ac->ac_next = a->a_chunk->ac_next;
+				a->a_chunk->ac_next = ac;
+			}
+			a->a_chunk = ac;
+		}
+		a->a_cur = (char *)(ac + 1);
+		a->a_end = ac->ac_end;
+	}
+
+	((size_t *)p)[-1] = size;
+	a->a_cur = p + size;
+
+	return (p);
+}
+
+static void *
+arena_malloc(size_t size)
+{
+	return (arena_bump(size, ALIGN));
+}
+
+static void *
+arena_calloc(size_t n, size_t size)
+{
+	void			*p;
+
+	if (size != 0 && n > (size_t)-1 / size) {
+		return (NULL);
+	}
+	if ((p = arena_bump(n * size, ALIGN)) != NULL) {
+		(void) memset(p, 0, n * size);
+	}
+
+	return (p);
+}
+
+static int
+arena_memalign(void **pp, size_t align, size_t size)
+{
+	*pp = arena_bump(size, align > ALIGN ? align : ALIGN);
+
+	return (*pp == NULL ? ENOMEM : 0);
+}
+
+/*
+ * the thread's latest block grows where it is
+ */
+static void *
+arena_realloc(void *p, size_t size)
+{
+	size_t			old;
+	void			*q;
+
+	if (p == NULL) {
+		return (arena_bump(size, ALIGN));
+	}
+	old = ((size_t *)p)[-1];
+	if ((char *)p + old == arena.a_cur &&
+	    (char *)p + size <= arena.a_end) {
+		((size_t *)p)[-1] = size;
+		arena.a_cur = (char *)p + size;
+		return (p);
+	}
+	if (old >= size) {
+		return (p);
+	}
+	if ((q = arena_bump(size, ALIGN)) != NULL) {
+		(void) memcpy(q, p, old);
+	}
+
+	return (q);
+}
+
+/*ARGSUSED*/
+static void
+arena_free(void *p)
+{
+}
+
+static void
+arena_reset()
+{
+	arena.a_chunk = arena.a_first;
+	arena.a_cur = arena.a_first == NULL ? NULL :
+	    (char *)(arena.a_first + 1);
+	arena.a_end = arena.a_first == NULL ? NULL : arena.a_first->ac_end;
+}
+
+static int
+libc_memalign(void **pp, size_t align, size_t size)
+{
+	return (posix_memalign(pp, align, size));
+}
+
+allocimpl_t			allocimpls[] = {
+	{ "libc", malloc, calloc, libc_memalign, realloc, free, NULL },
+	{ "pool", pool_malloc, pool_calloc, pool_memalign, pool_realloc,
+	    chunk_free, NULL },
+	{ "slab", slab_malloc, slab_calloc, slab_memalign, slab_realloc,
+	    chunk_free, NULL },
+	{ "arena", arena_malloc, arena_calloc, arena_memalign,
+	    arena_realloc, arena_free, arena_reset },
+	{ NULL }
+};
+
+/*
+ * the allocator called name, with the pool's objects made maxsize
+ * bytes; call before the workers start
+ */
+allocimpl_t *
+allocimpl_find(char *name, size_t maxsize)
+{
+	allocimpl_t		*ai;
+
+	for (ai = allocimpls; ai->ai_name != NULL; ai++) {
+		if (strcmp(name, ai->ai_name) == 0) {
+			classinit(maxsize);
+			return (ai);
+		}
+	}
+
+	(void) printf("ERROR: -i %s isn't an allocator\n", name);
+
+	return (NULL);
+}
+
+/*
+ * libc|pool|slab|arena, for usage messages
+ */
+char *
+allocimpl_names()
+{
+	static char		names[64];
+	allocimpl_t		*ai;
+
+	names[0] = '\0';
+	for (ai = allocimpls; ai->ai_name != NULL; ai++) {
+		if (ai != allocimpls) {
+			(void) strcat(names, "|");
+		}
+		(void) strcat(names, ai->ai_name);
+	}
+
+	return (names);
+}
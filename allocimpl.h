@@ -0,0 +1,51 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef ALLOCIMPL_H
+#define	ALLOCIMPL_H
+
+#include <sys/types.h>
+
+/*
+ * allocators to set against libc's malloc, shared by malloc and
+ * malloctrace
+ */
+
+typedef struct {
+	char			*ai_name;
+	void			*(*ai_malloc)(size_t);
+	void			*(*ai_calloc)(size_t, size_t);
+	int			(*ai_memalign)(void **, size_t, size_t);
+	void			*(*ai_realloc)(void *, size_t);
+	void			(*ai_free)(void *);
+	void			(*ai_reset)(void);	/* NULL if none */
+} allocimpl_t;
+
+extern allocimpl_t		allocimpls[];
+
+allocimpl_t	*allocimpl_find(char *name, size_t maxsize);
+char		*allocimpl_names(void);
+
+#endif /* ALLOCIMPL_H */
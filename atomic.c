@@ -29,46 +29,304 @@
  */
 
 /*
- * benchmarks atomic add on Solaris - useful for platform comparisons.
+ * atomic operations on a counter, with the gcc __atomic builtins
+ * so they're available everywhere: fetch-and-add (the default,
+ * as Solaris atomic_add_32_nv() used to be), a compare-and-swap
+ * increment loop, exchange, load and store, each under any memory
+ * order that makes sense for it; the counter is one cache line
+ * shared by all -P/-T workers, or with -p one line per worker
  */
 
+#include <sys/types.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <atomic.h>
+#include <string.h>
 
 #include "libmicro.h"
 
+#define	LINE			64
+
+typedef struct {
+	unsigned		l_val;
+	char			l_pad[LINE - sizeof (unsigned)];
+} line_t;
+
+typedef struct {
+	line_t			ts_pad0;	/* keep the neighbours off */
+	line_t			ts_line;
+	line_t			ts_pad1;
+	unsigned		*ts_val;
+	long long		ts_ops;
+	long long		ts_fails;
+} tsd_t;
+
+static char			*ops[] = {
+	"add", "cas", "xchg", "load", "store", NULL
+};
+#define	OP_ADD			0
+#define	OP_CAS			1
+#define	OP_XCHG			2
+#define	OP_LOAD			3
+#define	OP_STORE		4
+
+static char			*orders[] = {
+	"relaxed", "acquire", "release", "acq_rel", "seq_cst", NULL
+};
+
+static int			optp = 0;
+static int			opto = __ATOMIC_SEQ_CST;
+static int			optx = OP_ADD;
+static line_t			*shared;
+
+#define	TEN(x)		x; x; x; x; x; x; x; x; x; x
+#define	LOOP(x)							\
+	for (i = 0; i < lm_optB; i += 10) {				\
+		TEN(x);							\
+	}
+
+/* the ops, on p, in benchmark() */
+#define	ADD(mo)		(void) __atomic_fetch_add(p, 1, mo)
+#define	CAS(mo)								\
+	v = __atomic_load_n(p, __ATOMIC_RELAXED);			\
+	while (!__atomic_compare_exchange_n(p, &v, v + 1, 0, mo,	\
+	    __ATOMIC_RELAXED))						\
+		fails++
+#define	XCHG(mo)	(void) __atomic_exchange_n(p, i, mo)
+#define	LOAD(mo)	v += __atomic_load_n(p, mo)
+#define	STORE(mo)	__atomic_store_n(p, i, mo)
+
+int lookup(char *x, char **names);
+
 int
 benchmark_init()
 {
-	(void) sprintf(lm_usage, "note: measures atomic_add_32_nv()");
+	lm_tsdsize = sizeof (tsd_t);
+
+	lm_defB = 10000;
+
+	(void) sprintf(lm_optstr, "o:px:");
+
+	(void) sprintf(lm_usage,
+	    "       [-o relaxed|acquire|release|acq_rel|seq_cst "
+	    "(default seq_cst)]\n"
+	    "       [-p] (a padded line per worker, not one shared line)\n"
+	    "       [-x add|cas|xchg|load|store (default add)]\n"
+	    "notes: measures one atomic op on a 32 bit counter; loads\n"
+	    "       can't release and stores can't acquire; fail/op is\n"
+	    "       how often a cas lost to another worker and retried\n");
+
+	(void) sprintf(lm_header, "%5s %7s %6s %8s",
+	    "op", "order", "line", "fail/op");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	switch (opt) {
+	case 'o':
+		/* __ATOMIC_RELAXED and so on are 0 to 5, with consume 1 */
+		opto = lookup(optarg, orders);
+		if (opto == -1) {
+			return (-1);
+		}
+		if (opto > 0) {
+			opto++;
+		}
+		break;
+	case 'p':
+		optp = 1;
+		break;
+	case 'x':
+		optx = lookup(optarg, ops);
+		if (optx == -1) {
+			return (-1);
+		}
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+int
+benchmark_initrun()
+{
+	if ((optx == OP_LOAD && (opto == __ATOMIC_RELEASE ||
+	    opto == __ATOMIC_ACQ_REL)) ||
+	    (optx == OP_STORE && (opto == __ATOMIC_ACQUIRE ||
+	    opto == __ATOMIC_ACQ_REL))) {
+		(void) printf("ERROR: no %s with that memory order\n",
+		    ops[optx]);
+		return (-1);
+	}
 
-	lm_tsdsize = 0;
+	/* shared with the workers of every process */
+	/*LINTED*/
+	shared = (line_t *)mmap(NULL, getpagesize(), PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_ANON, -1, 0L);
+	if (shared == MAP_FAILED) {
+		perror("mmap");
+		return (-1);
+	}
 
 	return (0);
 }
 
-static unsigned int value = 0;
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	ts->ts_val = optp ? &ts->ts_line.l_val : &shared->l_val;
+
+	return (0);
+}
 
-/*ARGSUSED*/
 int
 benchmark(void *tsd, result_t *res)
 {
-	unsigned int			i;
-	for (i = 0; i < lm_optB; i += 10) {
-		(void) atomic_add_32_nv(&value, 1);
-		(void) atomic_add_32_nv(&value, 1);
-		(void) atomic_add_32_nv(&value, 1);
-		(void) atomic_add_32_nv(&value, 1);
-		(void) atomic_add_32_nv(&value, 1);
-		(void) atomic_add_32_nv(&value, 1);
-		(void) atomic_add_32_nv(&value, 1);
-		(void) atomic_add_32_nv(&value, 1);
-		(void) atomic_add_32_nv(&value, 1);
-		(void) atomic_add_32_nv(&value, 1);
+	tsd_t			*ts = (tsd_t *)tsd;
+	unsigned		*p = ts->ts_val;
+	unsigned		v;
+	long long		fails = 0;
+	int			i = 0;
+
+	/* the order has to be a constant for the builtins to honour it */
+	switch (optx) {
+	case OP_ADD:
+		switch (opto) {
+		case __ATOMIC_RELAXED:
+			LOOP(ADD(__ATOMIC_RELAXED));
+			break;
+		case __ATOMIC_ACQUIRE:
+			LOOP(ADD(__ATOMIC_ACQUIRE));
+			break;
+		case __ATOMIC_RELEASE:
+			LOOP(ADD(__ATOMIC_RELEASE));
+			break;
+		case __ATOMIC_ACQ_REL:
+			LOOP(ADD(__ATOMIC_ACQ_REL));
+			break;
+		default:
+			LOOP(ADD(__ATOMIC_SEQ_CST));
+			break;
+		}
+		break;
+	case OP_CAS:
+		switch (opto) {
+		case __ATOMIC_RELAXED:
+			LOOP(CAS(__ATOMIC_RELAXED));
+			break;
+		case __ATOMIC_ACQUIRE:
+			LOOP(CAS(__ATOMIC_ACQUIRE));
+			break;
+		case __ATOMIC_RELEASE:
+			LOOP(CAS(__ATOMIC_RELEASE));
+			break;
+		case __ATOMIC_ACQ_REL:
+			LOOP(CAS(__ATOMIC_ACQ_REL));
+			break;
+		default:
+			LOOP(CAS(__ATOMIC_SEQ_CST));
+			break;
+		}
+		break;
+	case OP_XCHG:
+		switch (opto) {
+		case __ATOMIC_RELAXED:
+			LOOP(XCHG(__ATOMIC_RELAXED));
+			break;
+		case __ATOMIC_ACQUIRE:
+			LOOP(XCHG(__ATOMIC_ACQUIRE));
+			break;
+		case __ATOMIC_RELEASE:
+			LOOP(XCHG(__ATOMIC_RELEASE));
+			break;
+		case __ATOMIC_ACQ_REL:
+			LOOP(XCHG(__ATOMIC_ACQ_REL));
+			break;
+		default:
+			LOOP(XCHG(__ATOMIC_SEQ_CST));
+			break;
+		}
+		break;
+	case OP_LOAD:
+		v = 0;
+		switch (opto) {
+		case __ATOMIC_RELAXED:
+			LOOP(LOAD(__ATOMIC_RELAXED));
+			break;
+		case __ATOMIC_ACQUIRE:
+			LOOP(LOAD(__ATOMIC_ACQUIRE));
+			break;
+		default:
+			LOOP(LOAD(__ATOMIC_SEQ_CST));
+			break;
+		}
+		/* so the loads aren't thrown away */
+		ts->ts_pad0.l_val = v;
+		break;
+	case OP_STORE:
+		switch (opto) {
+		case __ATOMIC_RELAXED:
+			LOOP(STORE(__ATOMIC_RELAXED));
+			break;
+		case __ATOMIC_RELEASE:
+			LOOP(STORE(__ATOMIC_RELEASE));
+			break;
+		default:
+			LOOP(STORE(__ATOMIC_SEQ_CST));
+			break;
+		}
+		break;
 	}
 	res->re_count = i;
 
+	ts->ts_ops += i;
+	ts->ts_fails += fails;
+
 	return (0);
 }
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	tsd_t			*ts;
+	long long		nops = 0;
+	long long		fails = 0;
+	int			p, t;
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			nops += ts->ts_ops;
+			fails += ts->ts_fails;
+		}
+	}
+
+	(void) sprintf(result, "%5s %7s %6s %8.3f",
+	    ops[optx], orders[opto > 0 ? opto - 1 : 0],
+	    optp ? "padded" : "shared",
+	    nops ? (double)fails / (double)nops : 0.0);
+
+	return (result);
+}
+
+int
+lookup(char *x, char **names)
+{
+	int			i;
+
+	for (i = 0; names[i] != NULL; i++) {
+		if (strcmp(x, names[i]) == 0) {
+			return (i);
+		}
+	}
+
+	return (-1);
+}
@@ -157,7 +157,46 @@ memset		$OPTS -N "memset_10m"	-s 10m -I 2000000
 memset		$OPTS -N "memsetP2_10m"	-s 10m -P 2 -I 2000000 
 
 memrand		$OPTS -N "memrand"	-s 128m -B 10000
+memrand		$OPTS -N "memrand_line"	-s 128m -B 10000 -x line
+memrand		$OPTS -N "memrand_page"	-s 128m -B 10000 -x page
+memrand		$OPTS -N "memrand_mlp4"	-s 128m -B 10000 -x line -c 4
+memrand		$OPTS -N "memrand_huge"	-s 128m -B 10000 -x line -h
+memrand		$OPTS -N "memrand_sweep"	-s 1m -B 10000 -x line -m 1g
+memrand		$OPTS -N "memrand_tlb"	-s 1m -B 10000 -x page -m 1g
+stream		$OPTS -N "stream_copy"	-x copy
+stream		$OPTS -N "stream_scale"	-x scale
+stream		$OPTS -N "stream_add"	-x add
+stream		$OPTS -N "stream_triad"	-x triad
+stream		$OPTS -N "stream_read"	-x read
+stream		$OPTS -N "stream_write"	-x write
+stream		$OPTS -N "stream_triad_nt"	-x triad -n
+stream		$OPTS -N "stream_triad_sc"	-x triad -i scalar
+stream		$OPTS -N "stream_triad_T2"	-x triad -T 2
+stream		$OPTS -N "stream_triad_T4"	-x triad -T 4
+atomic		$OPTS -N "atomic_add"
+atomic		$OPTS -N "atomic_add_rlx"	-o relaxed
+atomic		$OPTS -N "atomic_cas"	-x cas
+atomic		$OPTS -N "atomic_xchg"	-x xchg
+atomic		$OPTS -N "atomic_load"	-x load
+atomic		$OPTS -N "atomic_load_acq"	-x load	-o acquire
+atomic		$OPTS -N "atomic_store"	-x store
+atomic		$OPTS -N "atomic_store_rel"	-x store -o release
+atomic		$OPTS -N "atomic_add_T4"	-T 4
+atomic		$OPTS -N "atomic_add_T4p"	-T 4	-p
+atomic		$OPTS -N "atomic_cas_T4"	-x cas	-T 4
+atomic		$OPTS -N "atomic_cas_T4p"	-x cas	-T 4	-p
+
+falseshare	$OPTS -N "fs_d8_T4"	-d 8	-T 4
+falseshare	$OPTS -N "fs_d64_T4"	-d 64	-T 4
+falseshare	$OPTS -N "fs_d128_T4"	-d 128	-T 4
+falseshare	$OPTS -N "fs_d4k_T4"	-d 4k	-T 4
+falseshare	$OPTS -N "fs_d8_T4_r90"	-d 8	-T 4 -r 90
+falseshare	$OPTS -N "fs_d128_T4_r90"	-d 128	-T 4 -r 90
+falseshare	$OPTS -N "fs_d8_T4_a"	-d 8	-T 4 -a
+falseshare	$OPTS -N "fs_d128_T4_a"	-d 128	-T 4 -a
 cachetocache	$OPTS -N "cachetocache" -s 100k -T 2 -I 200
+cachetocache	$OPTS -N "c2c_matrix"	-s 100k -T 2 -I 200 -m
+cachetocache	$OPTS -N "c2c_matrix_rfo"	-s 4k -T 2 -I 200 -m -x rfo
 
 isatty		$OPTS -N "isatty_yes"   
 isatty		$OPTS -N "isatty_no"  -f $IFILE
@@ -174,6 +213,22 @@ malloc		$OPTS -N "mallocT2_1k"    -s 1k   -g 10 -T 2 -I 200
 malloc		$OPTS -N "mallocT2_10k"   -s 10k  -g 10 -T 2 -I 200
 malloc		$OPTS -N "mallocT2_100k"  -s 100k -g 10 -T 2 -I 10000
 
+malloc		$OPTS -N "malloc_pool_100"	-s 100	-g 10 -i pool	-I 50
+malloc		$OPTS -N "malloc_slab_100"	-s 100	-g 10 -i slab	-I 50
+malloc		$OPTS -N "malloc_arena_100"	-s 100	-g 10 -i arena	-I 50
+malloc		$OPTS -N "malloc_slab_mix"	-s 16 -s 100 -s 1k -s 4k -g 10 -i slab -I 50
+malloc		$OPTS -N "mallocT4_slab_100"	-s 100	-g 10 -i slab -T 4 -I 200
+
+malloctrace	$OPTS -N "mtrace_small"	-d log:16-1k -I 100000
+malloctrace	$OPTS -N "mtrace_mixed"	-d log:16-64k -a 5 -c 10 -r 20 -I 500000
+malloctrace	$OPTS -N "mtrace_long"	-l uniform:1000-9000 -I 200000
+malloctrace	$OPTS -N "mtrace_T4"	-T 4 -I 400000
+malloctrace	$OPTS -N "mtrace_T4_x50"	-T 4 -x 50 -I 800000
+malloctrace	$OPTS -N "mtrace_pool"	-d log:16-1k -i pool -I 100000
+malloctrace	$OPTS -N "mtrace_slab"	-d log:16-1k -i slab -I 100000
+malloctrace	$OPTS -N "mtrace_arena"	-d log:16-1k -i arena -I 100000
+malloctrace	$OPTS -N "mtrace_slab_T4"	-T 4 -x 50 -i slab -I 800000
+
 close		$OPTS -N "close_bad"		-B 32		-b
 close		$OPTS -N "close_tmp"		-B 32		-f $TFILE
 close		$OPTS -N "close_usr"		-B 32		-f $VFILE
@@ -184,21 +239,45 @@ memcpy		$OPTS -N "memcpy_1k"	-s 1k	-I 50
 memcpy		$OPTS -N "memcpy_10k"	-s 10k	-I 800
 memcpy		$OPTS -N "memcpy_1m"	-s 1m   -I 500000
 memcpy		$OPTS -N "memcpy_10m"	-s 10m  -I 5000000
+memcpy		$OPTS -N "memcpy_10k_rep"	-s 10k	-I 800 -i rep
+memcpy		$OPTS -N "memcpy_10k_avx2"	-s 10k	-I 800 -i avx2
+memcpy		$OPTS -N "memcpy_log4k"	-d log:1-4k -g uniform:0-63 -I 50
+memcpy		$OPTS -N "memcpy_sweep"	-s 1k	-I 50 -i all -l 16,64,256,1k,4k,64k,1m -o 0,1,33
+memmove		$OPTS -N "memmove_sweep"	-s 1k	-I 50 -i all -l 16,256,4k,64k
+memset		$OPTS -N "memset_sweep"	-s 1k	-I 100 -i all -l 16,256,4k,64k,1m -o 0,3
 
 strcpy		$OPTS -N "strcpy_10"	-s 10   -I 5 
 strcpy		$OPTS -N "strcpy_1k"	-s 1k   -I 100
+strcpy		$OPTS -N "strcpy_log1k"	-d log:1-1k -g uniform:0-15 -I 20
 
 strlen		$OPTS -N "strlen_10"	-s 10   -I 5
 strlen		$OPTS -N "strlen_1k"	-s 1k   -I 100
+strlen		$OPTS -N "strlen_log1k"	-d log:1-1k -g uniform:0-15 -I 20
 
 strchr		$OPTS -N "strchr_10"	-s 10   -I 5
 strchr		$OPTS -N "strchr_1k"	-s 1k   -I 200
+strchr		$OPTS -N "strchr_log1k"	-d log:1-1k -g uniform:0-15 -I 20
 strcmp		$OPTS -N "strcmp_10"	-s 10   -I 10
 strcmp		$OPTS -N "strcmp_1k"	-s 1k   -I 200
+strcmp		$OPTS -N "strcmp_log1k"	-d log:1-1k -g uniform:0-15 -I 20
 
 strcasecmp	$OPTS -N "scasecmp_10"	-s 10 -I 50
 strcasecmp	$OPTS -N "scasecmp_1k"	-s 1k -I 20000
 
+strsearch	$OPTS -N "memchr_1k"	-x memchr -s 1k -I 50
+strsearch	$OPTS -N "memrchr_1k"	-x memrchr -s 1k -I 50
+strsearch	$OPTS -N "rawmemchr_1k"	-x rawmemchr -m late -s 1k -I 50
+strsearch	$OPTS -N "memcmp_1k"	-x memcmp -s 1k -I 50
+strsearch	$OPTS -N "strnlen_1k"	-x strnlen -s 1k -I 50
+strsearch	$OPTS -N "strstr_1k"	-x strstr -s 1k -I 200
+strsearch	$OPTS -N "memmem_1k"	-x memmem -s 1k -I 200
+strsearch	$OPTS -N "strspn_1k"	-x strspn -s 1k -I 200
+strsearch	$OPTS -N "strcspn_1k"	-x strcspn -s 1k -I 200
+strsearch	$OPTS -N "strtok_r_1k"	-x strtok_r -s 1k -I 500
+strsearch	$OPTS -N "memchr_guard"	-x memchr -s 1k -e -I 50
+strsearch	$OPTS -N "memchr_sweep"	-x memchr -i all -m early,middle,late,none -l 16,256,4k,64k -I 50
+strsearch	$OPTS -N "strstr_sweep"	-x strstr -i all -m middle,none -l 64,1k,16k -I 200
+
 strtol		$OPTS -N "strtol"      -I 20      
 
 getcontext	$OPTS -N "getcontext"  -I 100
@@ -208,6 +287,31 @@ mutex		$OPTS -N "mutex_st"	-I 10
 mutex		$OPTS -N "mutex_mt"	-t -I 10	
 mutex		$OPTS -N "mutex_T2"     -T 2  -I 100
 
+locks		$OPTS -N "lk_mutex_T4"	-l mutex	-T 4 -c 100 -w 200
+locks		$OPTS -N "lk_adaptive_T4"	-l adaptive	-T 4 -c 100 -w 200
+locks		$OPTS -N "lk_spin_T4"	-l spin	-T 4 -c 100 -w 200
+locks		$OPTS -N "lk_ticket_T4"	-l ticket	-T 4 -c 100 -w 200
+locks		$OPTS -N "lk_mcs_T4"	-l mcs	-T 4 -c 100 -w 200
+locks		$OPTS -N "lk_clh_T4"	-l clh	-T 4 -c 100 -w 200
+locks		$OPTS -N "lk_futex_T4"	-l futex	-T 4 -c 100 -w 200
+locks		$OPTS -N "lk_rwlock_T4"	-l rwlock	-T 4 -c 100 -w 200
+locks		$OPTS -N "lk_rwlock_r90_T4"	-l rwlock	-T 4 -c 100 -w 200 -r 90
+locks		$OPTS -N "lk_mutex_T16"	-l mutex	-T 16 -c 100 -w 200
+locks		$OPTS -N "lk_mcs_T16"	-l mcs	-T 16 -c 100 -w 200
+locks		$OPTS -N "lk_futex_P4"	-l futex	-P 4 -c 100 -w 200
+
+queues		$OPTS -N "q_mutex_1x1"	-q mutex
+queues		$OPTS -N "q_spsc_1x1"	-q spsc
+queues		$OPTS -N "q_mpmc_1x1"	-q mpmc
+queues		$OPTS -N "q_treiber_1x1"	-q treiber
+queues		$OPTS -N "q_eventfd_1x1"	-q eventfd
+queues		$OPTS -N "q_mutex_4x4"	-q mutex	-T 4 -c 4
+queues		$OPTS -N "q_mutex_4x4_s2"	-q mutex	-T 4 -c 4 -s 2
+queues		$OPTS -N "q_mpmc_4x4"	-q mpmc	-T 4 -c 4
+queues		$OPTS -N "q_treiber_4x4"	-q treiber	-T 4 -c 4
+queues		$OPTS -N "q_eventfd_4x4"	-q eventfd	-T 4 -c 4
+queues		$OPTS -N "q_mpmc_4x4_a"	-q mpmc	-T 4 -c 4 -a
+
 longjmp		$OPTS -N "longjmp"	-I 10
 siglongjmp	$OPTS -N "siglongjmp"	-I 20
 
@@ -241,6 +345,21 @@ cascade_fcntl	$OPTS -N "c_fcntl_1"	-I 2000
 cascade_fcntl	$OPTS -N "c_fcntl_10"	-P 10 -I 20000
 cascade_fcntl	$OPTS -N "c_fcntl_200"	-P 200	-I 5000000
 
+futex		$OPTS -N "futex_pp_mt"	-x pingpong -m mt
+futex		$OPTS -N "futex_pp_mp"	-x pingpong -m mp
+futex		$OPTS -N "futex_waitv1"	-x waitv -n 1
+futex		$OPTS -N "futex_waitv64"	-x waitv -n 64
+futex		$OPTS -N "futex_wake0"	-x wake	-n 0
+futex		$OPTS -N "futex_wake8"	-x wake	-n 8
+futex		$OPTS -N "futex_wake8_mp"	-x wake	-n 8 -m mp
+futex		$OPTS -N "futex_wake64"	-x wake	-n 64
+futex		$OPTS -N "futex_rq8"	-x requeue -n 8
+futex		$OPTS -N "futex_rq64"	-x requeue -n 64
+futex		$OPTS -N "futex_pi"	-x pi
+futex		$OPTS -N "futex_pi_k"	-x pi	-k
+futex		$OPTS -N "futex_pi_T4"	-x pi	-T 4
+futex		$OPTS -N "futex_pi_P4"	-x pi	-P 4
+
 file_lock	$OPTS -N "file_lock"   -I 1000         
 
 getsockname	$OPTS -N "getsockname"	-I 100
@@ -271,6 +390,16 @@ open		$OPTS -N "open_zero"		-B 256		-f /dev/zero
 
 dup		$OPTS -N "dup"			-B 512   
 
+fdtable		$OPTS -N "fdt_dup"		-x dup
+fdtable		$OPTS -N "fdt_dup_10k"		-x dup		-n 10000
+fdtable		$OPTS -N "fdt_dup_10k_h8"	-x dup		-n 10000 -h 8
+fdtable		$OPTS -N "fdt_dup_10k_t4"	-x dup		-n 10000 -T 4
+fdtable		$OPTS -N "fdt_dup_10k_h8_t4"	-x dup		-n 10000 -h 8 -T 4
+fdtable		$OPTS -N "fdt_open_10k_t4"	-x open		-n 10000 -T 4
+fdtable		$OPTS -N "fdt_socket_10k_t4"	-x socket	-n 10000 -T 4
+fdtable		$OPTS -N "fdt_close_10k_t4"	-x close	-n 10000 -T 4
+fdtable		$OPTS -N "fdt_range_10k_t4"	-x range	-n 10000 -T 4
+
 socket		$OPTS -N "socket_u"		-B 256
 socket		$OPTS -N "socket_i"		-B 256		-f PF_INET
 
@@ -287,6 +416,7 @@ connection	$OPTS -N "connection"		-B 256
 poll		$OPTS -N "poll_10"	-n 10	-I 500
 poll		$OPTS -N "poll_100"	-n 100	-I 1000
 poll		$OPTS -N "poll_1000"	-n 1000	-I 5000
+poll		$OPTS -N "poll_10000"	-n 10000 -I 50000
 
 poll		$OPTS -N "poll_w10"	-n 10	-I 500		-w 1
 poll		$OPTS -N "poll_w100"	-n 100	-I 2000		-w 10
@@ -300,6 +430,25 @@ select		$OPTS -N "select_w10"	-n 10	-I 500		-w 1
 select		$OPTS -N "select_w100"	-n 100	-I 2000		-w 10
 select		$OPTS -N "select_w1000"	-n 1000	-I 40000        -w 100
 
+epoll		$OPTS -N "epoll_10"	-n 10	-I 500
+epoll		$OPTS -N "epoll_100"	-n 100	-I 500
+epoll		$OPTS -N "epoll_1000"	-n 1000	-I 500
+epoll		$OPTS -N "epoll_10000"	-n 10000	-I 500
+
+epoll		$OPTS -N "epoll_w10"	-n 10	-I 500		-w 1
+epoll		$OPTS -N "epoll_w100"	-n 100	-I 2000		-w 10
+epoll		$OPTS -N "epoll_w1000"	-n 1000	-I 20000	-w 100
+epoll		$OPTS -N "epoll_r1000"	-n 1000	-I 20000	-r 100
+epoll		$OPTS -N "epoll_r10000"	-n 10000 -I 20000	-r 100
+
+epoll		$OPTS -N "epoll_e1000"	-n 1000	-I 500		-r 100 -e
+epoll		$OPTS -N "epoll_e10000"	-n 10000 -I 500		-r 100 -e
+
+epoll		$OPTS -N "epoll_c100"	-n 100	-I 2000		-c
+epoll		$OPTS -N "epoll_c10000"	-n 10000 -I 2000	-c
+epoll		$OPTS -N "epoll_m100"	-n 100	-I 1000		-m
+epoll		$OPTS -N "epoll_m10000"	-n 10000 -I 1000	-m
+
 semop		$OPTS -N "semop" -I 200
 
 sigaction	$OPTS -N "sigaction" -I 100
@@ -389,6 +538,37 @@ pwrite		$OPTS -N "pwrite_n1k"	-s 1k	-I 100		-f /dev/null
 pwrite		$OPTS -N "pwrite_n10k"	-s 10k	-I 100		-f /dev/null 
 pwrite		$OPTS -N "pwrite_n100k"	-s 100k	-I 100		-f /dev/null 
 
+zerocopy	$OPTS -N "sendfile_4k"	-s 4k	-x sendfile	-f $TFILE
+zerocopy	$OPTS -N "sendfile_64k"	-s 64k	-x sendfile	-f $TFILE
+zerocopy	$OPTS -N "sendfile_1m"	-s 1m	-x sendfile	-f $TFILE
+zerocopy	$OPTS -N "sendfile_c64k"	-s 64k	-x sendfile -c	-f $TFILE
+zerocopy	$OPTS -N "splice_64k"	-s 64k	-x splice	-f $TFILE
+zerocopy	$OPTS -N "splicein_64k"	-s 64k	-x splicein	-f $TFILE
+zerocopy	$OPTS -N "splicein_c64k"	-s 64k	-x splicein -c	-f $TFILE
+zerocopy	$OPTS -N "vmsplice_64k"	-s 64k	-x vmsplice	-f $TFILE
+zerocopy	$OPTS -N "vmsplice_c64k"	-s 64k	-x vmsplice -c	-f $TFILE
+zerocopy	$OPTS -N "tee_64k"	-s 64k	-x tee		-f $TFILE
+zerocopy	$OPTS -N "tee_c64k"	-s 64k	-x tee -c	-f $TFILE
+zerocopy	$OPTS -N "cfr_64k"	-s 64k	-x cfr		-f $TFILE
+zerocopy	$OPTS -N "cfr_c64k"	-s 64k	-x cfr -c	-f $TFILE
+
+uring		$OPTS -N "uring_nop"	-x nop
+uring		$OPTS -N "uring_nop_q32"	-x nop	-q 32 -b 32
+uring		$OPTS -N "uring_nop_sqp"	-x nop	-q 32 -b 8 -p
+uring		$OPTS -N "uring_read1"	-x read	-s 4k	-q 1
+uring		$OPTS -N "uring_read32"	-x read	-s 4k	-q 32 -b 8
+uring		$OPTS -N "uring_dread1"	-x read	-s 4k	-q 1 -d
+uring		$OPTS -N "uring_dread32"	-x read	-s 4k	-q 32 -d
+uring		$OPTS -N "uring_dread256"	-x read	-s 4k	-q 256 -b 32 -d
+uring		$OPTS -N "uring_dread32_rk"	-x read	-s 4k	-q 32 -d -r -k
+uring		$OPTS -N "uring_dread32_p"	-x read	-s 4k	-q 32 -d -r -k -p
+uring		$OPTS -N "uring_write1"	-x write -s 4k	-q 1
+uring		$OPTS -N "uring_dwrite32"	-x write -s 4k	-q 32 -d
+uring		$OPTS -N "uring_send"	-x send	-s 4k	-q 1
+uring		$OPTS -N "uring_send16"	-x send	-s 4k	-q 16 -b 4 -r
+uring		$OPTS -N "uring_recv"	-x recv	-s 4k	-q 1
+uring		$OPTS -N "uring_recv16"	-x recv	-s 4k	-q 16 -b 4 -r
+
 mmap		$OPTS -N "mmap_z8k"	-l 8k   -I 1000		-f /dev/zero
 mmap		$OPTS -N "mmap_z128k"	-l 128k	-I 2000		-f /dev/zero
 mmap		$OPTS -N "mmap_t8k"	-l 8k	-I 1000		-f $TFILE
@@ -476,7 +656,111 @@ pipe		$OPTS -N "pipe_tst4k"	-s 4k	-I 1000	-x tcp  -m st
 pipe		$OPTS -N "pipe_tmt4k"	-s 4k	-I 8000	-x tcp  -m mt
 pipe		$OPTS -N "pipe_tmp4k"	-s 4k	-I 8000	-x tcp  -m mp
 
+pipe		$OPTS -N "pipe_pmtw16"	-s 4k	-I 2000	-x pipe -m mt -w 16
+pipe		$OPTS -N "pipe_smtw16"	-s 4k	-I 2000	-x sock -m mt -w 16
+pipe		$OPTS -N "pipe_tmtw16"	-s 4k	-I 2000	-x tcp  -m mt -w 16
+pipe		$OPTS -N "pipe_pmto"	-s 4k	-I 1000	-x pipe -m mt -o
+pipe		$OPTS -N "pipe_smto"	-s 4k	-I 1000	-x sock -m mt -o
+pipe		$OPTS -N "pipe_tmto"	-s 4k	-I 1000	-x tcp  -m mt -o
+
+pipe		$OPTS -N "pipe_est"	-I 1000	-x efd  -m st
+pipe		$OPTS -N "pipe_emt"	-I 8000	-x efd  -m mt
+pipe		$OPTS -N "pipe_emp"	-I 8000	-x efd  -m mp
+
+pipe		$OPTS -N "pipe_dmt1"	-s 1	-I 8000	-x dgrm -m mt
+pipe		$OPTS -N "pipe_dmp1"	-s 1	-I 8000	-x dgrm -m mp
+pipe		$OPTS -N "pipe_dmp4k"	-s 4k	-I 8000	-x dgrm -m mp
+
+pipe		$OPTS -N "pipe_qmt1"	-s 1	-I 8000	-x seqp -m mt
+pipe		$OPTS -N "pipe_qmp1"	-s 1	-I 8000	-x seqp -m mp
+pipe		$OPTS -N "pipe_qmp4k"	-s 4k	-I 8000	-x seqp -m mp
+
+pipe		$OPTS -N "pipe_umt1"	-s 1	-I 8000	-x udp  -m mt
+pipe		$OPTS -N "pipe_ump1"	-s 1	-I 8000	-x udp  -m mp
+pipe		$OPTS -N "pipe_ump4k"	-s 4k	-I 8000	-x udp  -m mp
+
+pipe		$OPTS -N "pipe_mmt1"	-s 1	-I 8000	-x mq   -m mt
+pipe		$OPTS -N "pipe_mmp1"	-s 1	-I 8000	-x mq   -m mp
+pipe		$OPTS -N "pipe_mmp4k"	-s 4k	-I 8000	-x mq   -m mp
+
+pipe		$OPTS -N "pipe_hmt1"	-s 1	-I 8000	-x shm  -m mt
+pipe		$OPTS -N "pipe_hmp1"	-s 1	-I 8000	-x shm  -m mp
+pipe		$OPTS -N "pipe_hmp4k"	-s 4k	-I 8000	-x shm  -m mp
+
+tcp_stream	$OPTS -N "tcps_4k"	-s 4k
+tcp_stream	$OPTS -N "tcps_64k"	-s 64k
+tcp_stream	$OPTS -N "tcps_1m"	-s 1m
+tcp_stream	$OPTS -N "tcps_64k_b64k"	-s 64k	-b 64k	-r 64k
+tcp_stream	$OPTS -N "tcps_64k_b4m"	-s 64k	-b 4m	-r 4m
+tcp_stream	$OPTS -N "tcps_z4k"	-s 4k	-z
+tcp_stream	$OPTS -N "tcps_z64k"	-s 64k	-z
+tcp_stream	$OPTS -N "tcps_z1m"	-s 1m	-z
+tcp_stream	$OPTS -N "tcps_c4k"	-s 4k	-c
+tcp_stream	$OPTS -N "tcps_zc64k"	-s 64k	-z -c
+tcp_stream	$OPTS -N "tcps_64k_T4"	-s 64k	-T 4
+tcp_stream	$OPTS -N "tcps_z64k_T4"	-s 64k	-z -T 4
+
+udp_batch	$OPTS -N "udp_to64"	-s 64
+udp_batch	$OPTS -N "udp_to64_b32"	-s 64	-b 32
+udp_batch	$OPTS -N "udp_mm64_b1"	-s 64	-b 1	-m
+udp_batch	$OPTS -N "udp_mm64_b8"	-s 64	-b 8	-m
+udp_batch	$OPTS -N "udp_mm64_b32"	-s 64	-b 32	-m
+udp_batch	$OPTS -N "udp_mm64_b256"	-s 64	-b 256	-m
+udp_batch	$OPTS -N "udp_mm64_b1024"	-s 64	-b 1024	-m
+udp_batch	$OPTS -N "udp_to1k"	-s 1k
+udp_batch	$OPTS -N "udp_mm1k_b32"	-s 1k	-b 32	-m
+udp_batch	$OPTS -N "udp_gso1k_b32"	-s 1k	-b 32	-g
+udp_batch	$OPTS -N "udp_to60k"	-s 60k
+udp_batch	$OPTS -N "udp_mm60k_b8"	-s 60k	-b 8	-m
+udp_batch	$OPTS -N "udp_mm64_b32_T4"	-s 64	-b 32	-m -T 4
+udp_batch	$OPTS -N "udp_mm64_b32_rT4"	-s 64	-b 32	-m -r -T 4
+udp_batch	$OPTS -N "udp_mm64_b32_rP4"	-s 64	-b 32	-m -r -P 4
+
+fdpass		$OPTS -N "scm_st1"	-x scm	-m st	-n 1
+fdpass		$OPTS -N "scm_mp1"	-x scm	-m mp	-n 1
+fdpass		$OPTS -N "scm_mp16"	-x scm	-m mp	-n 16
+fdpass		$OPTS -N "scm_mp253"	-x scm	-m mp	-n 253
+fdpass		$OPTS -N "scm_mp16_t1k"	-x scm	-m mp	-n 16 -t 1000
+fdpass		$OPTS -N "scm_mp16_t10k"	-x scm	-m mp	-n 16 -t 10000
+fdpass		$OPTS -N "pidfd_mp1"	-x pidfd -m mp	-n 1
+fdpass		$OPTS -N "pidfd_mp16"	-x pidfd -m mp	-n 16
+fdpass		$OPTS -N "pidfd_mp253"	-x pidfd -m mp	-n 253
+fdpass		$OPTS -N "pidfd_mp16_t10k"	-x pidfd -m mp	-n 16 -t 10000
+
 connection	$OPTS -N "conn_accept"		-B 256      -a
 
+connrate	$OPTS -N "connrate_1"		-m 1
+connrate	$OPTS -N "connrate_f1"		-m 1	-f
+connrate	$OPTS -N "connrate_t4m4"	-m 4	-T 4
+connrate	$OPTS -N "connrate_t4m4u"	-m 4	-T 4 -u
+connrate	$OPTS -N "connrate_t4m4uf"	-m 4	-T 4 -u -f
+connrate	$OPTS -N "connrate_p8m4q8"	-m 4	-P 8 -q 8
+
+herd		$OPTS -N "herd_accept4"		-n 4	-x accept
+herd		$OPTS -N "herd_accept64"	-n 64	-x accept
+herd		$OPTS -N "herd_shared4"		-n 4	-x shared
+herd		$OPTS -N "herd_shared64"	-n 64	-x shared
+herd		$OPTS -N "herd_each4"		-n 4	-x each
+herd		$OPTS -N "herd_each64"		-n 64	-x each
+herd		$OPTS -N "herd_excl4"		-n 4	-x excl
+herd		$OPTS -N "herd_excl64"		-n 64	-x excl
+herd		$OPTS -N "herd_reuse4"		-n 4	-x reuseport
+herd		$OPTS -N "herd_reuse64"		-n 64	-x reuseport
+
+rpc		$OPTS -N "rpc_thr_c1"	-x thread	-c 1
+rpc		$OPTS -N "rpc_thr_c16"	-x thread	-c 16
+rpc		$OPTS -N "rpc_thr_t4c4"	-x thread	-c 4 -T 4
+rpc		$OPTS -N "rpc_ep_c1"	-x epoll	-c 1
+rpc		$OPTS -N "rpc_ep_c16"	-x epoll	-c 16
+rpc		$OPTS -N "rpc_ep_t4c4"	-x epoll	-c 4 -T 4
+rpc		$OPTS -N "rpc_rp_c1"	-x reuseport -n 4	-c 1
+rpc		$OPTS -N "rpc_rp_c16"	-x reuseport -n 4	-c 16
+rpc		$OPTS -N "rpc_rp_t4c4"	-x reuseport -n 4	-c 4 -T 4
+rpc		$OPTS -N "rpc_ur_c1"	-x uring	-c 1
+rpc		$OPTS -N "rpc_ur_c16"	-x uring	-c 16
+rpc		$OPTS -N "rpc_ur_t4c4"	-x uring	-c 4 -T 4
+rpc		$OPTS -N "rpc_ep_4k"	-x epoll	-c 4 -s 4k
+rpc		$OPTS -N "rpc_ur_4k"	-x uring	-c 4 -s 4k
+
 close_tcp	$OPTS -N "close_tcp"		-B 32  
 .
@@ -0,0 +1,3 @@
+char * compiler_version = "12";
+char * CC = "gcc";
+char * extra_compiler_flags = "";
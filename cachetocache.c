@@ -29,25 +29,40 @@
  */
 
 /*
- * routine to benchmark cache-to-cache transfer times... uses
- * solaris features to find and bind to cpus in the current
- * processor set, so not likely to work elsewhere.
+ * routine to benchmark cache-to-cache transfer times... finds and
+ * binds to the cpus we may run on, from the processor set on
+ * Solaris and the affinity mask on Linux.
+ *
+ * On Linux, -m also measures every cpu against every other after
+ * the run, and prints the matrix ordered and grouped by package,
+ * shared L3 and core, with averages for each kind of pair.
  */
 
+#ifdef __linux__
+#define	_GNU_SOURCE
+#endif
 
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <fcntl.h>
 #include <string.h>
-#include <sys/processor.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <stdio.h>
 #include <errno.h>
+#ifdef __linux__
+#include <sched.h>
+#else
+#include <sys/processor.h>
 #include <sys/pset.h>
+#endif
 
 #include "libmicro.h"
 
+#define	MAXCPU			1024
+#define	LINE			64
+
 static long			opts = 1024*512;
 
 typedef struct {
@@ -56,10 +71,59 @@ typedef struct {
 	pthread_mutex_t		ts_lock;
 } tsd_t;
 
-static unsigned int ncpu = 1024;
+static unsigned int ncpu = MAXCPU;
+
+static tsd_t *thread_data[MAXCPU];
+
+#ifdef __linux__
+
+#define	DEFN_FLAG		1000
+#define	DEFN_RFO		20
+
+#define	PAIR_SMT		0
+#define	PAIR_L3			1
+#define	PAIR_PACKAGE		2
+#define	PAIR_REMOTE		3
+
+static char			*pairs[] = {
+	"smt sibling", "shared L3", "same package", "other package"
+};
+
+static char			*modes[] = {"flag", "rfo", NULL};
+#define	MD_FLAG			0
+#define	MD_RFO			1
+
+/* where a cpu sits; each is the lowest numbered cpu of the group */
+typedef struct {
+	int			tp_cpu;
+	int			tp_core;
+	int			tp_l3;
+	int			tp_package;
+} topo_t;
+
+/* what the far end of a matrix measurement needs */
+typedef struct {
+	int			pp_cpu;
+	int			pp_rounds;
+	int			pp_unbound;	/* set by the far end */
+} pingpong_t;
+
+static int			cpus[MAXCPU];
+static char			*optc = NULL;
+static int			optm = 0;
+static int			optn = 0;
+static int			optx = MD_FLAG;
+static int			*flag;		/* alone on its line */
+static long			*buf;		/* for rfo */
+
+static int bindcpu(int cpu);
+static void matrix();
+
+#else
 
-static tsd_t *thread_data[1024];
-static processorid_t cpus[1024];
+static processorid_t cpus[MAXCPU];
+
+#endif
 
 int traverse_ptrchain(long **, int, int);
 
@@ -68,6 +132,26 @@ benchmark_init()
 {
 	lm_tsdsize = sizeof (tsd_t);
 
+#ifdef __linux__
+	(void) sprintf(lm_optstr, "c:mn:s:x:");
+
+	(void) sprintf(lm_usage,
+	    "       [-c cpu-list] cpus to use, as 0-3,8"
+	    " (default all we may run on)\n"
+	    "       [-m] (print a cpu to cpu latency matrix after the run)\n"
+	    "       [-n rounds] per pair of cpus"
+	    " (default %d for flag, %d for rfo)\n"
+	    "       [-s size] size of access area in bytes"
+	    " (default %ld)\n"
+	    "       [-x flag|rfo] matrix of one flag bounced between the"
+	    " pair, or\n"
+	    "           of taking ownership of -s bytes written by the"
+	    " other (default flag)\n"
+	    "notes: measures cache to cache transfer times; the matrix"
+	    " is in nsecs,\n"
+	    "       one way for a flag and per line for rfo\n",
+	    DEFN_FLAG, DEFN_RFO, opts);
+#else
 	(void) sprintf(lm_optstr, "s:");
 
 	(void) sprintf(lm_usage,
@@ -75,6 +159,7 @@ benchmark_init()
 	    " (default %ld)\n"
 	    "notes: measures cache to cache transfer times on Solaris\n",
 	    opts);
+#endif
 
 	(void) sprintf(lm_header, "%8s", "size");
 
@@ -88,6 +173,27 @@ benchmark_optswitch(int opt, char *optarg)
 	case 's':
 		opts = sizetoint(optarg);
 		break;
+#ifdef __linux__
+	case 'c':
+		optc = optarg;
+		break;
+	case 'm':
+		optm = 1;
+		break;
+	case 'n':
+		optn = atoi(optarg);
+		break;
+	case 'x':
+		for (optx = 0; modes[optx] != NULL; optx++) {
+			if (strcmp(optarg, modes[optx]) == 0) {
+				break;
+			}
+		}
+		if (modes[optx] == NULL) {
+			return (-1);
+		}
+		break;
+#endif
 	default:
 		return (-1);
 	}
@@ -98,10 +204,33 @@ benchmark_optswitch(int opt, char *optarg)
 int
 benchmark_initrun()
 {
+#ifdef __linux__
+	cpu_set_t		set;
+	int			i;
+
+	if (optc != NULL) {
+		ncpu = cpulist(optc, cpus, MAXCPU);
+	} else {
+		if (sched_getaffinity(0, sizeof (set), &set) < 0) {
+			perror("sched_getaffinity");
+			return (1);
+		}
+		for (ncpu = 0, i = 0; i < CPU_SETSIZE && ncpu < MAXCPU; i++) {
+			if (CPU_ISSET(i, &set)) {
+				cpus[ncpu++] = i;
+			}
+		}
+	}
+	if (ncpu == 0) {
+		(void) printf("ERROR: no cpus to run on\n");
+		return (1);
+	}
+#else
 	if (pset_info(PS_MYID, NULL, &ncpu, cpus) < 0) {
 		perror("pset_info");
 		return (1);
 	}
+#endif
 
 	return (0);
 }
@@ -111,7 +240,7 @@ benchmark_initworker(void *tsd)
 {
 	tsd_t			*ts = (tsd_t *)tsd;
 	int i, j;
-	processorid_t cpu;
+	int cpu;
 
 	ts->ts_data = malloc(opts);
 
@@ -121,15 +250,20 @@ benchmark_initworker(void *tsd)
 
 	(void) pthread_mutex_init(&ts->ts_lock, NULL);
 
-
-	if (processor_bind(P_LWPID, P_MYID,
-	    cpu = cpus[(pthread_self() - 1) % ncpu],
-	    NULL) < 0) {
+	cpu = cpus[gettindex() % ncpu];
+#ifdef __linux__
+	if (bindcpu(cpu) < 0) {
+		perror("sched_setaffinity:");
+		return (1);
+	}
+#else
+	if (processor_bind(P_LWPID, P_MYID, cpu, NULL) < 0) {
 		perror("processor_bind:");
 		return (1);
 	}
+#endif
 
-	(void) printf("# thread %d using processor %d\n", pthread_self(), cpu);
+	(void) printf("# thread %d using processor %d\n", gettindex(), cpu);
 
 	/*
 	 * use lmbench style backwards stride
@@ -142,7 +276,7 @@ benchmark_initworker(void *tsd)
 		ts->ts_data[i] = (long *)&(ts->ts_data[j]);
 	}
 
-	thread_data[pthread_self() - 1] = ts;
+	thread_data[gettindex()] = ts;
 
 	return (0);
 }
@@ -206,7 +340,7 @@ traverse_ptrchain(long **ptr, int count, int value)
 		ptr = (long **)*ptr;
 		*ptr = *ptr + value;
 	}
-	return ((int)*ptr); /* bogus return */
+	return ((int)(long)*ptr); /* bogus return */
 }
 
 
@@ -220,3 +354,335 @@ benchmark_result()
 
 	return (result);
 }
+
+#ifdef __linux__
+
+int
+benchmark_finirun()
+{
+	if (optm) {
+		matrix();
+	}
+
+	return (0);
+}
+
+static int
+bindcpu(int cpu)
+{
+	cpu_set_t		set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+
+	return (sched_setaffinity(0, sizeof (set), &set));
+}
+
+/*
+ * the lowest cpu in a sysfs topology or cache list, or the value
+ * of a sysfs number
+ */
+static int
+sysfs(int cpu, char *file)
+{
+	char			path[256];
+	char			line[1024];
+	int			list[MAXCPU];
+	FILE			*fp;
+	int			i, n, lo;
+
+	(void) snprintf(path, sizeof (path),
+	    "/sys/devices/system/cpu/cpu%d/%s", cpu, file);
+	if ((fp = fopen(path, "r")) == NULL) {
+		return (-1);
+	}
+	n = fgets(line, sizeof (line), fp) ? cpulist(line, list, MAXCPU) : 0;
+	(void) fclose(fp);
+
+	for (lo = -1, i = 0; i < n; i++) {
+		if (lo == -1 || list[i] < lo) {
+			lo = list[i];
+		}
+	}
+
+	return (lo);
+}
+
+static void
+topology(int cpu, topo_t *tp)
+{
+	char			file[64];
+	int			i;
+
+	tp->tp_cpu = cpu;
+	tp->tp_package = sysfs(cpu, "topology/physical_package_id");
+	tp->tp_core = sysfs(cpu, "topology/thread_siblings_list");
+	tp->tp_l3 = -1;
+
+	for (i = 0; i < 10; i++) {
+		(void) sprintf(file, "cache/index%d/level", i);
+		if (sysfs(cpu, file) == 3) {
+			(void) sprintf(file,
+			    "cache/index%d/shared_cpu_list", i);
+			tp->tp_l3 = sysfs(cpu, file);
+			break;
+		}
+	}
+
+	/* missing levels stand in for one another */
+	if (tp->tp_core == -1) {
+		tp->tp_core = cpu;
+	}
+	if (tp->tp_l3 == -1) {
+		tp->tp_l3 = tp->tp_package;
+	}
+}
+
+static int
+topocmp(const void *a, const void *b)
+{
+	const topo_t		*x = a;
+	const topo_t		*y = b;
+
+	if (x->tp_package != y->tp_package) {
+		return (x->tp_package - y->tp_package);
+	}
+	if (x->tp_l3 != y->tp_l3) {
+		return (x->tp_l3 - y->tp_l3);
+	}
+	if (x->tp_core != y->tp_core) {
+		return (x->tp_core - y->tp_core);
+	}
+	return (x->tp_cpu - y->tp_cpu);
+}
+
+static int
+pairkind(topo_t *x, topo_t *y)
+{
+	if (x->tp_core == y->tp_core) {
+		return (PAIR_SMT);
+	}
+	if (x->tp_l3 == y->tp_l3) {
+		return (PAIR_L3);
+	}
+	if (x->tp_package == y->tp_package) {
+		return (PAIR_PACKAGE);
+	}
+	return (PAIR_REMOTE);
+}
+
+static void
+await(int value)
+{
+	int			spins = 0;
+
+	while (__atomic_load_n(flag, __ATOMIC_ACQUIRE) != value) {
+		relax(&spins);
+	}
+}
+
+/*
+ * the far end: for flag, answer each odd value with the next even
+ * one; for rfo, write the buffer and say so with an odd value, then
+ * wait for the near end to take it over and say so with an even one
+ */
+static void *
+responder(void *arg)
+{
+	pingpong_t		*pp = (pingpong_t *)arg;
+	int			lines = opts / LINE;
+	int			r, k;
+
+	/* keep answering even so, or the near end would wait forever */
+	pp->pp_unbound = bindcpu(pp->pp_cpu) < 0;
+
+	for (r = 0; r < pp->pp_rounds; r++) {
+		if (optx == MD_FLAG) {
+			await(2 * r + 1);
+		} else {
+			for (k = 0; k < lines; k++) {
+				buf[k * (LINE / sizeof (long))] = r;
+			}
+		}
+		__atomic_store_n(flag, 2 * r + (optx == MD_FLAG ? 2 : 1),
+		    __ATOMIC_RELEASE);
+		if (optx == MD_RFO) {
+			await(2 * r + 2);
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * nsecs one way for a flag, or per line for rfo, between the
+ * calling thread on cpu a and a responder on cpu b, or -1.0 if
+ * the pair can't be set up
+ */
+static double
+pingpong(int a, int b, int rounds)
+{
+	pthread_t		tid;
+	pingpong_t		pp;
+	int			warm = rounds / 10 + 1;
+	int			lines = opts / LINE;
+	long long		t0 = 0;
+	long long		nsecs = 0;
+	int			r, k;
+
+	*flag = 0;
+	pp.pp_cpu = b;
+	pp.pp_rounds = rounds + warm;
+	pp.pp_unbound = 0;
+
+	if (bindcpu(a) < 0 ||
+	    pthread_create(&tid, NULL, responder, &pp) != 0) {
+		return (-1.0);
+	}
+
+	for (r = 0; r < rounds + warm; r++) {
+		if (optx == MD_FLAG) {
+			if (r == warm) {
+				t0 = getnsecs();
+			}
+			__atomic_store_n(flag, 2 * r + 1, __ATOMIC_RELEASE);
+			await(2 * r + 2);
+		} else {
+			await(2 * r + 1);
+			t0 = getnsecs();
+			for (k = 0; k < lines; k++) {
+				buf[k * (LINE / sizeof (long))] = -r;
+			}
+			if (r >= warm) {
+				nsecs += getnsecs() - t0;
+			}
+			__atomic_store_n(flag, 2 * r + 2, __ATOMIC_RELEASE);
+		}
+	}
+	if (optx == MD_FLAG) {
+		nsecs = getnsecs() - t0;
+	}
+
+	(void) pthread_join(tid, NULL);
+
+	if (pp.pp_unbound) {
+		return (-1.0);
+	}
+	if (optx == MD_FLAG) {
+		return ((double)nsecs / rounds / 2);
+	}
+	return ((double)nsecs / rounds / (lines ? lines : 1));
+}
+
+static void
+matrix()
+{
+	topo_t			*tp;
+	double			*m;
+	double			sum[4], lo[4], hi[4];
+	int			cnt[4];
+	int			failed = 0;
+	int			rounds;
+	int			i, j, k;
+
+	rounds = optn > 0 ? optn : (optx == MD_FLAG ? DEFN_FLAG : DEFN_RFO);
+
+	if (ncpu < 2) {
+		(void) printf("# matrix: needs at least two cpus\n");
+		return;
+	}
+
+	tp = calloc(ncpu, sizeof (topo_t));
+	m = calloc(ncpu * ncpu, sizeof (double));
+	if (tp == NULL || m == NULL ||
+	    posix_memalign((void **)&flag, LINE, LINE) != 0 ||
+	    posix_memalign((void **)&buf, LINE, opts < LINE ? LINE : opts)) {
+		(void) printf("# matrix: out of memory\n");
+		free(tp);
+		free(m);
+		free(flag);
+		return;
+	}
+
+	for (i = 0; i < ncpu; i++) {
+		topology(cpus[i], &tp[i]);
+	}
+	qsort(tp, ncpu, sizeof (topo_t), topocmp);
+
+	for (k = 0; k < 4; k++) {
+		sum[k] = lo[k] = hi[k] = 0.0;
+		cnt[k] = 0;
+	}
+
+	for (i = 0; i < ncpu; i++) {
+		for (j = 0; j < ncpu; j++) {
+			if (i == j) {
+				continue;
+			}
+			m[i * ncpu + j] = pingpong(tp[i].tp_cpu, tp[j].tp_cpu,
+			    rounds);
+			if (m[i * ncpu + j] < 0.0) {
+				failed++;
+				continue;
+			}
+			k = pairkind(&tp[i], &tp[j]);
+			sum[k] += m[i * ncpu + j];
+			if (cnt[k] == 0 || m[i * ncpu + j] < lo[k]) {
+				lo[k] = m[i * ncpu + j];
+			}
+			if (m[i * ncpu + j] > hi[k]) {
+				hi[k] = m[i * ncpu + j];
+			}
+			cnt[k]++;
+		}
+	}
+
+	/* rows are the cpu that measures, | divides L3s, gaps packages */
+	(void) printf("#\n# %s matrix, nsecs %s\n#\n# %5s",
+	    modes[optx], optx == MD_FLAG ? "one way" : "per line", "");
+	for (j = 0; j < ncpu; j++) {
+		if (j > 0 && tp[j].tp_l3 != tp[j - 1].tp_l3) {
+			(void) printf(" |");
+		}
+		(void) printf(" %6d", tp[j].tp_cpu);
+	}
+	(void) printf("\n");
+
+	for (i = 0; i < ncpu; i++) {
+		if (i > 0 && tp[i].tp_package != tp[i - 1].tp_package) {
+			(void) printf("#\n");
+		}
+		(void) printf("# %5d", tp[i].tp_cpu);
+		for (j = 0; j < ncpu; j++) {
+			if (j > 0 && tp[j].tp_l3 != tp[j - 1].tp_l3) {
+				(void) printf(" |");
+			}
+			if (i == j || m[i * ncpu + j] < 0.0) {
+				(void) printf(" %6s", "-");
+			} else {
+				(void) printf(" %6.1f", m[i * ncpu + j]);
+			}
+		}
+		(void) printf("\n");
+	}
+
+	(void) printf("#\n# %-14s %6s %8s %8s %8s\n",
+	    "pair", "pairs", "min", "mean", "max");
+	for (k = 0; k < 4; k++) {
+		if (cnt[k] > 0) {
+			(void) printf("# %-14s %6d %8.1f %8.1f %8.1f\n",
+			    pairs[k], cnt[k], lo[k], sum[k] / cnt[k], hi[k]);
+		}
+	}
+	if (failed > 0) {
+		(void) printf("# %-14s %6d\n", "unmeasured", failed);
+	}
+	(void) printf("#\n");
+
+	free(tp);
+	free(m);
+	free(flag);
+	free(buf);
+}
+
+#endif
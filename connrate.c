@@ -0,0 +1,343 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * connection rate: the workers open and tear down short lived
+ * loopback connections to acceptor threads in the parent, which
+ * hang up as soon as they've accepted; Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+
+#include "libmicro.h"
+
+#define	MAXM			256
+#define	DEFM			1
+#define	DEFQ			128
+
+typedef struct {
+	long long		ts_conns;
+	long long		ts_nsecs;
+} tsd_t;
+
+static int			optf = 0;
+static int			optm = DEFM;
+static int			optq = DEFQ;
+static int			optu = 0;
+static struct sockaddr_in	add;
+static long long		overflows;
+static long long		drops;
+
+int prepare_listener(int port);
+void *acceptor(void *arg);
+long long netstat(char *name);
+int timewait(int port);
+
+int
+benchmark_init()
+{
+	lm_defB = 64;
+	lm_tsdsize = sizeof (tsd_t);
+
+	(void) sprintf(lm_optstr, "fm:q:u");
+
+	(void) sprintf(lm_usage,
+	    "       [-f] (accept4() with SOCK_NONBLOCK|SOCK_CLOEXEC)\n"
+	    "       [-m acceptor threads (default %d, max %d)]\n"
+	    "       [-q listen backlog (default %d)]\n"
+	    "       [-u] (a SO_REUSEPORT listener per acceptor)\n"
+	    "notes: each op is connect(), wait for the acceptor to hang\n"
+	    "       up, close(); reports connections/sec, the growth in\n"
+	    "       the system-wide ListenOverflows and ListenDrops\n"
+	    "       counters, and TIME_WAIT sockets left on the port\n",
+	    DEFM, MAXM, DEFQ);
+
+	(void) sprintf(lm_header, "%4s %6s %5s %9s %8s %8s %8s",
+	    "acc", "lsn", "flags", "conn/s", "overflow", "drops",
+	    "timewait");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	switch (opt) {
+	case 'f':
+		optf = 1;
+		break;
+	case 'm':
+		optm = atoi(optarg);
+		break;
+	case 'q':
+		optq = atoi(optarg);
+		break;
+	case 'u':
+		optu = 1;
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * the acceptors live in the parent, and outlive the workers
+ */
+int
+benchmark_initrun()
+{
+	pthread_t		tid;
+	socklen_t		size = sizeof (struct sockaddr_in);
+	int			lsn;
+	int			i;
+
+	if (optm <= 0 || optm > MAXM) {
+		(void) printf("ERROR: -m must be between 1 and %d\n", MAXM);
+		return (-1);
+	}
+
+	(void) setfdlimit(2 * lm_optP * lm_optT + optm + 20);
+
+	if ((lsn = prepare_listener(0)) == -1 ||
+	    getsockname(lsn, (struct sockaddr *)&add, &size) == -1) {
+		perror("prepare_listener");
+		return (-1);
+	}
+
+	for (i = 0; i < optm; i++) {
+		if (optu && i > 0 &&
+		    (lsn = prepare_listener(add.sin_port)) == -1) {
+			perror("prepare_listener");
+			return (-1);
+		}
+		if (pthread_create(&tid, NULL, acceptor,
+		    (void *)(long)lsn) != 0) {
+			perror("pthread_create");
+			return (-1);
+		}
+	}
+
+	overflows = netstat("ListenOverflows");
+	drops = netstat("ListenDrops");
+
+	return (0);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	char			c;
+	int			i, s;
+
+	for (i = 0; i < lm_optB; i++) {
+		if ((s = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+			res->re_errors++;
+			continue;
+		}
+
+		/* the acceptor closes first and keeps the TIME_WAIT */
+		if (connect(s, (struct sockaddr *)&add,
+		    sizeof (struct sockaddr_in)) == -1 ||
+		    read(s, &c, 1) != 0) {
+			res->re_errors++;
+		}
+
+		(void) close(s);
+	}
+	res->re_count = i;
+
+	ts->ts_conns += i;
+	ts->ts_nsecs += getnsecs() - res->re_t0;
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	tsd_t			*ts;
+	double			rate = 0.0;
+	int			p, t;
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			if (ts->ts_nsecs > 0) {
+				rate += (double)ts->ts_conns * 1.0e9 /
+				    (double)ts->ts_nsecs;
+			}
+		}
+	}
+
+	(void) sprintf(result, "%4d %6s %5s %9.0f %8lld %8lld %8d",
+	    optm, optu ? "each" : "shared", optf ? "nb|ce" : "-", rate,
+	    netstat("ListenOverflows") - overflows,
+	    netstat("ListenDrops") - drops, timewait(ntohs(add.sin_port)));
+
+	return (result);
+}
+
+void *
+acceptor(void *arg)
+{
+	int			lsn = (int)(long)arg;
+	int			s;
+
+	for (;;) {
+		if (optf) {
+			s = accept4(lsn, NULL, NULL,
+			    SOCK_NONBLOCK | SOCK_CLOEXEC);
+		} else {
+			s = accept(lsn, NULL, NULL);
+		}
+
+		if (s != -1) {
+			(void) close(s);
+		} else if (errno == EMFILE || errno == ENFILE) {
+			/*
+			 * the connection stays queued, so trying again at
+			 * once would only spin; give the closes a moment
+			 */
+			(void) poll(NULL, 0, 1);
+		} else if (errno != EINTR && errno != ECONNABORTED) {
+			perror("accept");
+			break;
+		}
+	}
+
+	return (NULL);
+}
+
+int
+prepare_listener(int port)
+{
+	struct sockaddr_in	sin;
+	int			opt = 1;
+	int			s;
+
+	if ((s = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+		return (-1);
+	}
+
+	if (optu && setsockopt(s, SOL_SOCKET, SO_REUSEPORT,
+	    &opt, sizeof (int)) == -1) {
+		return (-1);
+	}
+
+	(void) memset(&sin, 0, sizeof (struct sockaddr_in));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = port;
+
+	if (bind(s, (struct sockaddr *)&sin, sizeof (sin)) == -1 ||
+	    listen(s, optq) == -1) {
+		return (-1);
+	}
+
+	return (s);
+}
+
+/*
+ * a TcpExt counter from /proc/net/netstat, which is a line of
+ * names followed by a line of values
+ */
+long long
+netstat(char *name)
+{
+	static char		names[8192];
+	static char		values[8192];
+	char			*n, *v, *nl, *vl;
+	long long		result = -1;
+	FILE			*fp;
+
+	if ((fp = fopen("/proc/net/netstat", "r")) == NULL) {
+		return (-1);
+	}
+
+	while (fgets(names, sizeof (names), fp) != NULL &&
+	    fgets(values, sizeof (values), fp) != NULL) {
+		if (strncmp(names, "TcpExt:", 7) != 0) {
+			continue;
+		}
+		n = strtok_r(names, " \n", &nl);
+		v = strtok_r(values, " \n", &vl);
+		while (n != NULL && v != NULL) {
+			if (strcmp(n, name) == 0) {
+				result = atoll(v);
+				break;
+			}
+			n = strtok_r(NULL, " \n", &nl);
+			v = strtok_r(NULL, " \n", &vl);
+		}
+		break;
+	}
+
+	(void) fclose(fp);
+
+	return (result);
+}
+
+/*
+ * TIME_WAIT sockets with the given port at either end
+ */
+int
+timewait(int port)
+{
+	char			line[256];
+	unsigned		lport, rport, st;
+	int			count = 0;
+	FILE			*fp;
+
+	if ((fp = fopen("/proc/net/tcp", "r")) == NULL) {
+		return (-1);
+	}
+
+	while (fgets(line, sizeof (line), fp) != NULL) {
+		if (sscanf(line, " %*d: %*x:%x %*x:%x %x",
+		    &lport, &rport, &st) == 3 && st == 0x06 &&
+		    (lport == port || rport == port)) {
+			count++;
+		}
+	}
+
+	(void) fclose(fp);
+
+	return (count);
+}
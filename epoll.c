@@ -0,0 +1,310 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * epoll_wait() and epoll_ctl() costs, set up like poll and
+ * select so the three can be compared; Linux only
+ */
+
+#define	MAX(x, y)		((x) > (y) ? (x) : (y))
+#define	MIN(x, y)		((x) > (y) ? (y) : (x))
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "libmicro.h"
+
+#define	DEFN			256
+
+static int			optn = DEFN;
+static int			optr = 0;
+static int			optw = 0;
+static int			optx = 0;
+static int			opte = 0;
+static int			optc = 0;
+static int			optm = 0;
+static int			*fds;
+static int			target = 0;
+
+typedef struct epoll_event	ev_t;
+
+typedef struct {
+	int			ts_once;
+	int			ts_epfd;
+	int			ts_next;
+	ev_t			*ts_evs;
+} tsd_t;
+
+int
+benchmark_init()
+{
+	lm_tsdsize = sizeof (tsd_t);
+
+	(void) sprintf(lm_optstr, "cemn:r:w:x");
+
+	(void) sprintf(lm_usage,
+	    "       [-c] (measure epoll_ctl DEL+ADD of one fd instead)\n"
+	    "       [-e] (register fds edge triggered)\n"
+	    "       [-m] (measure epoll_ctl MOD of one fd instead)\n"
+	    "       [-n fds-per-thread (default %d)]\n"
+	    "       [-r readable-fds (default 0)]\n"
+	    "       [-w writeable-fds (default 0)]\n"
+	    "       [-x] (start -r option with highest fd first; "
+	    "default is lowest first)\n"
+	    "notes: measures epoll_wait() with a zero timeout; with -e\n"
+	    "       each fd reported is armed again with EPOLL_CTL_MOD,\n"
+	    "       which is timed too\n",
+	    DEFN);
+
+	(void) sprintf(lm_header, "%8s %6s", "nfds", "flags");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	switch (opt) {
+	case 'c':
+		optc = 1;
+		break;
+	case 'e':
+		opte = 1;
+		break;
+	case 'm':
+		optm = 1;
+		break;
+	case 'n':
+		optn = atoi(optarg);
+		break;
+	case 'r':
+		optr = atoi(optarg);
+		break;
+	case 'w':
+		optw = atoi(optarg);
+		break;
+	case 'x':
+		optx = 1;
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+int
+benchmark_initrun()
+{
+	int			i;
+	int			j;
+	int			pair[2];
+
+	if (optn % 2 != 0) {
+		(void) printf("ERROR: -n value must be even\n");
+		optn = optr = optw = 0;
+		return (-1);
+	}
+
+	if (optn <= 0 || optr < 0 || optw < 0) {
+		(void) printf("ERROR: -n, -r and -w values must be > 0\n");
+		optn = optr = optw = 0;
+		return (-1);
+	}
+
+	if (optr > optn || optw > optn) {
+		(void) printf("ERROR: -r and -w values must be <= maxfd\n");
+		optn = optr = optw = 0;
+		return (-1);
+	}
+
+	if (optc && optm) {
+		(void) printf("ERROR: -c and -m are exclusive\n");
+		return (-1);
+	}
+
+	fds = (int *)malloc(optn * sizeof (int));
+	if (fds == NULL) {
+		(void) printf("ERROR: malloc() failed\n");
+		optn = optr = optw = 0;
+		return (-1);
+	}
+
+	/* each thread has its own epoll instance as well */
+	(void) setfdlimit(optn + lm_optT + 10);
+
+	for (i = 0; i < optn; i += 2) {
+		if (socketpair(PF_UNIX, SOCK_STREAM, 0, pair) == -1) {
+			(void) printf("ERROR: socketpair() failed\n");
+			return (-1);
+		}
+
+		fds[i] = MIN(pair[0], pair[1]);
+		fds[i+1] = MAX(pair[0], pair[1]);
+	}
+
+	if (optx) {
+		target = MIN(optr + optw, optn);
+		for (i = 0, j = optn - 1; i < optr; i++, j--) {
+			(void) write(fds[j+1 - (2*(j%2))], "", 1);
+		}
+	} else {
+		target = MAX(optr, optw);
+		for (i = 0; i < optr; i++) {
+			(void) write(fds[i+1 - (2*(i%2))], "", 1);
+		}
+	}
+
+	return (0);
+}
+
+int
+benchmark_initbatch(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	ev_t			ev;
+	int			i;
+	int			errors = 0;
+
+	if (ts->ts_once++ == 0) {
+		ts->ts_evs = (ev_t *)malloc(optn * sizeof (ev_t));
+		if (ts->ts_evs == NULL) {
+			return (1);
+		}
+
+		ts->ts_epfd = epoll_create1(0);
+		if (ts->ts_epfd == -1) {
+			return (1);
+		}
+
+		for (i = 0; i < optn; i++) {
+			ev.events = EPOLLIN | (opte ? EPOLLET : 0);
+			if (i < optw) {
+				ev.events |= EPOLLOUT;
+			}
+			ev.data.u32 = i;
+			if (epoll_ctl(ts->ts_epfd, EPOLL_CTL_ADD, fds[i],
+			    &ev) == -1) {
+				errors++;
+			}
+		}
+	}
+
+	return (errors);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	ev_t			ev;
+	int			i, k, n;
+
+	if (optc || optm) {
+		/*
+		 * walk the set so that no one fd stays cache hot
+		 */
+		for (i = 0; i < lm_optB; i++) {
+			k = ts->ts_next;
+			ts->ts_next = (k + 1) % optn;
+			ev.events = EPOLLIN | (opte ? EPOLLET : 0);
+			ev.data.u32 = k;
+
+			if (optc) {
+				if (epoll_ctl(ts->ts_epfd, EPOLL_CTL_DEL,
+				    fds[k], &ev) == -1 ||
+				    epoll_ctl(ts->ts_epfd, EPOLL_CTL_ADD,
+				    fds[k], &ev) == -1) {
+					res->re_errors++;
+				}
+			} else {
+				if ((i & 1) == 0) {
+					ev.events |= EPOLLOUT;
+				}
+				if (epoll_ctl(ts->ts_epfd, EPOLL_CTL_MOD,
+				    fds[k], &ev) == -1) {
+					res->re_errors++;
+				}
+			}
+		}
+		res->re_count = i;
+
+		return (0);
+	}
+
+	for (i = 0; i < lm_optB; i++) {
+		if ((n = epoll_wait(ts->ts_epfd, ts->ts_evs, optn, 0)) !=
+		    target) {
+			res->re_errors++;
+		}
+
+		/* the wait consumed the edges; a MOD arms them again */
+		for (k = 0; opte && k < n; k++) {
+			ev.data.u32 = ts->ts_evs[k].data.u32;
+			ev.events = EPOLLIN | EPOLLET |
+			    (ev.data.u32 < optw ? EPOLLOUT : 0);
+			if (epoll_ctl(ts->ts_epfd, EPOLL_CTL_MOD,
+			    fds[ev.data.u32], &ev) == -1) {
+				res->re_errors++;
+			}
+		}
+	}
+	res->re_count = i;
+
+	return (0);
+}
+
+int
+benchmark_finiworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	(void) close(ts->ts_epfd);
+	free(ts->ts_evs);
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	char			flags[7];
+
+	flags[0] = optr ? 'r' : '-';
+	flags[1] = optw ? 'w' : '-';
+	flags[2] = optx ? 'x' : '-';
+	flags[3] = opte ? 'e' : '-';
+	flags[4] = optc ? 'c' : '-';
+	flags[5] = optm ? 'm' : '-';
+	flags[6] = 0;
+
+	(void) sprintf(result, "%8d %6s", optn, flags);
+
+	return (result);
+}
@@ -0,0 +1,225 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * false sharing: every -P/-T worker has a counter of its own, -d
+ * bytes from its neighbour's, and reads or increments only that;
+ * close enough together and they share cache lines anyway.  Where
+ * perf counters are allowed, L1D misses are counted too; Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libmicro.h"
+
+#define	LINE			64
+#define	DEFD			sizeof (long)
+
+typedef struct {
+	long			*ts_counter;
+	perf_t			ts_perf;	/* L1D misses */
+	int			ts_mix;		/* spreads the reads out */
+	long			ts_sum;
+	long long		ts_ops;
+	long long		ts_nsecs;
+	long long		ts_misses;
+} tsd_t;
+
+static int			opta = 0;
+static int			optd = DEFD;
+static int			optr = 0;
+static char			*region;
+
+int
+benchmark_init()
+{
+	lm_tsdsize = sizeof (tsd_t);
+
+	lm_defB = 10000;
+
+	(void) sprintf(lm_optstr, "ad:r:");
+
+	(void) sprintf(lm_usage,
+	    "       [-a] (increment with an atomic add)\n"
+	    "       [-d bytes between workers' counters (default %d)]\n"
+	    "       [-r percentage of ops that only read (default 0)]\n"
+	    "notes: measures an op on a counter of one's own; share is\n"
+	    "       how many workers' counters fall in each cache line;\n"
+	    "       miss/op is L1D misses from perf, if we may count them\n",
+	    (int)DEFD);
+
+	(void) sprintf(lm_header, "%6s %5s %3s %6s %8s %8s",
+	    "dist", "share", "rd%", "op", "ns/op", "miss/op");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	switch (opt) {
+	case 'a':
+		opta = 1;
+		break;
+	case 'd':
+		optd = sizetoint(optarg);
+		break;
+	case 'r':
+		optr = atoi(optarg);
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * the counters are mapped shared before the workers fork, so
+ * processes share lines as well as threads
+ */
+int
+benchmark_initrun()
+{
+	if (optd < sizeof (long) || optd % sizeof (long) != 0) {
+		(void) printf("ERROR: -d must be a multiple of %d\n",
+		    (int)sizeof (long));
+		return (-1);
+	}
+	if (optr < 0 || optr > 100) {
+		(void) printf("ERROR: -r must be between 0 and 100\n");
+		return (-1);
+	}
+
+	/*LINTED*/
+	region = (char *)mmap(NULL, (size_t)optd * lm_optP * lm_optT,
+	    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0L);
+	if (region == MAP_FAILED) {
+		perror("mmap");
+		return (-1);
+	}
+
+	return (0);
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	/*LINTED*/
+	ts->ts_counter = (long *)(region +
+	    (size_t)optd * (getpindex() * lm_optT + gettindex()));
+	perf_open(&ts->ts_perf);
+
+	return (0);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	volatile long		*c = ts->ts_counter;
+	int			i;
+
+	(void) perf_read(&ts->ts_perf);
+
+	for (i = 0; i < lm_optB; i++) {
+		if ((ts->ts_mix += optr) >= 100) {
+			ts->ts_mix -= 100;
+			ts->ts_sum += *c;
+		} else if (opta) {
+			(void) __atomic_fetch_add(c, 1, __ATOMIC_SEQ_CST);
+		} else {
+			(*c)++;
+		}
+	}
+	res->re_count = i;
+
+	ts->ts_misses += perf_read(&ts->ts_perf);
+	ts->ts_ops += i;
+	ts->ts_nsecs += getnsecs() - res->re_t0;
+
+	return (0);
+}
+
+int
+benchmark_finiworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	perf_close(&ts->ts_perf);
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	char			misses[32];
+	tsd_t			*ts;
+	long long		nops = 0;
+	long long		nsecs = 0;
+	long long		nmisses = 0;
+	int			perf = 1;
+	int			share;
+	int			p, t;
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			nops += ts->ts_ops;
+			nsecs += ts->ts_nsecs;
+			nmisses += ts->ts_misses;
+			if (!ts->ts_perf.pf_counted) {
+				perf = 0;
+			}
+		}
+	}
+
+	share = optd >= LINE ? 1 : LINE / optd;
+	if (share > lm_optP * lm_optT) {
+		share = lm_optP * lm_optT;
+	}
+
+	if (perf && nops) {
+		(void) sprintf(misses, "%8.3f", (double)nmisses / nops);
+	} else {
+		(void) sprintf(misses, "%8s", "-");
+	}
+
+	(void) sprintf(result, "%6d %5d %3d %6s %8.2f %s",
+	    optd, share, optr, opta ? "atomic" : "plain",
+	    nops ? (double)nsecs / nops : 0.0, misses);
+
+	return (result);
+}
@@ -0,0 +1,437 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * descriptor passing: a peer hands the benchmark thread a set
+ * of descriptors, over AF_UNIX with SCM_RIGHTS or by having them
+ * taken with pidfd_getfd(); the benchmark thread closes what it
+ * receives; Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+
+#include "libmicro.h"
+
+#ifndef SYS_pidfd_open
+#define	SYS_pidfd_open		434
+#endif
+#ifndef SYS_pidfd_getfd
+#define	SYS_pidfd_getfd		438
+#endif
+
+#define	MAXN			253	/* SCM_MAX_FD */
+#define	DEFN			1
+
+static char			*modes[] = {"st", "mt", "mp", NULL};
+#define	MD_SINGLE		0
+#define	MD_MULTITHREAD		1
+#define	MD_MULTIPROCESS		2
+
+static char			*hows[] = {"scm", "pidfd", NULL};
+#define	HOW_SCM			0
+#define	HOW_PIDFD		1
+
+typedef struct {
+	int			ts_sock[2];	/* [0] is ours */
+	int			ts_fds[MAXN];	/* what the peer gives */
+	int			ts_pidfd;
+	pid_t			ts_child;
+	pthread_t		ts_thread;
+	char			*ts_cmsg;
+	long long		ts_nfds;
+	long long		ts_nsecs;
+} tsd_t;
+
+static int			optm = MD_MULTIPROCESS;
+static int			optn = DEFN;
+static int			optt = 0;
+static int			optx = HOW_SCM;
+static size_t			cmsglen;
+
+int sendfds(tsd_t *ts);
+int recvfds(tsd_t *ts, int *fds);
+void *peer(void *arg);
+int lookup(char *x, char **names);
+
+int
+benchmark_init()
+{
+	lm_defB = 64;
+	lm_tsdsize = sizeof (tsd_t);
+
+	(void) sprintf(lm_optstr, "m:n:t:x:");
+
+	(void) sprintf(lm_usage,
+	    "       [-m mode (st|mt|mp, default mp)]\n"
+	    "       [-n descriptors per transfer (default %d, max %d)]\n"
+	    "       [-t descriptors held open by the receiver (default 0)]\n"
+	    "       [-x scm|pidfd (default scm)]\n"
+	    "notes: with scm a peer thread or process keeps sending\n"
+	    "       messages of -n descriptors, or st sends to itself;\n"
+	    "       with pidfd the benchmark thread takes them from the\n"
+	    "       peer process (mp) or from itself; ns/fd includes\n"
+	    "       closing them again\n",
+	    DEFN, MAXN);
+
+	(void) sprintf(lm_header, "%5s %4s %4s %7s %7s",
+	    "how", "mode", "nfds", "table", "ns/fd");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	switch (opt) {
+	case 'm':
+		optm = lookup(optarg, modes);
+		if (optm == -1) {
+			return (-1);
+		}
+		break;
+	case 'n':
+		optn = atoi(optarg);
+		break;
+	case 't':
+		optt = atoi(optarg);
+		break;
+	case 'x':
+		optx = lookup(optarg, hows);
+		if (optx == -1) {
+			return (-1);
+		}
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+int
+benchmark_initrun()
+{
+	if (optn <= 0 || optn > MAXN) {
+		(void) printf("ERROR: -n must be between 1 and %d\n", MAXN);
+		return (-1);
+	}
+	if (optt < 0) {
+		(void) printf("ERROR: -t must not be negative\n");
+		return (-1);
+	}
+
+	(void) setfdlimit(lm_optT * (optt + 3 * optn + 10) + 10);
+
+	cmsglen = CMSG_SPACE(optn * sizeof (int));
+
+	return (0);
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	pid_t			pid;
+	int			i;
+
+	if ((ts->ts_cmsg = calloc(1, cmsglen)) == NULL) {
+		return (1);
+	}
+
+	for (i = 0; i < optn; i++) {
+		if ((ts->ts_fds[i] = open("/dev/null", O_RDWR)) == -1) {
+			perror("/dev/null");
+			return (1);
+		}
+	}
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, ts->ts_sock) == -1) {
+		perror("socketpair");
+		return (1);
+	}
+
+	switch (optm) {
+	case MD_MULTITHREAD:
+		if (optx == HOW_SCM &&
+		    pthread_create(&ts->ts_thread, NULL, peer, ts) != 0) {
+			return (1);
+		}
+		break;
+	case MD_MULTIPROCESS:
+		pid = fork();
+		switch (pid) {
+		case 0:
+			(void) close(ts->ts_sock[0]);
+			(void) peer(tsd);
+			exit(0);
+			break;
+		case -1:
+			return (1);
+		default:
+			/* so that the child's exit is our end of file */
+			(void) close(ts->ts_sock[1]);
+			ts->ts_child = pid;
+			break;
+		}
+		break;
+	case MD_SINGLE:
+	default:
+		break;
+	}
+
+	if (optx == HOW_PIDFD) {
+		pid = optm == MD_MULTIPROCESS ? ts->ts_child : getpid();
+		ts->ts_pidfd = syscall(SYS_pidfd_open, pid, 0);
+		if (ts->ts_pidfd == -1) {
+			perror("pidfd_open");
+			return (1);
+		}
+	}
+
+	/* the receiver's descriptor table, grown after the fork */
+	for (i = 0; i < optt; i++) {
+		if (open("/dev/null", O_RDONLY) == -1) {
+			perror("/dev/null");
+			return (1);
+		}
+	}
+
+	return (0);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	int			fds[MAXN];
+	int			i, j, n;
+
+	for (i = 0; i < lm_optB; i++) {
+		if (optx == HOW_PIDFD) {
+			for (n = 0; n < optn; n++) {
+				fds[n] = syscall(SYS_pidfd_getfd, ts->ts_pidfd,
+				    ts->ts_fds[n], 0);
+				if (fds[n] == -1) {
+					break;
+				}
+			}
+		} else {
+			if (optm == MD_SINGLE && sendfds(ts) == -1) {
+				res->re_errors++;
+				continue;
+			}
+			n = recvfds(ts, fds);
+		}
+
+		if (n != optn) {
+			res->re_errors++;
+		}
+		for (j = 0; j < n; j++) {
+			(void) close(fds[j]);
+		}
+	}
+	res->re_count = i;
+
+	ts->ts_nfds += (long long)i * optn;
+	ts->ts_nsecs += getnsecs() - res->re_t0;
+
+	return (0);
+}
+
+int
+benchmark_finiworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	/* the peer's next send fails, or its read sees the end */
+	(void) close(ts->ts_sock[0]);
+
+	switch (optm) {
+	case MD_MULTITHREAD:
+		if (optx == HOW_SCM) {
+			(void) pthread_join(ts->ts_thread, NULL);
+		}
+		break;
+	case MD_MULTIPROCESS:
+		(void) waitpid(ts->ts_child, NULL, 0);
+		return (0);
+	}
+
+	(void) close(ts->ts_sock[1]);
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	tsd_t			*ts;
+	long long		nfds = 0;
+	long long		nsecs = 0;
+	int			p, t;
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			nfds += ts->ts_nfds;
+			nsecs += ts->ts_nsecs;
+		}
+	}
+
+	(void) sprintf(result, "%5s %4s %4d %7d %7.1f",
+	    hows[optx], modes[optm], optn, optt,
+	    nfds ? (double)nsecs / (double)nfds : 0.0);
+
+	return (result);
+}
+
+/*
+ * the sending side: keep the socket full of descriptors for
+ * scm, or just stay alive to be taken from for pidfd
+ */
+void *
+peer(void *arg)
+{
+	tsd_t			*ts = (tsd_t *)arg;
+	char			c;
+
+	if (optx == HOW_PIDFD) {
+		while (read(ts->ts_sock[1], &c, 1) > 0)
+			;
+		return (NULL);
+	}
+
+	/*
+	 * unless privileged, what's in flight is held to our descriptor
+	 * limit; wait for the receiver to take some
+	 */
+	for (;;) {
+		if (sendfds(ts) == 0) {
+			continue;
+		}
+		if (errno != ETOOMANYREFS && errno != EAGAIN) {
+			break;
+		}
+		(void) poll(NULL, 0, 1);
+	}
+
+	return (NULL);
+}
+
+int
+sendfds(tsd_t *ts)
+{
+	struct msghdr		msg;
+	struct cmsghdr		*cm;
+	struct iovec		iov;
+	char			c = 0;
+
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+
+	(void) memset(&msg, 0, sizeof (msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ts->ts_cmsg;
+	msg.msg_controllen = cmsglen;
+
+	cm = CMSG_FIRSTHDR(&msg);
+	cm->cmsg_level = SOL_SOCKET;
+	cm->cmsg_type = SCM_RIGHTS;
+	cm->cmsg_len = CMSG_LEN(optn * sizeof (int));
+	(void) memcpy(CMSG_DATA(cm), ts->ts_fds, optn * sizeof (int));
+
+	if (sendmsg(ts->ts_sock[1], &msg, MSG_NOSIGNAL) != 1) {
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*
+ * receive one message, returning how many descriptors came with it
+ */
+int
+recvfds(tsd_t *ts, int *fds)
+{
+	struct msghdr		msg;
+	struct cmsghdr		*cm;
+	struct iovec		iov;
+	char			cbuf[CMSG_SPACE(MAXN * sizeof (int))];
+	char			c;
+	int			n = 0;
+
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+
+	(void) memset(&msg, 0, sizeof (msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = cmsglen;
+
+	if (recvmsg(ts->ts_sock[0], &msg, 0) != 1) {
+		return (-1);
+	}
+
+	for (cm = CMSG_FIRSTHDR(&msg); cm != NULL;
+	    cm = CMSG_NXTHDR(&msg, cm)) {
+		if (cm->cmsg_level == SOL_SOCKET &&
+		    cm->cmsg_type == SCM_RIGHTS) {
+			n = (cm->cmsg_len - CMSG_LEN(0)) / sizeof (int);
+			(void) memcpy(fds, CMSG_DATA(cm), n * sizeof (int));
+		}
+	}
+
+	return (n);
+}
+
+int
+lookup(char *x, char **names)
+{
+	int			i;
+
+	for (i = 0; names[i] != NULL; i++) {
+		if (strcmp(x, names[i]) == 0) {
+			return (i);
+		}
+	}
+
+	return (-1);
+}
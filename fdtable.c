@@ -0,0 +1,308 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * descriptor allocation and release in a process that already
+ * holds a large descriptor table, optionally riddled with holes,
+ * from many threads at once; Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include "libmicro.h"
+
+#ifndef SYS_close_range
+#define	SYS_close_range		436
+#endif
+
+#define	DEFF			"/dev/null"
+#define	DEFN			1024
+
+static char			*ops[] = {
+	"open", "dup", "socket", "close", "range", NULL
+};
+#define	OP_OPEN			0
+#define	OP_DUP			1
+#define	OP_SOCKET		2
+#define	OP_CLOSE		3
+#define	OP_RANGE		4
+
+typedef struct {
+	int			ts_once;
+	int			*ts_fds;
+	int			ts_base;	/* first of our range */
+	long long		ts_ops;
+	long long		ts_nsecs;
+} tsd_t;
+
+static char			*optf = DEFF;
+static int			opth = 0;
+static int			optn = DEFN;
+static int			optx = OP_DUP;
+static int			fd;
+
+int
+benchmark_init()
+{
+	lm_tsdsize = sizeof (tsd_t);
+
+	lm_defB = 256;
+
+	(void) sprintf(lm_optstr, "f:h:n:x:");
+
+	(void) sprintf(lm_usage,
+	    "       [-f file-to-open (default %s)]\n"
+	    "       [-h close every h'th descriptor of the table, "
+	    "leaving holes (default 0, none)]\n"
+	    "       [-n descriptors held open (default %d)]\n"
+	    "       [-x open|dup|socket|close|range (default dup)]\n"
+	    "notes: measures descriptor allocation or release with the\n"
+	    "       table pre-grown to -n entries; range closes each\n"
+	    "       thread's batch with a single close_range()\n",
+	    DEFF, DEFN);
+
+	(void) sprintf(lm_header, "%6s %8s %5s %9s",
+	    "op", "nfds", "holes", "Kops/s");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	int			i;
+
+	switch (opt) {
+	case 'f':
+		optf = optarg;
+		break;
+	case 'h':
+		opth = atoi(optarg);
+		break;
+	case 'n':
+		optn = sizetoint(optarg);
+		break;
+	case 'x':
+		for (i = 0; ops[i] != NULL; i++) {
+			if (strcmp(optarg, ops[i]) == 0) {
+				break;
+			}
+		}
+		if (ops[i] == NULL) {
+			return (-1);
+		}
+		optx = i;
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * fill the table before the workers fork, so they inherit it
+ */
+int
+benchmark_initrun()
+{
+	int			i, n;
+
+	if (optn < 0 || opth < 0) {
+		(void) printf("ERROR: -n and -h must not be negative\n");
+		return (-1);
+	}
+
+	(void) setfdlimit(optn + 2 * lm_optB * lm_optT + 10);
+
+	if ((fd = open(optf, O_RDONLY)) == -1) {
+		perror(optf);
+		return (-1);
+	}
+
+	for (n = fd + 1; n < optn; n++) {
+		if (dup(fd) == -1) {
+			perror("dup");
+			return (-1);
+		}
+	}
+
+	if (opth > 0) {
+		for (i = fd + 1; i < optn; i++) {
+			if (i % opth == 0) {
+				(void) close(i);
+			}
+		}
+	}
+
+	return (0);
+}
+
+int
+benchmark_initbatch(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	int			i;
+	int			errors = 0;
+
+	if (ts->ts_once++ == 0) {
+		ts->ts_fds = (int *)malloc(lm_optB * sizeof (int));
+		if (ts->ts_fds == NULL) {
+			return (1);
+		}
+		for (i = 0; i < lm_optB; i++) {
+			ts->ts_fds[i] = -1;
+		}
+		/* each thread gets a run of its own above the table */
+		ts->ts_base = optn + 10 + gettindex() * lm_optB;
+	}
+
+	switch (optx) {
+	case OP_CLOSE:
+		for (i = 0; i < lm_optB; i++) {
+			if ((ts->ts_fds[i] = dup(fd)) == -1) {
+				errors++;
+			}
+		}
+		break;
+	case OP_RANGE:
+		for (i = 0; i < lm_optB; i++) {
+			if (dup2(fd, ts->ts_base + i) == -1) {
+				errors++;
+			}
+		}
+		break;
+	}
+
+	return (errors);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	int			i;
+
+	switch (optx) {
+	case OP_OPEN:
+		for (i = 0; i < lm_optB; i++) {
+			ts->ts_fds[i] = open(optf, O_RDONLY);
+			if (ts->ts_fds[i] == -1) {
+				res->re_errors++;
+			}
+		}
+		break;
+	case OP_DUP:
+		for (i = 0; i < lm_optB; i++) {
+			ts->ts_fds[i] = dup(fd);
+			if (ts->ts_fds[i] == -1) {
+				res->re_errors++;
+			}
+		}
+		break;
+	case OP_SOCKET:
+		for (i = 0; i < lm_optB; i++) {
+			ts->ts_fds[i] = socket(AF_UNIX, SOCK_DGRAM, 0);
+			if (ts->ts_fds[i] == -1) {
+				res->re_errors++;
+			}
+		}
+		break;
+	case OP_CLOSE:
+		for (i = 0; i < lm_optB; i++) {
+			if (close(ts->ts_fds[i]) == -1) {
+				res->re_errors++;
+			}
+			ts->ts_fds[i] = -1;
+		}
+		break;
+	case OP_RANGE:
+		if (syscall(SYS_close_range, ts->ts_base,
+		    ts->ts_base + lm_optB - 1, 0) == -1) {
+			res->re_errors++;
+		}
+		i = lm_optB;
+		break;
+	default:
+		res->re_errors++;
+		i = 0;
+		break;
+	}
+	res->re_count = i;
+
+	ts->ts_ops += i;
+	ts->ts_nsecs += getnsecs() - res->re_t0;
+
+	return (0);
+}
+
+int
+benchmark_finibatch(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	int			i;
+
+	if (optx == OP_CLOSE || optx == OP_RANGE) {
+		return (0);
+	}
+
+	for (i = 0; i < lm_optB; i++) {
+		(void) close(ts->ts_fds[i]);
+	}
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	tsd_t			*ts;
+	double			rate = 0.0;
+	int			p, t;
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			if (ts->ts_nsecs > 0) {
+				rate += (double)ts->ts_ops * 1.0e6 /
+				    (double)ts->ts_nsecs;
+			}
+		}
+	}
+
+	(void) sprintf(result, "%6s %8d %5d %9.0f",
+	    ops[optx], optn, opth, rate);
+
+	return (result);
+}
@@ -0,0 +1,551 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * the futex system call on its own, without libc's locks on top:
+ *
+ *	pingpong	round trip with a peer, FUTEX_WAIT/FUTEX_WAKE
+ *	waitv		round trip with a peer that waits on -n words
+ *			with futex_waitv()
+ *	wake		FUTEX_WAKE of -n waiters, until all have run
+ *	requeue		FUTEX_CMP_REQUEUE of -n waiters onto a second
+ *			word, which they then wake one another from, as
+ *			a condition variable broadcast does
+ *	pi		FUTEX_LOCK_PI/FUTEX_UNLOCK_PI on a lock shared by
+ *			all -P/-T workers
+ *
+ * peers and waiters are threads (-m mt, private futexes) or
+ * processes sharing an anonymous mapping (-m mp); Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#include "libmicro.h"
+
+#ifndef SYS_futex_waitv
+#define	SYS_futex_waitv		449
+#endif
+#ifndef FUTEX_32
+#define	FUTEX_32		2
+#endif
+
+#define	MAXN			128	/* FUTEX_WAITV_MAX */
+#define	DEFN			1
+
+/* the same layout as the kernel's struct futex_waitv */
+typedef struct {
+	unsigned long long	fw_val;
+	unsigned long long	fw_uaddr;
+	unsigned int		fw_flags;
+	unsigned int		fw_reserved;
+} waitv_t;
+
+static char			*ops[] = {
+	"pingpong", "waitv", "wake", "requeue", "pi", NULL
+};
+#define	OP_PINGPONG		0
+#define	OP_WAITV		1
+#define	OP_WAKE			2
+#define	OP_REQUEUE		3
+#define	OP_PI			4
+
+static char			*modes[] = {"mt", "mp", NULL};
+#define	MD_MULTITHREAD		0
+#define	MD_MULTIPROCESS		1
+
+/*
+ * what a worker shares with its peer or waiters
+ */
+typedef struct {
+	int			sh_turn;	/* 1 while the peer's */
+	int			sh_seq;		/* bumped to wake waiters */
+	int			sh_requeue;	/* where they're moved to */
+	int			sh_woken;	/* waiters through this round */
+	int			sh_stop;
+	int			sh_ping[MAXN];	/* waitv words */
+} shared_t;
+
+typedef struct {
+	shared_t		*ts_sh;
+	int			ts_npeers;
+	pthread_t		ts_threads[MAXN];
+	pid_t			ts_pids[MAXN];
+	int			ts_tid;
+	long long		ts_ops;
+	long long		ts_nsecs;
+	long long		ts_kernel;	/* pi ops that went in */
+} tsd_t;
+
+static int			optk = 0;
+static int			optm = MD_MULTITHREAD;
+static int			optn = DEFN;
+static int			optx = OP_PINGPONG;
+static int			priv;		/* FUTEX_PRIVATE_FLAG or 0 */
+static int			*pilock;
+
+void *peer(void *arg);
+void *waiter(void *arg);
+int lookup(char *x, char **names);
+
+static long
+futex(int *uaddr, int op, int val, void *timeout, int *uaddr2, int val3)
+{
+	return (syscall(SYS_futex, uaddr, op | priv, val, timeout,
+	    uaddr2, val3));
+}
+
+int
+benchmark_init()
+{
+	lm_tsdsize = sizeof (tsd_t);
+
+	lm_defB = 100;
+
+	(void) sprintf(lm_optstr, "km:n:x:");
+
+	(void) sprintf(lm_usage,
+	    "       [-k] (pi: always take the kernel path)\n"
+	    "       [-m mt|mp (default mt)]\n"
+	    "       [-n waiters or waitv words (default %d, max %d)]\n"
+	    "       [-x pingpong|waitv|wake|requeue|pi (default pingpong)]\n"
+	    "notes: an op is a round trip for pingpong and waitv, one\n"
+	    "       wake up of all -n waiters for wake and requeue, and\n"
+	    "       a lock/unlock pair for pi, which ignores -m and\n"
+	    "       contends between the -P/-T workers instead; kern%%\n"
+	    "       is the share of pi ops that needed the kernel\n",
+	    DEFN, MAXN);
+
+	(void) sprintf(lm_header, "%8s %4s %4s %9s %6s",
+	    "op", "mode", "n", "ns/op", "kern%");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	switch (opt) {
+	case 'k':
+		optk = 1;
+		break;
+	case 'm':
+		optm = lookup(optarg, modes);
+		if (optm == -1) {
+			return (-1);
+		}
+		break;
+	case 'n':
+		optn = atoi(optarg);
+		break;
+	case 'x':
+		optx = lookup(optarg, ops);
+		if (optx == -1) {
+			return (-1);
+		}
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+int
+benchmark_initrun()
+{
+	waitv_t			wv;
+
+	if (optn < 0 || optn > MAXN || (optx == OP_WAITV && optn == 0)) {
+		(void) printf("ERROR: -n must be between %d and %d\n",
+		    optx == OP_WAITV ? 1 : 0, MAXN);
+		return (-1);
+	}
+
+	if (optx == OP_WAITV) {
+		/* a mismatched value fails fast if the call exists */
+		(void) memset(&wv, 0, sizeof (wv));
+		wv.fw_val = optn + 1;
+		wv.fw_uaddr = (unsigned long)&optn;
+		wv.fw_flags = FUTEX_32;
+		if (syscall(SYS_futex_waitv, &wv, 1, 0, NULL, 0) == -1 &&
+		    errno == ENOSYS) {
+			(void) printf("#\n# benchmark %s skipped: "
+			    "futex_waitv() not supported\n#\n", lm_procpath);
+			exit(0);
+		}
+	}
+
+	if (optx == OP_PI) {
+		/* before the workers fork, so all of them share it */
+		pilock = (int *)mmap(NULL, getpagesize(),
+		    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0L);
+		if (pilock == MAP_FAILED) {
+			perror("mmap");
+			return (-1);
+		}
+		*pilock = 0;
+		priv = lm_optP == 1 ? FUTEX_PRIVATE_FLAG : 0;
+	} else {
+		priv = optm == MD_MULTITHREAD ? FUTEX_PRIVATE_FLAG : 0;
+	}
+
+	return (0);
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	void			*(*func)(void *);
+	pid_t			pid;
+	int			i;
+
+	ts->ts_tid = syscall(SYS_gettid);
+
+	if (optx == OP_PI) {
+		return (0);
+	}
+
+	ts->ts_sh = (shared_t *)mmap(NULL, sizeof (shared_t),
+	    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0L);
+	if (ts->ts_sh == MAP_FAILED) {
+		perror("mmap");
+		return (1);
+	}
+	(void) memset(ts->ts_sh, 0, sizeof (shared_t));
+
+	if (optx == OP_PINGPONG || optx == OP_WAITV) {
+		func = peer;
+		ts->ts_npeers = 1;
+	} else {
+		func = waiter;
+		ts->ts_npeers = optn;
+	}
+
+	for (i = 0; i < ts->ts_npeers; i++) {
+		if (optm == MD_MULTITHREAD) {
+			if (pthread_create(&ts->ts_threads[i], NULL,
+			    func, ts->ts_sh) != 0) {
+				perror("pthread_create");
+				return (1);
+			}
+			continue;
+		}
+
+		switch (pid = fork()) {
+		case 0:
+			(void) func(ts->ts_sh);
+			exit(0);
+			break;
+		case -1:
+			perror("fork");
+			return (1);
+		default:
+			ts->ts_pids[i] = pid;
+			break;
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * PI lock word: 0 when free, else the owner's tid, with
+ * FUTEX_WAITERS set by the kernel when anyone is queued
+ */
+static int
+pi_lockunlock(tsd_t *ts)
+{
+	int			expected;
+	int			kernel = 0;
+
+	expected = 0;
+	if (optk || !__atomic_compare_exchange_n(pilock, &expected,
+	    ts->ts_tid, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		while (futex(pilock, FUTEX_LOCK_PI, 0, NULL, NULL, 0) == -1) {
+			if (errno != EINTR && errno != EAGAIN) {
+				return (-1);
+			}
+		}
+		kernel = 1;
+	}
+
+	expected = ts->ts_tid;
+	if (optk || !__atomic_compare_exchange_n(pilock, &expected, 0,
+	    0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+		if (futex(pilock, FUTEX_UNLOCK_PI, 0, NULL, NULL, 0) == -1) {
+			return (-1);
+		}
+		kernel = 1;
+	}
+
+	return (kernel);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	shared_t		*sh = ts->ts_sh;
+	int			seq, w, k;
+	int			i;
+
+	for (i = 0; i < lm_optB; i++) {
+		switch (optx) {
+		case OP_PINGPONG:
+			__atomic_store_n(&sh->sh_turn, 1, __ATOMIC_RELEASE);
+			(void) futex(&sh->sh_turn, FUTEX_WAKE, 1,
+			    NULL, NULL, 0);
+			while (__atomic_load_n(&sh->sh_turn,
+			    __ATOMIC_ACQUIRE) == 1) {
+				(void) futex(&sh->sh_turn, FUTEX_WAIT, 1,
+				    NULL, NULL, 0);
+			}
+			break;
+		case OP_WAITV:
+			k = i % optn;
+			__atomic_store_n(&sh->sh_turn, 1, __ATOMIC_RELAXED);
+			__atomic_store_n(&sh->sh_ping[k], 1, __ATOMIC_RELEASE);
+			(void) futex(&sh->sh_ping[k], FUTEX_WAKE, 1,
+			    NULL, NULL, 0);
+			while (__atomic_load_n(&sh->sh_turn,
+			    __ATOMIC_ACQUIRE) == 1) {
+				(void) futex(&sh->sh_turn, FUTEX_WAIT, 1,
+				    NULL, NULL, 0);
+			}
+			break;
+		case OP_WAKE:
+		case OP_REQUEUE:
+			__atomic_store_n(&sh->sh_woken, 0, __ATOMIC_RELAXED);
+			seq = __atomic_add_fetch(&sh->sh_seq, 1,
+			    __ATOMIC_RELEASE);
+			if (optx == OP_WAKE) {
+				(void) futex(&sh->sh_seq, FUTEX_WAKE, INT_MAX,
+				    NULL, NULL, 0);
+			} else if (futex(&sh->sh_seq, FUTEX_CMP_REQUEUE, 1,
+			    (void *)(long)INT_MAX, &sh->sh_requeue,
+			    seq) == -1) {
+				res->re_errors++;
+			}
+			while ((w = __atomic_load_n(&sh->sh_woken,
+			    __ATOMIC_ACQUIRE)) < optn) {
+				(void) futex(&sh->sh_woken, FUTEX_WAIT, w,
+				    NULL, NULL, 0);
+			}
+			break;
+		case OP_PI:
+			switch (pi_lockunlock(ts)) {
+			case -1:
+				res->re_errors++;
+				break;
+			case 1:
+				ts->ts_kernel++;
+				break;
+			}
+			break;
+		}
+	}
+	res->re_count = i;
+
+	ts->ts_ops += i;
+	ts->ts_nsecs += getnsecs() - res->re_t0;
+
+	return (0);
+}
+
+int
+benchmark_finiworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	shared_t		*sh = ts->ts_sh;
+	int			i;
+
+	if (optx == OP_PI) {
+		return (0);
+	}
+
+	__atomic_store_n(&sh->sh_stop, 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&sh->sh_turn, 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&sh->sh_ping[0], 1, __ATOMIC_RELEASE);
+	(void) __atomic_add_fetch(&sh->sh_seq, 1, __ATOMIC_RELEASE);
+	(void) futex(&sh->sh_turn, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	(void) futex(&sh->sh_ping[0], FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	(void) futex(&sh->sh_seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	(void) futex(&sh->sh_requeue, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+
+	for (i = 0; i < ts->ts_npeers; i++) {
+		if (optm == MD_MULTITHREAD) {
+			(void) pthread_join(ts->ts_threads[i], NULL);
+		} else {
+			(void) waitpid(ts->ts_pids[i], NULL, 0);
+		}
+	}
+
+	(void) munmap(sh, sizeof (shared_t));
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	tsd_t			*ts;
+	long long		nops = 0;
+	long long		nsecs = 0;
+	long long		kernel = 0;
+	int			p, t;
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			nops += ts->ts_ops;
+			nsecs += ts->ts_nsecs;
+			kernel += ts->ts_kernel;
+		}
+	}
+
+	(void) sprintf(result, "%8s %4s %4d %9.1f %6.1f",
+	    ops[optx], optx == OP_PI ? "-" : modes[optm], optn,
+	    nops ? (double)nsecs / (double)nops : 0.0,
+	    nops ? 100.0 * (double)kernel / (double)nops : 0.0);
+
+	return (result);
+}
+
+/*
+ * the other end of pingpong and waitv: wait for our turn, hand
+ * it straight back
+ */
+void *
+peer(void *arg)
+{
+	shared_t		*sh = (shared_t *)arg;
+	waitv_t			wv[MAXN];
+	int			k;
+
+	if (optx == OP_WAITV) {
+		(void) memset(wv, 0, sizeof (wv));
+		for (k = 0; k < optn; k++) {
+			wv[k].fw_uaddr = (unsigned long)&sh->sh_ping[k];
+			wv[k].fw_flags = FUTEX_32 | priv;
+		}
+	}
+
+	for (;;) {
+		if (optx == OP_WAITV) {
+			(void) syscall(SYS_futex_waitv, wv, optn, 0, NULL, 0);
+			for (k = 0; k < optn; k++) {
+				if (__atomic_load_n(&sh->sh_ping[k],
+				    __ATOMIC_ACQUIRE) != 0) {
+					break;
+				}
+			}
+			if (k == optn) {
+				continue;
+			}
+			sh->sh_ping[k] = 0;
+		} else {
+			while (__atomic_load_n(&sh->sh_turn,
+			    __ATOMIC_ACQUIRE) == 0) {
+				(void) futex(&sh->sh_turn, FUTEX_WAIT, 0,
+				    NULL, NULL, 0);
+			}
+		}
+
+		if (__atomic_load_n(&sh->sh_stop, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+
+		__atomic_store_n(&sh->sh_turn, 0, __ATOMIC_RELEASE);
+		(void) futex(&sh->sh_turn, FUTEX_WAKE, 1, NULL, NULL, 0);
+	}
+
+	return (NULL);
+}
+
+/*
+ * one of the wake or requeue waiters: sleep until the sequence
+ * moves on, pass the wake up along for requeue, and check in;
+ * the last to check in wakes the benchmark thread
+ */
+void *
+waiter(void *arg)
+{
+	shared_t		*sh = (shared_t *)arg;
+	int			seq = 0;	/* may have moved on already */
+
+	for (;;) {
+		while (__atomic_load_n(&sh->sh_seq, __ATOMIC_ACQUIRE) == seq) {
+			(void) futex(&sh->sh_seq, FUTEX_WAIT, seq,
+			    NULL, NULL, 0);
+		}
+
+		if (__atomic_load_n(&sh->sh_stop, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+
+		seq = __atomic_load_n(&sh->sh_seq, __ATOMIC_ACQUIRE);
+
+		if (optx == OP_REQUEUE) {
+			(void) futex(&sh->sh_requeue, FUTEX_WAKE, 1,
+			    NULL, NULL, 0);
+		}
+
+		if (__atomic_add_fetch(&sh->sh_woken, 1,
+		    __ATOMIC_ACQ_REL) == optn) {
+			(void) futex(&sh->sh_woken, FUTEX_WAKE, 1,
+			    NULL, NULL, 0);
+		}
+	}
+
+	return (NULL);
+}
+
+int
+lookup(char *x, char **names)
+{
+	int			i;
+
+	for (i = 0; names[i] != NULL; i++) {
+		if (strcmp(x, names[i]) == 0) {
+			return (i);
+		}
+	}
+
+	return (-1);
+}
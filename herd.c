@@ -0,0 +1,487 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * thundering herd: a pool of threads waits for connections on
+ * one port, blocked in accept() or epoll_wait(), while the
+ * benchmark thread connects to it one connection at a time;
+ * Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "libmicro.h"
+
+#ifndef EPOLLEXCLUSIVE
+#define	EPOLLEXCLUSIVE		(1U << 28)
+#endif
+
+#define	MAXN			256
+#define	DEFN			4
+
+#define	HOW_ACCEPT		0	/* all block in accept() */
+#define	HOW_SHARED		1	/* one epoll set for all */
+#define	HOW_EACH		2	/* an epoll set each */
+#define	HOW_EXCL		3	/* ... with EPOLLEXCLUSIVE */
+#define	HOW_REUSEPORT		4	/* a listener each, one port */
+
+static char			*hows[] = {
+	"accept", "shared", "each", "excl", "reuseport", NULL
+};
+
+struct tsd;
+
+typedef struct {
+	struct tsd		*w_ts;
+	int			w_id;
+	int			w_lsn;
+	int			w_epfd;
+	pthread_t		w_thread;
+	long long		w_csw;
+	long long		w_accepts;
+	long long		w_lat;
+	long long		w_max;
+} waiter_t;
+
+typedef struct tsd {
+	int			ts_lsn;
+	int			ts_epfd;
+	int			ts_efd;
+	volatile int		ts_done;
+	volatile long long	ts_t0;
+	struct sockaddr_in	ts_add;
+	waiter_t		ts_w[MAXN];
+} tsd_t;
+
+static int			optn = DEFN;
+static int			optx = HOW_ACCEPT;
+
+int prepare_listener(tsd_t *ts, int port);
+int prepare_epoll(tsd_t *ts, int lsn, int flags);
+void *waiter(void *arg);
+
+int
+benchmark_init()
+{
+	lm_defB = 64;
+	lm_tsdsize = sizeof (tsd_t);
+
+	(void) sprintf(lm_optstr, "n:x:");
+
+	(void) sprintf(lm_usage,
+	    "       [-n waiting threads (default %d, max %d)]\n"
+	    "       [-x accept|shared|each|excl|reuseport (default accept)]\n"
+	    "notes: the waiters block in accept() on one listener, in\n"
+	    "       epoll_wait() on one shared epoll set, on an epoll set\n"
+	    "       each (optionally EPOLLEXCLUSIVE), or in accept() on a\n"
+	    "       listener each bound with SO_REUSEPORT; reports mean\n"
+	    "       and max connect-to-wakeup usecs, wakeups that found\n"
+	    "       nothing to accept per connection, and the busiest\n"
+	    "       waiter's share of connections\n",
+	    DEFN, MAXN);
+
+	(void) sprintf(lm_header, "%5s %9s %8s %8s %7s %5s",
+	    "nwait", "how", "lat_us", "max_us", "spur/ev", "max%");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	int			i;
+
+	switch (opt) {
+	case 'n':
+		optn = atoi(optarg);
+		break;
+	case 'x':
+		for (i = 0; hows[i] != NULL; i++) {
+			if (strcmp(optarg, hows[i]) == 0) {
+				break;
+			}
+		}
+		if (hows[i] == NULL) {
+			return (-1);
+		}
+		optx = i;
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+int
+benchmark_initrun()
+{
+	if (optn <= 0 || optn > MAXN) {
+		(void) printf("ERROR: -n must be between 1 and %d\n", MAXN);
+		return (-1);
+	}
+
+	(void) setfdlimit(lm_optT * (3 * optn + 10) + 10);
+
+	return (0);
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	waiter_t		*w;
+	int			i;
+
+	ts->ts_epfd = -1;
+	ts->ts_efd = eventfd(0, 0);
+	if (ts->ts_efd == -1) {
+		return (1);
+	}
+
+	if ((ts->ts_lsn = prepare_listener(ts, 0)) == -1) {
+		perror("prepare_listener");
+		return (1);
+	}
+
+	if (optx == HOW_SHARED &&
+	    (ts->ts_epfd = prepare_epoll(ts, ts->ts_lsn, 0)) == -1) {
+		perror("prepare_epoll");
+		return (1);
+	}
+
+	for (i = 0; i < optn; i++) {
+		w = &ts->ts_w[i];
+		w->w_ts = ts;
+		w->w_id = i;
+		w->w_lsn = ts->ts_lsn;
+		w->w_epfd = ts->ts_epfd;
+
+		switch (optx) {
+		case HOW_EACH:
+			w->w_epfd = prepare_epoll(ts, w->w_lsn, 0);
+			break;
+		case HOW_EXCL:
+			w->w_epfd = prepare_epoll(ts, w->w_lsn,
+			    EPOLLEXCLUSIVE);
+			break;
+		case HOW_REUSEPORT:
+			if (i > 0) {
+				w->w_lsn = prepare_listener(ts,
+				    ts->ts_add.sin_port);
+			}
+			break;
+		}
+
+		if (w->w_lsn == -1 || (w->w_epfd == -1 &&
+		    optx != HOW_ACCEPT && optx != HOW_REUSEPORT)) {
+			perror("initworker");
+			return (1);
+		}
+	}
+
+	for (i = 0; i < optn; i++) {
+		if (pthread_create(&ts->ts_w[i].w_thread, NULL, waiter,
+		    &ts->ts_w[i]) != 0) {
+			return (1);
+		}
+	}
+
+	return (0);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	struct linger		lng;
+	char			c;
+	int			i, s;
+
+	lng.l_onoff = 1;
+	lng.l_linger = 0;
+
+	for (i = 0; i < lm_optB; i++) {
+		s = socket(AF_INET, SOCK_STREAM, 0);
+		if (s == -1) {
+			res->re_errors++;
+			continue;
+		}
+
+		ts->ts_t0 = getnsecs();
+		if (connect(s, (struct sockaddr *)&ts->ts_add,
+		    sizeof (struct sockaddr_in)) == -1 ||
+		    read(s, &c, 1) != 1) {
+			res->re_errors++;
+		}
+
+		/* reset rather than leave a TIME_WAIT behind */
+		(void) setsockopt(s, SOL_SOCKET, SO_LINGER,
+		    &lng, sizeof (lng));
+		(void) close(s);
+	}
+	res->re_count = i;
+
+	return (0);
+}
+
+int
+benchmark_finiworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	long long		one = 1;
+	int			i;
+
+	/*
+	 * shutting a listener down wakes everyone in accept(), the
+	 * eventfd stays readable so every epoll set reports it
+	 */
+	ts->ts_done = 1;
+	(void) write(ts->ts_efd, &one, sizeof (one));
+	for (i = 0; i < optn; i++) {
+		(void) shutdown(ts->ts_w[i].w_lsn, SHUT_RDWR);
+	}
+
+	for (i = 0; i < optn; i++) {
+		(void) pthread_join(ts->ts_w[i].w_thread, NULL);
+		if (ts->ts_w[i].w_lsn != ts->ts_lsn) {
+			(void) close(ts->ts_w[i].w_lsn);
+		}
+		if (ts->ts_w[i].w_epfd != ts->ts_epfd) {
+			(void) close(ts->ts_w[i].w_epfd);
+		}
+	}
+
+	(void) close(ts->ts_lsn);
+	if (optx == HOW_SHARED) {
+		(void) close(ts->ts_epfd);
+	}
+	(void) close(ts->ts_efd);
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	tsd_t			*ts;
+	waiter_t		*w;
+	double			share = 0.0;
+	long long		accepts = 0;
+	long long		csw = 0;
+	long long		lat = 0;
+	long long		max = 0;
+	long long		most, all;
+	int			p, t, i;
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			most = all = 0;
+			for (i = 0; i < optn; i++) {
+				w = &ts->ts_w[i];
+				all += w->w_accepts;
+				csw += w->w_csw;
+				lat += w->w_lat;
+				if (w->w_accepts > most) {
+					most = w->w_accepts;
+				}
+				if (w->w_max > max) {
+					max = w->w_max;
+				}
+			}
+			accepts += all;
+			if (all > 0) {
+				share += 100.0 * (double)most / (double)all;
+			}
+		}
+	}
+
+	/*
+	 * a waiter sleeps once per connection it takes and once more
+	 * to be told to quit; any other sleep followed a wakeup that
+	 * found nothing, whether or not epoll_wait() returned for it
+	 */
+	csw -= accepts + (long long)optn * lm_optP * lm_optT;
+
+	(void) sprintf(result, "%5d %9s %8.2f %8.2f %7.3f %5.1f",
+	    optn, hows[optx],
+	    accepts ? (double)lat / (double)accepts / 1000.0 : 0.0,
+	    (double)max / 1000.0,
+	    accepts && csw > 0 ? (double)csw / (double)accepts : 0.0,
+	    share / (lm_optP * lm_optT));
+
+	return (result);
+}
+
+/*
+ * accept one connection per wakeup, answer it with a byte and
+ * hang up; the latency is taken as soon as the thread is back
+ */
+void *
+waiter(void *arg)
+{
+	waiter_t		*w = (waiter_t *)arg;
+	tsd_t			*ts = w->w_ts;
+	struct epoll_event	ev;
+	struct rusage		ru;
+	long long		t1;
+	int			s;
+
+	for (;;) {
+		if (optx == HOW_ACCEPT || optx == HOW_REUSEPORT) {
+			s = accept(w->w_lsn, NULL, NULL);
+			t1 = getnsecs();
+			if (ts->ts_done) {
+				break;
+			}
+			if (s == -1) {
+				if (errno == EINTR || errno == ECONNABORTED) {
+					continue;
+				}
+				break;
+			}
+		} else {
+			if (epoll_wait(w->w_epfd, &ev, 1, -1) != 1) {
+				if (errno == EINTR) {
+					continue;
+				}
+				break;
+			}
+			t1 = getnsecs();
+			if (ts->ts_done || ev.data.fd == ts->ts_efd) {
+				break;
+			}
+			s = accept(w->w_lsn, NULL, NULL);
+			if (s == -1) {
+				if (errno == EAGAIN) {
+					/* someone else got there first */
+					continue;
+				}
+				break;
+			}
+		}
+
+		t1 -= ts->ts_t0;
+		w->w_lat += t1;
+		if (t1 > w->w_max) {
+			w->w_max = t1;
+		}
+		w->w_accepts++;
+
+		(void) write(s, "", 1);
+		(void) close(s);
+	}
+
+	(void) getrusage(RUSAGE_THREAD, &ru);
+	w->w_csw = ru.ru_nvcsw;
+
+	return (NULL);
+}
+
+/*
+ * listen on an ephemeral loopback port, or join the given one
+ */
+int
+prepare_listener(tsd_t *ts, int port)
+{
+	struct sockaddr_in	add;
+	socklen_t		size = sizeof (struct sockaddr_in);
+	int			opt = 1;
+	int			s;
+
+	if ((s = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+		return (-1);
+	}
+
+	if (optx == HOW_REUSEPORT && setsockopt(s, SOL_SOCKET,
+	    SO_REUSEPORT, &opt, sizeof (int)) == -1) {
+		return (-1);
+	}
+
+	/* the epoll waiters must not block once they lose a race */
+	if (optx != HOW_ACCEPT && optx != HOW_REUSEPORT &&
+	    fcntl(s, F_SETFL, O_NDELAY) == -1) {
+		return (-1);
+	}
+
+	(void) memset(&add, 0, sizeof (struct sockaddr_in));
+	add.sin_family = AF_INET;
+	add.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	add.sin_port = port;
+
+	if (bind(s, (struct sockaddr *)&add, size) == -1 ||
+	    listen(s, 128) == -1) {
+		return (-1);
+	}
+
+	if (port == 0 &&
+	    getsockname(s, (struct sockaddr *)&ts->ts_add, &size) == -1) {
+		return (-1);
+	}
+
+	return (s);
+}
+
+int
+prepare_epoll(tsd_t *ts, int lsn, int flags)
+{
+	struct epoll_event	ev;
+	int			epfd;
+
+	if ((epfd = epoll_create1(0)) == -1) {
+		return (-1);
+	}
+
+	ev.events = EPOLLIN | flags;
+	ev.data.fd = lsn;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, lsn, &ev) == -1) {
+		return (-1);
+	}
+
+	ev.events = EPOLLIN;
+	ev.data.fd = ts->ts_efd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, ts->ts_efd, &ev) == -1) {
+		return (-1);
+	}
+
+	return (epfd);
+}
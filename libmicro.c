@@ -32,6 +32,10 @@
  * benchmarking routines
  */
 
+#ifdef	__linux__
+#define	_GNU_SOURCE		/* RUSAGE_THREAD */
+#endif
+
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/ipc.h>
@@ -46,6 +50,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <poll.h>
+#include <sched.h>
 #include <pthread.h>
 #include <dlfcn.h>
 #include <errno.h>
@@ -57,6 +62,11 @@
 #include <sys/elf.h>
 #endif
 
+#ifdef	__linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
 #include "libmicro.h"
 
 
@@ -1033,6 +1043,362 @@ setfdlimit(int limit)
 	return (0);
 }
 
+/*
+ * cpu (user + system) consumed by the calling thread, in nsecs, or
+ * by the whole process where threads aren't counted apart
+ */
+long long
+cputime()
+{
+	struct rusage		ru;
+
+#if defined(RUSAGE_THREAD)
+	(void) getrusage(RUSAGE_THREAD, &ru);
+#elif defined(RUSAGE_LWP)
+	(void) getrusage(RUSAGE_LWP, &ru);
+#else
+	(void) getrusage(RUSAGE_SELF, &ru);
+#endif
+
+	return ((ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000LL +
+	    (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000LL);
+}
+
+/*
+ * latency histograms are log-linear: values below 8 have a bucket
+ * each, above that every power of two is split into 8, so a bucket
+ * is within 12.5% of its contents
+ */
+int
+bucket(long long v)
+{
+	int			msb;
+
+	if (v < 8) {
+		return (v < 0 ? 0 : (int)v);
+	}
+
+	msb = 63 - __builtin_clzll((unsigned long long)v);
+
+	return ((msb - 2) * 8 + (int)((v >> (msb - 3)) & 7));
+}
+
+/*
+ * the middle of a bucket
+ */
+long long
+bucketval(int b)
+{
+	int			msb;
+
+	if (b < 8) {
+		return (b);
+	}
+
+	msb = b / 8 + 2;
+
+	return (((8LL + b % 8) << (msb - 3)) + ((1LL << (msb - 3)) >> 1));
+}
+
+/*
+ * the value below which pct of a histogram's entries fall
+ */
+long long
+percentile(long long *hist, double pct)
+{
+	long long		n = 0;
+	long long		sum = 0;
+	int			b;
+
+	for (b = 0; b < NBUCKETS; b++) {
+		n += hist[b];
+	}
+
+	for (b = 0; b < NBUCKETS - 1 &&
+	    sum + hist[b] < (long long)(pct * n); b++) {
+		sum += hist[b];
+	}
+
+	return (bucketval(b));
+}
+
+#define	SPINS			1024	/* before giving up the cpu */
+
+/*
+ * one turn round a spin loop: ease off the pipeline, and let
+ * whoever we're waiting on run now and then if we share its cpu
+ */
+void
+relax(int *spins)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+	if (++*spins % SPINS == 0) {
+		(void) sched_yield();
+	}
+}
+
+/*
+ * xorshift64*: quick, and good enough to pick sizes and shuffle
+ * with; state must start non-zero
+ */
+unsigned long long
+rnd(unsigned long long *state)
+{
+	unsigned long long	x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return (x * 2685821657736338717ULL);
+}
+
+/*
+ * whether cpuid says this cpu has the instructions an
+ * implementation needs, by the isa its name starts with
+ */
+int
+impl_usable(char *name)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+
+	if (strncmp(name, "sse2", 4) == 0) {
+		return (__builtin_cpu_supports("sse2"));
+	}
+	if (strncmp(name, "avx2", 4) == 0) {
+		return (__builtin_cpu_supports("avx2"));
+	}
+	if (strncmp(name, "avx512", 6) == 0) {
+		return (__builtin_cpu_supports("avx512f"));
+	}
+#endif
+
+	return (1);
+}
+
+/* the name an implementation table's entries start with */
+#define	IMPLNAME(table, size, i) \
+	(*(char **)((char *)(table) + (i) * (size)))
+
+/*
+ * the implementations in a comma separated list, or all of them
+ * the cpu can run, as indices into a table of size byte entries
+ * ending in a NULL name; -1 for one it doesn't know or can't run
+ */
+int
+impl_list(char *list, void *table, size_t size, int *which, int max)
+{
+	char			*copy, *tok, *last, *name;
+	int			n = 0;
+	int			i;
+
+	if (strcmp(list, "all") == 0) {
+		for (i = 0; (name = IMPLNAME(table, size, i)) != NULL; i++) {
+			if (impl_usable(name) && n < max) {
+				which[n++] = i;
+			}
+		}
+		return (n);
+	}
+
+	if ((copy = strdup(list)) == NULL) {
+		return (-1);
+	}
+
+	for (tok = strtok_r(copy, ",", &last); tok != NULL && n < max;
+	    tok = strtok_r(NULL, ",", &last)) {
+		for (i = 0; (name = IMPLNAME(table, size, i)) != NULL; i++) {
+			if (strcmp(tok, name) == 0) {
+				break;
+			}
+		}
+		if (name == NULL || !impl_usable(name)) {
+			(void) printf("ERROR: this cpu can't run -i %s\n",
+			    tok);
+			free(copy);
+			return (-1);
+		}
+		which[n++] = i;
+	}
+
+	free(copy);
+
+	return (n);
+}
+
+/*
+ * the names in such a table as a|b|c, for usage messages
+ */
+char *
+impl_names(void *table, size_t size, char *names, size_t len)
+{
+	char			*name;
+	int			i;
+
+	names[0] = '\0';
+	for (i = 0; (name = IMPLNAME(table, size, i)) != NULL; i++) {
+		if (strlen(names) + strlen(name) + 2 > len) {
+			break;
+		}
+		if (i > 0) {
+			(void) strcat(names, "|");
+		}
+		(void) strcat(names, name);
+	}
+
+	return (names);
+}
+
+/*
+ * a cpu list as in sysfs and taskset, 0-3,8, into at most max
+ * cpus; returns how many
+ */
+int
+cpulist(char *s, int *list, int max)
+{
+	char			*copy, *tok, *last, *dash;
+	int			n = 0;
+	int			a, b;
+
+	if ((copy = strdup(s)) == NULL) {
+		return (0);
+	}
+
+	for (tok = strtok_r(copy, ",\n", &last); tok != NULL;
+	    tok = strtok_r(NULL, ",\n", &last)) {
+		a = b = atoi(tok);
+		if ((dash = strchr(tok, '-')) != NULL) {
+			b = atoi(dash + 1);
+		}
+		for (; a <= b && n < max; a++) {
+			list[n++] = a;
+		}
+	}
+
+	free(copy);
+
+	return (n);
+}
+
+/*
+ * note when the calling worker's batch started and ended, and
+ * return how long it took
+ */
+long long
+span_stamp(span_t *sp, result_t *res)
+{
+	sp->sp_t0 = res->re_t0;
+	sp->sp_t1 = getnsecs();
+
+	return (sp->sp_t1 - sp->sp_t0);
+}
+
+/*
+ * for the first worker, from finibatch: how long the batch took
+ * from the first worker starting to the last finishing, with each
+ * worker's span_t off bytes into its tsd; the others get 0, and
+ * can't start another batch until the first has returned
+ */
+long long
+span_batch(size_t off)
+{
+	span_t			*sp;
+	long long		t0 = 0;
+	long long		t1 = 0;
+	int			p, t;
+
+	if (getpindex() != 0 || gettindex() != 0) {
+		return (0);
+	}
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			sp = (span_t *)((char *)gettsd(p, t) + off);
+			if (t0 == 0 || sp->sp_t0 < t0) {
+				t0 = sp->sp_t0;
+			}
+			if (sp->sp_t1 > t1) {
+				t1 = sp->sp_t1;
+			}
+		}
+	}
+
+	return (t1 - t0);
+}
+
+/*
+ * a counter of the calling thread's L1D misses, which also count
+ * the lines taken back for writing, and a first reading to count
+ * on from; pf_fd is -1 if we may not count them
+ */
+void
+perf_open(perf_t *pf)
+{
+#ifdef	__linux__
+	struct perf_event_attr	attr;
+
+	(void) memset(&attr, 0, sizeof (attr));
+	attr.size = sizeof (attr);
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.config = PERF_COUNT_HW_CACHE_L1D |
+	    PERF_COUNT_HW_CACHE_OP_READ << 8 |
+	    PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+	    PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	pf->pf_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	pf->pf_fd = -1;
+#endif
+	pf->pf_counted = 0;
+	(void) memset(pf->pf_last, 0, sizeof (pf->pf_last));
+	(void) perf_read(pf);
+}
+
+/*
+ * the count since the last reading, scaled up for any of that time
+ * the counter wasn't scheduled; a virtual machine may open it and
+ * never run it, so pf_counted is set only once it has
+ */
+long long
+perf_read(perf_t *pf)
+{
+	unsigned long long	v[3];	/* count, enabled, running */
+	unsigned long long	running;
+	long long		n;
+
+	if (pf->pf_fd == -1 || read(pf->pf_fd, v, sizeof (v)) != sizeof (v)) {
+		return (0);
+	}
+	if ((running = v[2] - pf->pf_last[2]) == 0) {
+		n = 0;
+	} else {
+		n = (long long)((double)(v[0] - pf->pf_last[0]) *
+		    (v[1] - pf->pf_last[1]) / running);
+		pf->pf_counted = 1;
+	}
+	(void) memcpy(pf->pf_last, v, sizeof (v));
+
+	return (n);
+}
+
+void
+perf_close(perf_t *pf)
+{
+	if (pf->pf_fd != -1) {
+		(void) close(pf->pf_fd);
+		pf->pf_fd = -1;
+	}
+}
+
 
 #define	KILOBYTE		1024
 #define	MEGABYTE		(KILOBYTE * KILOBYTE)
@@ -46,9 +46,24 @@ typedef struct {
 	long long		count;
 } histo_t;
 
+/* when one worker's batch ran, to span all of theirs */
+typedef struct {
+	long long		sp_t0;
+	long long		sp_t1;
+} span_t;
+
+/* a perf counter, and its last reading */
+typedef struct {
+	int			pf_fd;		/* -1 without one */
+	int			pf_counted;	/* it ever ran */
+	unsigned long long	pf_last[3];	/* count, enabled, running */
+} perf_t;
+
 #define	HISTOSIZE		32
 #define	DATASIZE		100000
 
+#define	NBUCKETS		496	/* see bucket() */
+
 /*
  * stats we compute on data sets
  */
@@ -188,6 +203,23 @@ void 		*gettsd(int p, int t);
 long long 	getusecs();
 long long 	getnsecs();
 int 		setfdlimit(int limit);
+long long	cputime();
+int		bucket(long long v);
+long long	bucketval(int b);
+long long	percentile(long long *hist, double pct);
+void		relax(int *spins);
+unsigned long long	rnd(unsigned long long *state);
+int		impl_usable(char *name);
+int		impl_list(char *list, void *table, size_t size, int *which,
+		    int max);
+char		*impl_names(void *table, size_t size, char *names,
+		    size_t len);
+int		cpulist(char *s, int *list, int max);
+long long	span_stamp(span_t *sp, result_t *res);
+long long	span_batch(size_t off);
+void		perf_open(perf_t *pf);
+long long	perf_read(perf_t *pf);
+void		perf_close(perf_t *pf);
 long long 	sizetoll();
 int 		sizetoint();
 int		fit_line(double *, double *, int, double *, double *);
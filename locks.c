@@ -0,0 +1,514 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * lock contention: all -P/-T workers take one lock, hold it for
+ * -c nsecs, and do -w nsecs of other work before coming back for
+ * it; the lock is picked from the table below by name, so the
+ * implementations can be set against one another; Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libmicro.h"
+
+
+/* a queue lock waiter, alone on its cache line */
+typedef struct qnode {
+	int			qn_locked;
+	struct qnode		*qn_next;
+	char			qn_pad[64 - sizeof (int) - sizeof (void *)];
+} qnode_t;
+
+/*
+ * everything any of the locks needs; mapped shared before the
+ * workers fork
+ */
+typedef struct {
+	pthread_mutex_t		lk_mutex;
+	pthread_rwlock_t	lk_rwlock;
+	pthread_spinlock_t	lk_spin;
+	unsigned		lk_next;	/* ticket */
+	unsigned		lk_owner;
+	int			lk_futex;	/* 0 free, 1 held, 2 waiters */
+	qnode_t			*lk_tail;	/* mcs and clh */
+	qnode_t			lk_dummy;	/* clh's first predecessor */
+	long long		lk_count;	/* what the lock protects */
+} lock_t;
+
+typedef struct {
+	qnode_t			ts_node;
+	qnode_t			*ts_clh;	/* our clh node this time */
+	qnode_t			*ts_pred;
+	int			ts_read;	/* rwlock: this op reads */
+	unsigned		ts_seq;
+	long long		ts_ops;
+	long long		ts_writes;
+	long long		ts_nsecs;
+	span_t			ts_batch;	/* this batch */
+	long long		ts_span;	/* first worker: all batches */
+	long long		ts_hist[NBUCKETS];
+} tsd_t;
+
+typedef struct {
+	char			*lo_name;
+	void			(*lo_lock)(tsd_t *);
+	void			(*lo_unlock)(tsd_t *);
+} lockops_t;
+
+void mutex_lock(tsd_t *ts);
+void mutex_unlock(tsd_t *ts);
+void rwlock_lock(tsd_t *ts);
+void rwlock_unlock(tsd_t *ts);
+void spin_lock(tsd_t *ts);
+void spin_unlock(tsd_t *ts);
+void ticket_lock(tsd_t *ts);
+void ticket_unlock(tsd_t *ts);
+void mcs_lock(tsd_t *ts);
+void mcs_unlock(tsd_t *ts);
+void clh_lock(tsd_t *ts);
+void clh_unlock(tsd_t *ts);
+void futex_lock(tsd_t *ts);
+void futex_unlock(tsd_t *ts);
+
+static lockops_t		lockops[] = {
+	{ "mutex",	mutex_lock,	mutex_unlock },
+	{ "adaptive",	mutex_lock,	mutex_unlock },
+	{ "rwlock",	rwlock_lock,	rwlock_unlock },
+	{ "spin",	spin_lock,	spin_unlock },
+	{ "ticket",	ticket_lock,	ticket_unlock },
+	{ "mcs",	mcs_lock,	mcs_unlock },
+	{ "clh",	clh_lock,	clh_unlock },
+	{ "futex",	futex_lock,	futex_unlock },
+	{ NULL,		NULL,		NULL }
+};
+
+static lockops_t		*optl = &lockops[0];
+static int			optc = 0;
+static int			optr = 0;
+static int			optw = 0;
+static int			priv;		/* FUTEX_PRIVATE_FLAG or 0 */
+static lock_t			*lk;
+
+
+int
+benchmark_init()
+{
+	lm_tsdsize = sizeof (tsd_t);
+
+	(void) sprintf(lm_optstr, "c:l:r:w:");
+
+	(void) sprintf(lm_usage,
+	    "       [-c critical section nsecs (default 0)]\n"
+	    "       [-l mutex|adaptive|rwlock|spin|ticket|mcs|clh|futex "
+	    "(default mutex)]\n"
+	    "       [-r percentage of rwlock ops that read (default 0)]\n"
+	    "       [-w nsecs of work between acquisitions (default 0)]\n"
+	    "notes: Mops/s is acquisitions for all workers together;\n"
+	    "       the percentiles are of the time taken to acquire, in\n"
+	    "       nsecs; fair is the slowest worker's rate over the\n"
+	    "       fastest's; lost counts updates the lock failed to\n"
+	    "       protect, and should be 0\n");
+
+	(void) sprintf(lm_header, "%8s %5s %5s %3s %8s %7s %7s %7s %5s %4s",
+	    "lock", "cs", "work", "rd%", "Mops/s", "p50", "p99", "p999",
+	    "fair", "lost");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	lockops_t		*lo;
+
+	switch (opt) {
+	case 'c':
+		optc = sizetoint(optarg);
+		break;
+	case 'l':
+		for (lo = lockops; lo->lo_name != NULL; lo++) {
+			if (strcmp(optarg, lo->lo_name) == 0) {
+				break;
+			}
+		}
+		if (lo->lo_name == NULL) {
+			return (-1);
+		}
+		optl = lo;
+		break;
+	case 'r':
+		optr = atoi(optarg);
+		break;
+	case 'w':
+		optw = sizetoint(optarg);
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+int
+benchmark_initrun()
+{
+	pthread_mutexattr_t	ma;
+	pthread_rwlockattr_t	ra;
+	int			pshared;
+
+	if (optr < 0 || optr > 100) {
+		(void) printf("ERROR: -r must be between 0 and 100\n");
+		return (-1);
+	}
+
+	/*LINTED*/
+	lk = (lock_t *)mmap(NULL, sizeof (lock_t), PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_ANON, -1, 0L);
+	if (lk == MAP_FAILED) {
+		perror("mmap");
+		return (-1);
+	}
+
+	pshared = lm_optP > 1 ? PTHREAD_PROCESS_SHARED :
+	    PTHREAD_PROCESS_PRIVATE;
+	priv = lm_optP > 1 ? 0 : FUTEX_PRIVATE_FLAG;
+
+	(void) pthread_mutexattr_init(&ma);
+	(void) pthread_mutexattr_setpshared(&ma, pshared);
+	if (strcmp(optl->lo_name, "adaptive") == 0) {
+		(void) pthread_mutexattr_settype(&ma,
+		    PTHREAD_MUTEX_ADAPTIVE_NP);
+	}
+	(void) pthread_rwlockattr_init(&ra);
+	(void) pthread_rwlockattr_setpshared(&ra, pshared);
+
+	if (pthread_mutex_init(&lk->lk_mutex, &ma) != 0 ||
+	    pthread_rwlock_init(&lk->lk_rwlock, &ra) != 0 ||
+	    pthread_spin_init(&lk->lk_spin, pshared) != 0) {
+		return (-1);
+	}
+
+	lk->lk_tail = strcmp(optl->lo_name, "clh") == 0 ? &lk->lk_dummy : NULL;
+
+	return (0);
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	ts->ts_clh = &ts->ts_node;
+
+	return (0);
+}
+
+/*
+ * busy for nsecs, without touching anything shared
+ */
+static void
+spinns(int nsecs)
+{
+	long long		s;
+
+	if (nsecs <= 0) {
+		return;
+	}
+
+	s = getnsecs();
+	while (getnsecs() - s < nsecs)
+		;
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	long long		t0;
+	int			i;
+
+	for (i = 0; i < lm_optB; i++) {
+		ts->ts_read = optr > 0 && ts->ts_seq++ % 100 < optr;
+
+		t0 = getnsecs();
+		optl->lo_lock(ts);
+		ts->ts_hist[bucket(getnsecs() - t0)]++;
+
+		if (ts->ts_read) {
+			(void) *(volatile long long *)&lk->lk_count;
+		} else {
+			(*(volatile long long *)&lk->lk_count)++;
+			ts->ts_writes++;
+		}
+		spinns(optc);
+
+		optl->lo_unlock(ts);
+
+		spinns(optw);
+	}
+	res->re_count = i;
+
+	ts->ts_ops += i;
+	ts->ts_nsecs += span_stamp(&ts->ts_batch, res);
+
+	return (0);
+}
+
+int
+benchmark_finibatch(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	ts->ts_span += span_batch(offsetof(tsd_t, ts_batch));
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	static long long	hist[NBUCKETS];
+	static double		pcts[] = { 0.50, 0.99, 0.999 };
+	long long		pct[3];
+	tsd_t			*ts;
+	long long		ops = 0;
+	long long		writes = 0;
+	double			rate, lo = 0.0, hi = 0.0;
+	int			p, t, b, k;
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			ops += ts->ts_ops;
+			writes += ts->ts_writes;
+			if (ts->ts_nsecs > 0) {
+				rate = (double)ts->ts_ops /
+				    (double)ts->ts_nsecs;
+				if (lo == 0.0 || rate < lo) {
+					lo = rate;
+				}
+				if (rate > hi) {
+					hi = rate;
+				}
+			}
+			for (b = 0; b < NBUCKETS; b++) {
+				hist[b] += ts->ts_hist[b];
+			}
+		}
+	}
+
+	for (k = 0; k < 3; k++) {
+		pct[k] = percentile(hist, pcts[k]);
+	}
+
+	ts = (tsd_t *)gettsd(0, 0);
+	(void) sprintf(result,
+	    "%8s %5d %5d %3d %8.2f %7lld %7lld %7lld %5.2f %4lld",
+	    optl->lo_name, optc, optw, optr,
+	    ts->ts_span ? (double)ops * 1.0e3 / (double)ts->ts_span : 0.0,
+	    pct[0], pct[1], pct[2], hi > 0.0 ? lo / hi : 0.0,
+	    writes - lk->lk_count);
+
+	return (result);
+}
+
+void
+mutex_lock(tsd_t *ts)
+{
+	(void) pthread_mutex_lock(&lk->lk_mutex);
+}
+
+void
+mutex_unlock(tsd_t *ts)
+{
+	(void) pthread_mutex_unlock(&lk->lk_mutex);
+}
+
+void
+rwlock_lock(tsd_t *ts)
+{
+	if (ts->ts_read) {
+		(void) pthread_rwlock_rdlock(&lk->lk_rwlock);
+	} else {
+		(void) pthread_rwlock_wrlock(&lk->lk_rwlock);
+	}
+}
+
+void
+rwlock_unlock(tsd_t *ts)
+{
+	(void) pthread_rwlock_unlock(&lk->lk_rwlock);
+}
+
+void
+spin_lock(tsd_t *ts)
+{
+	(void) pthread_spin_lock(&lk->lk_spin);
+}
+
+void
+spin_unlock(tsd_t *ts)
+{
+	(void) pthread_spin_unlock(&lk->lk_spin);
+}
+
+/*
+ * take a number, wait for it to come up
+ */
+void
+ticket_lock(tsd_t *ts)
+{
+	unsigned		me;
+	int			spins = 0;
+
+	me = __atomic_fetch_add(&lk->lk_next, 1, __ATOMIC_RELAXED);
+	while (__atomic_load_n(&lk->lk_owner, __ATOMIC_ACQUIRE) != me) {
+		relax(&spins);
+	}
+}
+
+void
+ticket_unlock(tsd_t *ts)
+{
+	__atomic_store_n(&lk->lk_owner, lk->lk_owner + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Mellor-Crummey and Scott: join the queue, spin on our own node
+ * until the holder before us hands over
+ */
+void
+mcs_lock(tsd_t *ts)
+{
+	qnode_t			*me = &ts->ts_node;
+	qnode_t			*pred;
+	int			spins = 0;
+
+	me->qn_next = NULL;
+	__atomic_store_n(&me->qn_locked, 1, __ATOMIC_RELAXED);
+
+	pred = __atomic_exchange_n(&lk->lk_tail, me, __ATOMIC_ACQ_REL);
+	if (pred == NULL) {
+		return;
+	}
+
+	__atomic_store_n(&pred->qn_next, me, __ATOMIC_RELEASE);
+	while (__atomic_load_n(&me->qn_locked, __ATOMIC_ACQUIRE)) {
+		relax(&spins);
+	}
+}
+
+void
+mcs_unlock(tsd_t *ts)
+{
+	qnode_t			*me = &ts->ts_node;
+	qnode_t			*next;
+	qnode_t			*expected = me;
+	int			spins = 0;
+
+	next = __atomic_load_n(&me->qn_next, __ATOMIC_ACQUIRE);
+	if (next == NULL) {
+		if (__atomic_compare_exchange_n(&lk->lk_tail, &expected,
+		    NULL, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+			return;
+		}
+		/* someone's joining, wait for them to say who */
+		while ((next = __atomic_load_n(&me->qn_next,
+		    __ATOMIC_ACQUIRE)) == NULL) {
+			relax(&spins);
+		}
+	}
+
+	__atomic_store_n(&next->qn_locked, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Craig, Landin and Hagersten: spin on our predecessor's node,
+ * and take it over as ours for next time
+ */
+void
+clh_lock(tsd_t *ts)
+{
+	qnode_t			*me = ts->ts_clh;
+	int			spins = 0;
+
+	__atomic_store_n(&me->qn_locked, 1, __ATOMIC_RELAXED);
+	ts->ts_pred = __atomic_exchange_n(&lk->lk_tail, me, __ATOMIC_ACQ_REL);
+	while (__atomic_load_n(&ts->ts_pred->qn_locked, __ATOMIC_ACQUIRE)) {
+		relax(&spins);
+	}
+}
+
+void
+clh_unlock(tsd_t *ts)
+{
+	__atomic_store_n(&ts->ts_clh->qn_locked, 0, __ATOMIC_RELEASE);
+	ts->ts_clh = ts->ts_pred;
+}
+
+/*
+ * Drepper's three state futex mutex, from "Futexes Are Tricky"
+ */
+void
+futex_lock(tsd_t *ts)
+{
+	int			c = 0;
+
+	if (__atomic_compare_exchange_n(&lk->lk_futex, &c, 1, 0,
+	    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		return;
+	}
+
+	if (c != 2) {
+		c = __atomic_exchange_n(&lk->lk_futex, 2, __ATOMIC_ACQUIRE);
+	}
+	while (c != 0) {
+		(void) syscall(SYS_futex, &lk->lk_futex, FUTEX_WAIT | priv, 2,
+		    NULL, NULL, 0);
+		c = __atomic_exchange_n(&lk->lk_futex, 2, __ATOMIC_ACQUIRE);
+	}
+}
+
+void
+futex_unlock(tsd_t *ts)
+{
+	if (__atomic_fetch_sub(&lk->lk_futex, 1, __ATOMIC_RELEASE) != 1) {
+		__atomic_store_n(&lk->lk_futex, 0, __ATOMIC_RELEASE);
+		(void) syscall(SYS_futex, &lk->lk_futex, FUTEX_WAKE | priv, 1,
+		    NULL, NULL, 0);
+	}
+}
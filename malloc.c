@@ -29,7 +29,7 @@
  */
 
 /*
- * malloc benchmark (crude)
+ * malloc benchmark (crude), of libc's or one of allocimpl.c's
  */
 
 
@@ -40,10 +40,13 @@
 #include <string.h>
 
 #include "libmicro.h"
+#include "allocimpl.h"
 
 static int		optg = 100;
 static int		opts[32] = {32};
 static int		optscnt = 0;
+static char		*opti = "libc";
+static allocimpl_t	*impl;
 
 typedef struct {
 	void 			**ts_glob;
@@ -54,16 +57,19 @@ benchmark_init()
 {
 	lm_tsdsize = sizeof (tsd_t);
 
-	(void) sprintf(lm_optstr, "s:g:");
+	(void) sprintf(lm_optstr, "i:s:g:");
 
 	(void) sprintf(lm_usage,
 	    "       [-g number of mallocs before free (default %d)]\n"
+	    "       [-i %s (default libc)]\n"
 	    "       [-s size to malloc (default %d)."
 	    "  Up to 32 sizes accepted\n"
-	    "notes: measures malloc()/free()",
-	    optg, opts[0]);
+	    "notes: measures malloc()/free(); the pool's objects are\n"
+	    "       the largest size, and the arena is reset after the\n"
+	    "       frees",
+	    optg, allocimpl_names(), opts[0]);
 
-	(void) sprintf(lm_header, "%6s %6s", "glob", "sizes");
+	(void) sprintf(lm_header, "%6s %5s %6s", "glob", "impl", "sizes");
 
 	return (0);
 }
@@ -75,6 +81,9 @@ benchmark_optswitch(int opt, char *optarg)
 	case 'g':
 		optg = sizetoint(optarg);
 		break;
+	case 'i':
+		opti = optarg;
+		break;
 	case 's':
 		opts[optscnt] = sizetoint(optarg);
 		optscnt = ++optscnt & (31);
@@ -87,13 +96,29 @@ benchmark_optswitch(int opt, char *optarg)
 }
 
 int
-benchmark_initworker(void *tsd)
+benchmark_initrun()
 {
-	tsd_t			*ts = (tsd_t *)tsd;
+	int			i, max = 0;
 
 	if (optscnt == 0)
 		optscnt = 1;
 
+	for (i = 0; i < optscnt; i++) {
+		if (opts[i] > max)
+			max = opts[i];
+	}
+
+	if ((impl = allocimpl_find(opti, max)) == NULL)
+		return (-1);
+
+	return (0);
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
 	ts->ts_glob = malloc(sizeof (void *)* optg);
 	if (ts->ts_glob == NULL) {
 		return (1);
@@ -109,14 +134,17 @@ benchmark(void *tsd, result_t *res)
 
 	for (i = 0; i < lm_optB; i++) {
 		for (k = j = 0; j < optg; j++) {
-			if ((ts->ts_glob[j] = malloc(opts[k++])) == NULL)
+			if ((ts->ts_glob[j] = impl->ai_malloc(opts[k++]))
+			    == NULL)
 				res->re_errors++;
 			if (k >= optscnt)
 				k = 0;
 		}
 		for (j = 0; j < optg; j++) {
-			free(ts->ts_glob[j]);
+			impl->ai_free(ts->ts_glob[j]);
 		}
+		if (impl->ai_reset != NULL)
+			impl->ai_reset();
 	}
 
 	res->re_count = i * j;
@@ -130,7 +158,7 @@ benchmark_result()
 	static char  result[256];
 	int i;
 
-	(void) sprintf(result, "%6d ", optg);
+	(void) sprintf(result, "%6d %5s ", optg, impl->ai_name);
 
 	for (i = 0; i < optscnt; i++)
 		(void) sprintf(result + strlen(result), "%d ", opts[i]);
@@ -0,0 +1,779 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+
+/*
+ * replays a trace of malloc, calloc, memalign, realloc and free
+ * calls, read from a file or made up from size and lifetime
+ * distributions, across the -T threads of each process; a block one
+ * thread allocates may be freed by another, which waits its turn.
+ * The calls go to libc or one of allocimpl.c's allocators.  Reports
+ * ops/s, call latency percentiles, the resident memory the allocator
+ * holds against what the trace has live and, where perf counters are
+ * allowed, L1D misses; Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <math.h>
+
+#include "libmicro.h"
+#include "sizedist.h"
+#include "allocimpl.h"
+
+#define	DEFN			10000
+#define	DEFQ			16
+#define	MAXIDS			(1 << 26)
+#define	MAGIC			"LMTRACE1"
+
+/*
+ * one call, as it is in a trace file after the magic: the thread
+ * is taken modulo -T, and a block's id may be reused once it has
+ * been freed
+ */
+typedef struct {
+	unsigned char		tr_op;
+	unsigned char		tr_thread;
+	unsigned char		tr_align;	/* log2, memalign */
+	unsigned char		tr_pad;
+	unsigned int		tr_id;
+	unsigned long long	tr_size;
+} trace_t;
+
+#define	TR_MALLOC		0
+#define	TR_CALLOC		1
+#define	TR_MEMALIGN		2
+#define	TR_REALLOC		3
+#define	TR_FREE			4
+#define	TR_NOPS			5
+
+/* a block; the sequence says how many calls it has seen */
+typedef struct {
+	unsigned long long	sl_seq;
+	void			*sl_ptr;
+} slot_t;
+
+typedef struct {
+	long long		ts_ops;
+	long long		ts_passes;
+	span_t			ts_batch;	/* this batch */
+	long long		ts_span;	/* first worker: all batches */
+	long long		ts_rss0;	/* first thread: kbytes */
+	long long		ts_peak;
+	long long		ts_final;
+	perf_t			ts_perf;	/* L1D misses */
+	long long		ts_misses;
+	long long		ts_hist[NBUCKETS];
+} tsd_t;
+
+static int			opta = 0;
+static int			optc = 0;
+static char			*opti = "libc";
+static char			defd[] = "log:16-4k";	/* sizedist writes it */
+static char			*optd = defd;
+static char			*optf = NULL;
+static char			*optl = "exp:100";
+static int			optn = DEFN;
+static int			optq = DEFQ;
+static int			optr = 0;
+static char			*optw = NULL;
+static int			optx = 0;
+
+static trace_t			*trace;
+static long			ntrace;
+static unsigned			*seqs;		/* of each call, per block */
+static unsigned			*slotops;	/* calls per block per pass */
+static slot_t			*slots;
+static unsigned			nids;
+static long			**mine;		/* each thread's calls */
+static long			*nmine;
+static long long		peaklive;
+static unsigned long long	maxsize;
+static allocimpl_t		*impl;
+static long			pagesize;
+
+
+int
+benchmark_init()
+{
+	lm_tsdsize = sizeof (tsd_t);
+
+	(void) sprintf(lm_optstr, "a:c:d:f:i:l:n:q:r:w:x:");
+
+	(void) sprintf(lm_usage,
+	    "       [-f trace file to replay]\n"
+	    "       [-i %s (default libc)]\n"
+	    "       [-w trace file to write what's made up]\n"
+	    "       [-n allocations to make up (default %d)]\n"
+	    "       [-d size dist (default %s)]\n"
+	    "       [-l lifetime in allocations, n, uniform:lo-hi or\n"
+	    "           exp:mean (default %s)]\n"
+	    "       [-a percentage of allocations by memalign]\n"
+	    "       [-c percentage of allocations by calloc]\n"
+	    "       [-r percentage of blocks reallocated, per lifetime]\n"
+	    "       [-x percentage of frees by another thread]\n"
+	    "       [-q time every qth call (default %d)]\n"
+	    SD_USAGE
+	    "notes: p50 and on are nsecs per call; peak and final are\n"
+	    "       kbytes resident above the start, frag peak over the\n"
+	    "       most bytes live; miss/op is L1D misses from perf\n",
+	    allocimpl_names(), DEFN, optd, optl, DEFQ);
+
+	(void) sprintf(lm_header,
+	    "%5s %5s %3s %8s %8s %6s %6s %6s %8s %8s %5s %7s",
+	    "trace", "impl", "thr", "calls", "Mop/s", "p50", "p99", "p999",
+	    "peak", "final", "frag", "miss/op");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	switch (opt) {
+	case 'a':
+		opta = atoi(optarg);
+		break;
+	case 'c':
+		optc = atoi(optarg);
+		break;
+	case 'd':
+		optd = optarg;
+		break;
+	case 'f':
+		optf = optarg;
+		break;
+	case 'i':
+		opti = optarg;
+		break;
+	case 'l':
+		optl = optarg;
+		break;
+	case 'n':
+		optn = sizetoint(optarg);
+		break;
+	case 'q':
+		optq = atoi(optarg);
+		break;
+	case 'r':
+		optr = atoi(optarg);
+		break;
+	case 'w':
+		optw = optarg;
+		break;
+	case 'x':
+		optx = atoi(optarg);
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+static int
+percent(unsigned long long *state, int pct)
+{
+	return ((int)(rnd(state) % 100) < pct);
+}
+
+/*
+ * a lifetime drawn from -l, in allocations
+ */
+static long
+lifetime(unsigned long long *state)
+{
+	long			lo, hi;
+
+	if (strncmp(optl, "exp:", 4) == 0) {
+		return ((long)(-log(1.0 - (rnd(state) >> 11) *
+		    (1.0 / 9007199254740992.0)) * atol(optl + 4)));
+	}
+	if (sscanf(optl, "uniform:%ld-%ld", &lo, &hi) == 2) {
+		return (lo + (long)(rnd(state) % (hi - lo + 1)));
+	}
+
+	return (atol(optl));
+}
+
+static int
+append(long *max, trace_t *tr)
+{
+	trace_t			*more;
+
+	if (ntrace == *max) {
+		*max = *max ? *max * 2 : 1024;
+		if ((more = realloc(trace, *max * sizeof (trace_t))) == NULL) {
+			return (-1);
+		}
+		trace = more;
+	}
+	trace[ntrace++] = *tr;
+
+	return (0);
+}
+
+/*
+ * the made-up trace: allocation i is by thread i % -T and lives for
+ * a drawn number of the allocations after it, at the end of which
+ * it may be reallocated to live as long again, or else is freed
+ */
+static int
+generate(long *max)
+{
+	static sizedist_t	sd;
+	unsigned long long	state = 0x9e3779b97f4a7c15ULL;
+	trace_t			tr;
+	long			*head, *next;
+	long			i, id, d;
+
+	if (sizedist_init(&sd, optd, 0, NULL, 0) == -1) {
+		(void) printf("ERROR: -d %s isn't a size dist\n", optd);
+		return (-1);
+	}
+	if (strncmp(optl, "exp:", 4) != 0 &&
+	    strncmp(optl, "uniform:", 8) != 0 &&
+	    (*optl < '0' || *optl > '9')) {
+		(void) printf("ERROR: -l %s isn't a lifetime\n", optl);
+		return (-1);
+	}
+
+	/* the blocks to go at each allocation, linked through next */
+	head = malloc((optn + 1) * sizeof (long));
+	next = malloc(optn * sizeof (long));
+	if (head == NULL || next == NULL) {
+		return (-1);
+	}
+	for (i = 0; i <= optn; i++) {
+		head[i] = -1;
+	}
+
+	(void) memset(&tr, 0, sizeof (tr));
+	for (i = 0; i <= optn; i++) {
+		while ((id = head[i]) != -1) {
+			head[i] = next[id];
+			tr.tr_id = id;
+			tr.tr_thread = id % lm_optT;
+			if (i < optn && percent(&state, optr)) {
+				tr.tr_op = TR_REALLOC;
+				tr.tr_size = sd.sd_size[rnd(&state) %
+				    SD_N];
+				d = i + 1 + lifetime(&state);
+				d = d > optn ? optn : d;
+				next[id] = head[d];
+				head[d] = id;
+			} else {
+				tr.tr_op = TR_FREE;
+				tr.tr_size = 0;
+				if (lm_optT > 1 && percent(&state, optx)) {
+					tr.tr_thread = (id + 1 + rnd(&state) %
+					    (lm_optT - 1)) % lm_optT;
+				}
+			}
+			if (append(max, &tr) == -1) {
+				return (-1);
+			}
+		}
+		if (i == optn) {
+			break;
+		}
+
+		tr.tr_id = i;
+		tr.tr_thread = i % lm_optT;
+		tr.tr_size = sd.sd_size[i % SD_N];
+		tr.tr_align = 0;
+		d = rnd(&state) % 100;
+		if (d < opta) {
+			tr.tr_op = TR_MEMALIGN;
+			tr.tr_align = 6 + rnd(&state) % 7;
+		} else if (d < opta + optc) {
+			tr.tr_op = TR_CALLOC;
+		} else {
+			tr.tr_op = TR_MALLOC;
+		}
+		if (append(max, &tr) == -1) {
+			return (-1);
+		}
+		d = i + 1 + lifetime(&state);
+		d = d > optn ? optn : d;
+		next[i] = head[d];
+		head[d] = i;
+	}
+
+	free(head);
+	free(next);
+
+	return (0);
+}
+
+static int
+readtrace(long *max)
+{
+	char			magic[8];
+	trace_t			tr;
+	FILE			*fp;
+
+	if ((fp = fopen(optf, "r")) == NULL) {
+		perror(optf);
+		return (-1);
+	}
+	if (fread(magic, sizeof (magic), 1, fp) != 1 ||
+	    memcmp(magic, MAGIC, sizeof (magic)) != 0) {
+		(void) printf("ERROR: %s isn't a trace\n", optf);
+		(void) fclose(fp);
+		return (-1);
+	}
+	while (fread(&tr, sizeof (tr), 1, fp) == 1) {
+		if (append(max, &tr) == -1) {
+			(void) fclose(fp);
+			return (-1);
+		}
+	}
+	(void) fclose(fp);
+
+	return (0);
+}
+
+static int
+writetrace()
+{
+	FILE			*fp;
+
+	if ((fp = fopen(optw, "w")) == NULL) {
+		perror(optw);
+		return (-1);
+	}
+	if (fwrite(MAGIC, 8, 1, fp) != 1 ||
+	    fwrite(trace, sizeof (trace_t), ntrace, fp) != ntrace) {
+		perror(optw);
+		(void) fclose(fp);
+		return (-1);
+	}
+
+	return (fclose(fp));
+}
+
+/*
+ * checks each block is allocated before it is reallocated or freed,
+ * frees any left at the end so that every pass starts empty, numbers
+ * each block's calls and shares the calls out among the threads
+ */
+static int
+prepare(long *max)
+{
+	long long		*live;		/* bytes, -1 if free */
+	long long		bytes = 0;
+	unsigned		*last;		/* thread of the last call */
+	trace_t			tr;
+	long			i, n;
+	int			t;
+
+	for (i = 0, nids = 0; i < ntrace; i++) {
+		if (trace[i].tr_op >= TR_NOPS || trace[i].tr_id >= MAXIDS ||
+		    (trace[i].tr_op == TR_MEMALIGN &&
+		    trace[i].tr_align > 20)) {
+			(void) printf("ERROR: call %ld is garbled\n", i);
+			return (-1);
+		}
+		if (trace[i].tr_id >= nids) {
+			nids = trace[i].tr_id + 1;
+		}
+	}
+
+	live = malloc(nids * sizeof (long long));
+	last = calloc(nids, sizeof (unsigned));
+	slotops = calloc(nids, sizeof (unsigned));
+	slots = calloc(nids, sizeof (slot_t));
+	if (live == NULL || last == NULL || slotops == NULL ||
+	    slots == NULL) {
+		return (-1);
+	}
+	for (i = 0; i < nids; i++) {
+		live[i] = -1;
+	}
+
+	for (i = 0, n = ntrace; i < n; i++) {
+		tr = trace[i];
+		if ((tr.tr_op < TR_REALLOC) != (live[tr.tr_id] == -1) ||
+		    (tr.tr_op != TR_FREE && tr.tr_size == 0)) {
+			(void) printf("ERROR: call %ld is out of turn\n", i);
+			return (-1);
+		}
+		if (tr.tr_op >= TR_REALLOC) {
+			bytes -= live[tr.tr_id];
+		}
+		if (tr.tr_op == TR_FREE) {
+			live[tr.tr_id] = -1;
+		} else {
+			live[tr.tr_id] = tr.tr_size;
+			bytes += tr.tr_size;
+		}
+		if (tr.tr_size > maxsize) {
+			maxsize = tr.tr_size;
+		}
+		if (bytes > peaklive) {
+			peaklive = bytes;
+		}
+		last[tr.tr_id] = tr.tr_thread;
+	}
+
+	(void) memset(&tr, 0, sizeof (tr));
+	tr.tr_op = TR_FREE;
+	for (i = 0; i < nids; i++) {
+		if (live[i] != -1) {
+			tr.tr_id = i;
+			tr.tr_thread = last[i];
+			if (append(max, &tr) == -1) {
+				return (-1);
+			}
+		}
+	}
+
+	seqs = malloc(ntrace * sizeof (unsigned));
+	mine = calloc(lm_optT, sizeof (long *));
+	nmine = calloc(lm_optT, sizeof (long));
+	if (seqs == NULL || mine == NULL || nmine == NULL) {
+		return (-1);
+	}
+	for (i = 0; i < ntrace; i++) {
+		seqs[i] = slotops[trace[i].tr_id]++;
+		nmine[trace[i].tr_thread % lm_optT]++;
+	}
+	for (t = 0; t < lm_optT; t++) {
+		if ((mine[t] = malloc((nmine[t] + 1) * sizeof (long))) ==
+		    NULL) {
+			return (-1);
+		}
+		nmine[t] = 0;
+	}
+	for (i = 0; i < ntrace; i++) {
+		t = trace[i].tr_thread % lm_optT;
+		mine[t][nmine[t]++] = i;
+	}
+
+	free(live);
+	free(last);
+
+	return (0);
+}
+
+/*
+ * the trace is read or made up before the workers fork, so each
+ * process replays it into blocks of its own
+ */
+int
+benchmark_initrun()
+{
+	long			max = 0;
+
+	pagesize = sysconf(_SC_PAGESIZE);
+
+	if (lm_optT > 256) {
+		(void) printf("ERROR: a trace has at most 256 threads\n");
+		return (-1);
+	}
+	if (optq < 1) {
+		(void) printf("ERROR: -q must be at least 1\n");
+		return (-1);
+	}
+	if (opta < 0 || optc < 0 || opta + optc > 100 ||
+	    optr < 0 || optr > 90 || optx < 0 || optx > 100) {
+		(void) printf("ERROR: -a and -c may add up to 100, "
+		    "-r be 90 and -x 100\n");
+		return (-1);
+	}
+
+	if ((optf != NULL ? readtrace(&max) : generate(&max)) == -1) {
+		return (-1);
+	}
+	if (optw != NULL && writetrace() == -1) {
+		return (-1);
+	}
+	if (prepare(&max) == -1) {
+		(void) printf("ERROR: can't prepare the trace\n");
+		return (-1);
+	}
+	if ((impl = allocimpl_find(opti, maxsize)) == NULL) {
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*
+ * kbytes resident, now or at most since clear_refs was last told
+ */
+static long long
+rss(char *field)
+{
+	char			line[128];
+	long long		kb = 0;
+	FILE			*fp;
+	size_t			len = strlen(field);
+
+	if ((fp = fopen("/proc/self/status", "r")) == NULL) {
+		return (0);
+	}
+	while (fgets(line, sizeof (line), fp) != NULL) {
+		if (strncmp(line, field, len) == 0) {
+			kb = atoll(line + len);
+			break;
+		}
+	}
+	(void) fclose(fp);
+
+	return (kb);
+}
+
+static void
+resetpeak()
+{
+	int			fd;
+
+	if ((fd = open("/proc/self/clear_refs", O_WRONLY)) != -1) {
+		(void) write(fd, "5", 1);
+		(void) close(fd);
+	}
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	if (gettindex() == 0) {
+		resetpeak();
+		ts->ts_rss0 = rss("VmRSS:");
+	}
+	perf_open(&ts->ts_perf);
+
+	return (0);
+}
+
+/*
+ * a call takes well under the microsecond getnsecs() may tick in
+ */
+static long long
+now()
+{
+	struct timespec		ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (ts.tv_sec * 1000000000LL + ts.tv_nsec);
+}
+
+/* a block's pages are written, as its user would */
+static void
+touch(char *p, size_t size)
+{
+	size_t			i;
+
+	for (i = 0; i < size; i += pagesize) {
+		p[i] = 1;
+	}
+}
+
+/*
+ * this thread's calls, each once the block's previous call, on
+ * whichever thread, has been made
+ */
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	long			*calls = mine[gettindex()];
+	long			n = nmine[gettindex()];
+	unsigned long long	want;
+	long long		t0 = 0;
+	trace_t			*tr;
+	slot_t			*sl;
+	void			*p;
+	long			i, k;
+	int			spins;
+
+	(void) perf_read(&ts->ts_perf);
+
+	for (i = 0; i < lm_optB; i++, ts->ts_passes++) {
+		for (k = 0; k < n; k++) {
+			tr = &trace[calls[k]];
+			sl = &slots[tr->tr_id];
+			want = ts->ts_passes * slotops[tr->tr_id] +
+			    seqs[calls[k]];
+			spins = 0;
+			while (__atomic_load_n(&sl->sl_seq,
+			    __ATOMIC_ACQUIRE) != want) {
+				relax(&spins);
+			}
+
+			if (++ts->ts_ops % optq == 0) {
+				t0 = now();
+			}
+			p = NULL;
+			switch (tr->tr_op) {
+			case TR_MALLOC:
+				p = impl->ai_malloc(tr->tr_size);
+				break;
+			case TR_CALLOC:
+				p = impl->ai_calloc(1, tr->tr_size);
+				break;
+			case TR_MEMALIGN:
+				if (impl->ai_memalign(&p,
+				    (size_t)1 << tr->tr_align,
+				    tr->tr_size) != 0) {
+					p = NULL;
+				}
+				break;
+			case TR_REALLOC:
+				p = impl->ai_realloc(sl->sl_ptr,
+				    tr->tr_size);
+				break;
+			case TR_FREE:
+				impl->ai_free(sl->sl_ptr);
+				break;
+			}
+			if (ts->ts_ops % optq == 0) {
+				ts->ts_hist[bucket(now() - t0)]++;
+			}
+
+			if (tr->tr_op == TR_FREE) {
+				sl->sl_ptr = NULL;
+			} else if (p == NULL) {
+				res->re_errors++;
+			} else {
+				sl->sl_ptr = p;
+				touch(p, tr->tr_size);
+			}
+
+			__atomic_store_n(&sl->sl_seq, want + 1,
+			    __ATOMIC_RELEASE);
+		}
+	}
+	res->re_count = i * n;
+
+	ts->ts_misses += perf_read(&ts->ts_perf);
+
+	(void) span_stamp(&ts->ts_batch, res);
+
+	return (0);
+}
+
+/*
+ * each thread rewinds its arena, every block in it dead
+ */
+int
+benchmark_finibatch(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	if (impl->ai_reset != NULL) {
+		impl->ai_reset();
+	}
+
+	ts->ts_span += span_batch(offsetof(tsd_t, ts_batch));
+
+	return (0);
+}
+
+/*
+ * every block is free again by now, so final is what the allocator
+ * kept hold of
+ */
+int
+benchmark_finiworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	if (gettindex() == 0) {
+		ts->ts_peak = rss("VmHWM:") - ts->ts_rss0;
+		ts->ts_final = rss("VmRSS:") - ts->ts_rss0;
+	}
+	perf_close(&ts->ts_perf);
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	static long long	hist[NBUCKETS];
+	static double		pcts[] = { 0.50, 0.99, 0.999 };
+	long long		pct[3];
+	tsd_t			*ts;
+	long long		ops = 0;
+	long long		peak = 0;
+	long long		final = 0;
+	long long		misses = 0;
+	char			miss[32];
+	int			perf = 1;
+	int			p, t, b, k;
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			ops += ts->ts_ops;
+			misses += ts->ts_misses;
+			if (!ts->ts_perf.pf_counted) {
+				perf = 0;
+			}
+			for (b = 0; b < NBUCKETS; b++) {
+				hist[b] += ts->ts_hist[b];
+			}
+		}
+		ts = (tsd_t *)gettsd(p, 0);
+		peak += ts->ts_peak > 0 ? ts->ts_peak : 0;
+		final += ts->ts_final > 0 ? ts->ts_final : 0;
+	}
+	peak /= lm_optP;
+	final /= lm_optP;
+
+	for (k = 0; k < 3; k++) {
+		pct[k] = percentile(hist, pcts[k]);
+	}
+
+	if (perf && ops) {
+		(void) sprintf(miss, "%7.2f", (double)misses / ops);
+	} else {
+		(void) sprintf(miss, "%7s", "-");
+	}
+
+	ts = (tsd_t *)gettsd(0, 0);
+	(void) sprintf(result,
+	    "%5s %5s %3d %8ld %8.3f %6lld %6lld %6lld %8lld %8lld %5.2f %s",
+	    optf != NULL ? "file" : "made", impl->ai_name, lm_optT, ntrace,
+	    ts->ts_span ? (double)ops * 1.0e3 / (double)ts->ts_span : 0.0,
+	    pct[0], pct[1], pct[2], peak, final,
+	    peaklive ? peak * 1024.0 / peaklive : 0.0, miss);
+
+	return (result);
+}
@@ -38,6 +38,8 @@
 #include <string.h>
 
 #include "libmicro.h"
+#include "memimpl.h"
+#include "sizedist.h"
 
 #define	DEFS			8192
 #define	DEFR			1
@@ -46,12 +48,22 @@ static long long		opts = DEFS;
 static int			optf;
 static int			optt;
 static int			opta;
+static char			*opti = "libc";
+static char			*optl = NULL;
+static char			*opto = NULL;
+static char			*optd = NULL;
+static char			*optg = NULL;
+static memimpl_t		*impls[MAXIMPLS];
+static int			nimpls;
+static int			dist;
+static sizedist_t		sd;
 
 typedef struct {
 	char			*ts_src;
 	char 			*ts_dest;
 	int			ts_srcsize;
 	int			ts_destsize;
+	int			ts_next;	/* draw */
 } tsd_t;
 
 int
@@ -59,17 +71,26 @@ benchmark_init()
 {
 	lm_tsdsize = sizeof (tsd_t);
 
-	(void) sprintf(lm_optstr, "a:s:ft");
+	(void) sprintf(lm_optstr, "a:d:g:i:l:o:s:ft");
 
 	(void) sprintf(lm_usage,
 	    "       [-s buffer-size (default %d)]\n"
 	    "       [-a relative alignment (default page aligned)]\n"
 	    "       [-f (rotate \"from\" buffer to keep it out of cache)]\n"
 	    "       [-t (rotate \"to\" buffer to keep it out of cache)]\n"
-	    "notes: measures memcpy()\n",
-	    DEFS);
+	    "       [-i %s|all, or a list (default libc)]\n"
+	    "       [-l size,size,... (sweep these sizes after the run)]\n"
+	    "       [-o align,align,... (sweep these alignments too)]\n"
+	    "       [-d dist (draw sizes from dist instead of -s)]\n"
+	    "       [-g dist (draw alignments from dist instead of -a)]\n"
+	    SD_USAGE
+	    "notes: measures memcpy(), or the first -i; with -l, -o or more\n"
+	    "       than one -i a size by alignment by implementation\n"
+	    "       table follows; with -d or -g the calls cycle through\n"
+	    "       %d draws and size is their mean\n",
+	    DEFS, memimpl_names(), SD_N);
 
-	(void) sprintf(lm_header, "%8s", "size");
+	(void) sprintf(lm_header, "%8s %8s", "size", "impl");
 
 	return (0);
 }
@@ -90,34 +111,103 @@ benchmark_optswitch(int opt, char *optarg)
 	case 'a':
 		opta = sizetoint(optarg);
 		break;
+	case 'd':
+		optd = optarg;
+		break;
+	case 'g':
+		optg = optarg;
+		break;
+	case 'i':
+		opti = optarg;
+		break;
+	case 'l':
+		optl = optarg;
+		break;
+	case 'o':
+		opto = optarg;
+		break;
 	default:
 		return (-1);
 	}
 	return (0);
 }
 
+int
+benchmark_initrun()
+{
+	if ((nimpls = memimpl_list(opti, impls)) < 1) {
+		return (-1);
+	}
+
+	dist = optd != NULL || optg != NULL;
+	if (dist && sizedist_init(&sd, optd, opts, optg, opta) == -1) {
+		return (-1);
+	}
+
+	return (0);
+}
+
 int
 benchmark_initworker(void *tsd)
 {
 	tsd_t			*ts = (tsd_t *)tsd;
+	long long		size = dist ? sd.sd_maxsize : opts;
+	int			align = dist ? sd.sd_maxalign : opta;
 
 	if (optf)
 		ts->ts_srcsize = 64 * 1024 * 1024;
 	else
-		ts->ts_srcsize = opts + opta;
+		ts->ts_srcsize = size + align;
 
 	if (optt)
 		ts->ts_destsize = 64 * 1024 * 1024;
 	else
-		ts->ts_destsize = (int)opts;
+		ts->ts_destsize = (int)size;
 
 
-	ts->ts_src = opta + (char *)valloc(ts->ts_srcsize);
+	ts->ts_src = (dist ? 0 : opta) + (char *)valloc(ts->ts_srcsize);
 	ts->ts_dest = valloc(ts->ts_destsize);
 
 	return (0);
 }
 
+/*
+ * as benchmark() does, but each call takes the next draw's size and
+ * alignment
+ */
+static int
+drawn(tsd_t *ts, result_t *res, memcpy_t fn)
+{
+	char			*src = ts->ts_src;
+	char			*dest = ts->ts_dest;
+	char			*send = ts->ts_src + ts->ts_srcsize;
+	char			*dend = ts->ts_dest + ts->ts_destsize;
+	long long		span = sd.sd_maxsize + sd.sd_maxalign;
+	int			bump = (int)sd.sd_maxsize;
+	int			i, k;
+
+	if (bump < 1024)
+		bump = 1024; /* avoid prefetched area */
+	for (i = 0; i < lm_optB; i++) {
+		k = ts->ts_next++ & (SD_N - 1);
+		(void) fn(dest, src + sd.sd_align[k], sd.sd_size[k]);
+		if (optf) {
+			src += bump;
+			if (src + span > send)
+				src = ts->ts_src;
+		}
+		if (optt) {
+			dest += bump;
+			if (dest + sd.sd_maxsize > dend)
+				dest = ts->ts_dest;
+		}
+	}
+
+	res->re_count = i;
+
+	return (0);
+}
+
 int
 benchmark(void *tsd, result_t *res)
 {
@@ -125,13 +215,18 @@ benchmark(void *tsd, result_t *res)
 	int			i;
 	char			*src = ts->ts_src;
 	char			*dest = ts->ts_dest;
+	memcpy_t		fn = impls[0]->mi_cpy;
 
 	int bump = (int)opts;
 
+	if (dist) {
+		return (drawn(ts, res, fn));
+	}
+
 	if (bump < 1024)
 		bump = 1024; /* avoid prefetched area */
 	for (i = 0; i < lm_optB; i++) {
-		(void) memcpy(dest, src, opts);
+		(void) fn(dest, src, opts);
 		if (optf) {
 			src += bump;
 			if (src + opts > ts->ts_src + ts->ts_srcsize)
@@ -154,7 +249,40 @@ benchmark_result()
 {
 	static char		result[256];
 
-	(void) sprintf(result, "%8lld", opts);
+	if (dist) {
+		(void) sprintf(result, "%8.0f %8s <%s%s%s>", sd.sd_mean,
+		    impls[0]->mi_name, optd ? optd : "fixed",
+		    optg ? ", align " : "", optg ? optg : "");
+	} else {
+		(void) sprintf(result, "%8lld %8s", opts, impls[0]->mi_name);
+	}
 
 	return (result);
 }
+
+int
+benchmark_finirun()
+{
+	long long		sizes[MAXSWEEP];
+	long long		aligns[MAXSWEEP];
+	int			nsizes = 1;
+	int			naligns = 1;
+
+	if (optl == NULL && opto == NULL && nimpls < 2) {
+		return (0);
+	}
+
+	sizes[0] = opts;
+	aligns[0] = opta;
+	if (optl != NULL) {
+		nsizes = memimpl_sizes(optl, sizes);
+	}
+	if (opto != NULL) {
+		naligns = memimpl_sizes(opto, aligns);
+	}
+
+	memimpl_sweep(MI_CPY, impls, nimpls, sizes, nsizes, aligns, naligns,
+	    optf, optt);
+
+	return (0);
+}
@@ -0,0 +1,412 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * memcpy, memmove and memset done other ways than libc's, for
+ * memcpy, memmove and memset to measure side by side: rep movsb and
+ * rep stosb, and loops of SSE2, AVX2 or AVX-512 vectors with
+ * ordinary or non-temporal stores.  The vector ones are compiled for
+ * their own isa and only offered where cpuid says the cpu has it.
+ * Also the size by alignment by implementation sweep they all share
+ */
+
+#include <sys/types.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define	X86
+#include <immintrin.h>
+#endif
+
+#include "libmicro.h"
+#include "memimpl.h"
+
+#define	ROTATE			(64 * 1024 * 1024)
+#define	WORK			(4 * 1024 * 1024)	/* bytes per run */
+
+/*
+ * under the narrowest vector's worth, a byte at a time in whichever
+ * direction is safe
+ */
+static void *
+small_cpy(void *dst, const void *src, size_t n)
+{
+	char			*d = dst;
+	const char		*s = src;
+
+	while (n-- > 0) {
+		*d++ = *s++;
+	}
+
+	return (dst);
+}
+
+static void *
+small_move(void *dst, const void *src, size_t n)
+{
+	char			*d = dst;
+	const char		*s = src;
+
+	if ((unsigned long)d - (unsigned long)s >= n) {
+		return (small_cpy(dst, src, n));
+	}
+	while (n-- > 0) {
+		d[n] = s[n];
+	}
+
+	return (dst);
+}
+
+static void *
+small_set(void *dst, int c, size_t n)
+{
+	char			*d = dst;
+
+	while (n-- > 0) {
+		*d++ = (char)c;
+	}
+
+	return (dst);
+}
+
+#ifdef X86
+
+static void *
+rep_cpy(void *dst, const void *src, size_t n)
+{
+	void			*d = dst;
+
+	__asm__ __volatile__("rep movsb"
+	    : "+D" (d), "+S" (src), "+c" (n) : : "memory");
+
+	return (dst);
+}
+
+/*
+ * an overlapping move to higher addresses goes backwards, from the
+ * last byte down
+ */
+static void *
+rep_move(void *dst, const void *src, size_t n)
+{
+	char			*d = dst;
+	const char		*s = src;
+
+	if ((unsigned long)d - (unsigned long)s >= n) {
+		return (rep_cpy(dst, src, n));
+	}
+
+	d += n - 1;
+	s += n - 1;
+	__asm__ __volatile__("std; rep movsb; cld"
+	    : "+D" (d), "+S" (s), "+c" (n) : : "memory");
+
+	return (dst);
+}
+
+static void *
+rep_set(void *dst, int c, size_t n)
+{
+	void			*d = dst;
+
+	__asm__ __volatile__("rep stosb"
+	    : "+D" (d), "+c" (n) : "a" (c) : "memory");
+
+	return (dst);
+}
+
+/*
+ * the vector routines differ only in the width of the vector and
+ * the names of the intrinsics, _mm_*_si128, _mm256_*_si256 or
+ * _mm512_*_si512, and what they hand anything shorter than a vector
+ * to.  Forwards, the first and last vectors are loaded before
+ * anything is stored and written unaligned at the end; the ones
+ * between are stored aligned, or streamed.  Backwards only the first
+ * need be kept back
+ */
+#define	LDU(pfx, si, p)		_mm##pfx##_loadu_##si((void *)(p))
+#define	STU(pfx, si, p, v)	_mm##pfx##_storeu_##si((void *)(p), v)
+#define	ST(pfx, si, nt, p, v)	(nt ? _mm##pfx##_stream_##si((void *)(p), v) : \
+				    _mm##pfx##_store_##si((void *)(p), v))
+
+#define	VECTOR(nm, tgt, vec, pfx, si, w, nt, lesser)			\
+__attribute__((target(tgt))) static void *				\
+nm##_cpy(void *dst, const void *src, size_t n)				\
+{									\
+	char			*d = dst;				\
+	const char		*s = src;				\
+	vec			head, tail;				\
+	size_t			i;					\
+									\
+	if (n < w) {							\
+		return (lesser##_cpy(dst, src, n));			\
+	}								\
+									\
+	head = LDU(pfx, si, s);						\
+	tail = LDU(pfx, si, s + n - w);					\
+	for (i = w - ((unsigned long)d & (w - 1)); i + w < n; i += w) {	\
+		ST(pfx, si, nt, d + i, LDU(pfx, si, s + i));		\
+	}								\
+	STU(pfx, si, d, head);						\
+	STU(pfx, si, d + n - w, tail);					\
+	if (nt) {							\
+		_mm_sfence();						\
+	}								\
+									\
+	return (dst);							\
+}									\
+									\
+__attribute__((target(tgt))) static void *				\
+nm##_move(void *dst, const void *src, size_t n)				\
+{									\
+	char			*d = dst;				\
+	const char		*s = src;				\
+	vec			head;					\
+	size_t			i;					\
+									\
+	if ((unsigned long)d - (unsigned long)s >= n) {			\
+		return (nm##_cpy(dst, src, n));				\
+	}								\
+	if (n < w) {							\
+		return (lesser##_move(dst, src, n));			\
+	}								\
+									\
+	head = LDU(pfx, si, s);						\
+	for (i = n; i > w; i -= w) {					\
+		STU(pfx, si, d + i - w, LDU(pfx, si, s + i - w));	\
+	}								\
+	STU(pfx, si, d, head);						\
+									\
+	return (dst);							\
+}									\
+									\
+__attribute__((target(tgt))) static void *				\
+nm##_set(void *dst, int c, size_t n)					\
+{									\
+	char			*d = dst;				\
+	vec			v = _mm##pfx##_set1_epi8((char)c);	\
+	size_t			i;					\
+									\
+	if (n < w) {							\
+		return (lesser##_set(dst, c, n));			\
+	}								\
+									\
+	STU(pfx, si, d, v);						\
+	for (i = w - ((unsigned long)d & (w - 1)); i + w < n; i += w) {	\
+		ST(pfx, si, nt, d + i, v);				\
+	}								\
+	STU(pfx, si, d + n - w, v);					\
+	if (nt) {							\
+		_mm_sfence();						\
+	}								\
+									\
+	return (dst);							\
+}
+
+VECTOR(sse2, "sse2", __m128i, , si128, 16, 0, small)
+VECTOR(avx2, "avx2", __m256i, 256, si256, 32, 0, sse2)
+VECTOR(avx512, "avx512f", __m512i, 512, si512, 64, 0, avx2)
+VECTOR(sse2nt, "sse2", __m128i, , si128, 16, 1, small)
+VECTOR(avx2nt, "avx2", __m256i, 256, si256, 32, 1, sse2)
+VECTOR(avx512nt, "avx512f", __m512i, 512, si512, 64, 1, avx2)
+
+#endif
+
+memimpl_t			memimpls[] = {
+	{ "libc",	memcpy,		memmove,	memset },
+#ifdef X86
+	{ "rep",	rep_cpy,	rep_move,	rep_set },
+	{ "sse2",	sse2_cpy,	sse2_move,	sse2_set },
+	{ "avx2",	avx2_cpy,	avx2_move,	avx2_set },
+	{ "avx512",	avx512_cpy,	avx512_move,	avx512_set },
+	{ "sse2nt",	sse2nt_cpy,	sse2nt_move,	sse2nt_set },
+	{ "avx2nt",	avx2nt_cpy,	avx2nt_move,	avx2nt_set },
+	{ "avx512nt",	avx512nt_cpy,	avx512nt_move,	avx512nt_set },
+#endif
+	{ NULL,		NULL,		NULL,		NULL }
+};
+
+/*
+ * the implementations in a comma separated list, or all of them
+ * the cpu can run; -1 for one it doesn't know or can't run
+ */
+int
+memimpl_list(char *list, memimpl_t **impls)
+{
+	int			which[MAXIMPLS];
+	int			n, i;
+
+	n = impl_list(list, memimpls, sizeof (memimpl_t), which, MAXIMPLS);
+	for (i = 0; i < n; i++) {
+		impls[i] = &memimpls[which[i]];
+	}
+
+	return (n);
+}
+
+/*
+ * libc|rep|sse2..., for usage messages
+ */
+char *
+memimpl_names()
+{
+	static char		names[256];
+
+	return (impl_names(memimpls, sizeof (memimpl_t), names,
+	    sizeof (names)));
+}
+
+/*
+ * a comma separated list of sizes, 64,1k,1m
+ */
+int
+memimpl_sizes(char *list, long long *sizes)
+{
+	char			*copy, *tok, *last;
+	int			n = 0;
+
+	if ((copy = strdup(list)) == NULL) {
+		return (0);
+	}
+
+	for (tok = strtok_r(copy, ",", &last); tok != NULL && n < MAXSWEEP;
+	    tok = strtok_r(NULL, ",", &last)) {
+		sizes[n++] = sizetoll(tok);
+	}
+
+	free(copy);
+
+	return (n);
+}
+
+/*
+ * nsecs per call of one implementation at one size and alignment,
+ * the best of three runs after one to warm up; the source moves by
+ * the alignment, as -a does, and either buffer can be rotated
+ * through ROTATE bytes to keep it out of the caches as -f and -t do
+ */
+static double
+measure(int op, memimpl_t *mi, char *src, char *dst, long long size,
+    long long align, int rotsrc, int rotdst)
+{
+	long long		t0, best = 0;
+	long long		bump = size < 1024 ? 1024 : size;
+	long			calls = WORK / (size + 64) + 8;
+	long			i;
+	int			run;
+	char			*s, *d;
+
+	for (run = 0; run < 4; run++) {
+		s = src + align;
+		d = op == MI_SET ? dst + align : dst;
+		t0 = getnsecs();
+		for (i = 0; i < calls; i++) {
+			switch (op) {
+			case MI_CPY:
+				(void) mi->mi_cpy(d, s, size);
+				break;
+			case MI_MOVE:
+				(void) mi->mi_move(d, s, size);
+				break;
+			case MI_SET:
+				(void) mi->mi_set(d, 0, size);
+				break;
+			}
+			if (rotsrc) {
+				s += bump;
+				if (s + size > src + ROTATE) {
+					s = src + align;
+				}
+			}
+			if (rotdst) {
+				d += bump;
+				if (d + size + align > dst + ROTATE) {
+					d = op == MI_SET ? dst + align : dst;
+				}
+			}
+		}
+		t0 = getnsecs() - t0;
+		if (run == 1 || (run > 1 && t0 < best)) {
+			best = t0;
+		}
+	}
+
+	return ((double)best / calls);
+}
+
+/*
+ * a table of nsecs per call, a row for each size and alignment and
+ * a column for each implementation
+ */
+void
+memimpl_sweep(int op, memimpl_t **impls, int nimpls, long long *sizes,
+    int nsizes, long long *aligns, int naligns, int rotsrc, int rotdst)
+{
+	static char		*ops[] = { "memcpy", "memmove", "memset" };
+	long long		max = 0, len;
+	char			*src, *dst;
+	int			i, j, k;
+
+	for (i = 0; i < nsizes; i++) {
+		for (j = 0; j < naligns; j++) {
+			if (sizes[i] + aligns[j] > max) {
+				max = sizes[i] + aligns[j];
+			}
+		}
+	}
+
+	len = max + ROTATE;
+	if ((src = valloc(len)) == NULL || (dst = valloc(len)) == NULL) {
+		(void) printf("# sweep: out of memory\n");
+		return;
+	}
+	(void) memset(src, 'a', len);
+	(void) memset(dst, 'b', len);
+
+	(void) printf("#\n# %s sweep, nsecs per call%s%s\n#\n# %8s %5s",
+	    ops[op], rotsrc ? ", source rotated" : "",
+	    rotdst ? ", destination rotated" : "", "size", "align");
+	for (k = 0; k < nimpls; k++) {
+		(void) printf(" %8s", impls[k]->mi_name);
+	}
+	(void) printf("\n");
+
+	for (i = 0; i < nsizes; i++) {
+		for (j = 0; j < naligns; j++) {
+			(void) printf("# %8lld %5lld", sizes[i], aligns[j]);
+			for (k = 0; k < nimpls; k++) {
+				(void) printf(" %8.2f", measure(op, impls[k],
+				    src, dst, sizes[i], aligns[j], rotsrc,
+				    rotdst));
+			}
+			(void) printf("\n");
+		}
+	}
+
+	free(src);
+	free(dst);
+}
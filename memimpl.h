@@ -0,0 +1,62 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef MEMIMPL_H
+#define	MEMIMPL_H
+
+#include <sys/types.h>
+
+/*
+ * implementations of memcpy, memmove and memset to set against
+ * libc's, shared by those benchmarks
+ */
+
+typedef void *(*memcpy_t)(void *, const void *, size_t);
+typedef void *(*memset_t)(void *, int, size_t);
+
+typedef struct {
+	char			*mi_name;
+	memcpy_t		mi_cpy;
+	memcpy_t		mi_move;
+	memset_t		mi_set;
+} memimpl_t;
+
+#define	MI_CPY			0
+#define	MI_MOVE			1
+#define	MI_SET			2
+
+#define	MAXIMPLS		16
+#define	MAXSWEEP		64
+
+extern memimpl_t		memimpls[];
+
+int	memimpl_list(char *list, memimpl_t **impls);
+char	*memimpl_names(void);
+int	memimpl_sizes(char *list, long long *sizes);
+void	memimpl_sweep(int op, memimpl_t **impls, int nimpls,
+	    long long *sizes, int nsizes, long long *aligns, int naligns,
+	    int rotsrc, int rotdst);
+
+#endif /* MEMIMPL_H */
@@ -38,6 +38,7 @@
 #include <string.h>
 
 #include "libmicro.h"
+#include "memimpl.h"
 
 #define	DEFS			8192
 #define	DEFR			1
@@ -46,6 +47,11 @@ static long long		opts = DEFS;
 static int			optf;
 static int			optt;
 static int			opta;
+static char			*opti = "libc";
+static char			*optl = NULL;
+static char			*opto = NULL;
+static memimpl_t		*impls[MAXIMPLS];
+static int			nimpls;
 
 typedef struct {
 	char			*ts_src;
@@ -59,17 +65,22 @@ benchmark_init()
 {
 	lm_tsdsize = sizeof (tsd_t);
 
-	(void) sprintf(lm_optstr, "a:s:ft");
+	(void) sprintf(lm_optstr, "a:i:l:o:s:ft");
 
 	(void) sprintf(lm_usage,
 	    "       [-s buffer-size (default %d)]\n"
 	    "       [-a relative alignment (default page aligned)]\n"
 	    "       [-f (rotate \"from\" buffer to keep it out of cache)]\n"
 	    "       [-t (rotate \"to\" buffer to keep it out of cache)]\n"
-	    "notes: measures memmove()\n",
-	    DEFS);
+	    "       [-i %s|all, or a list (default libc)]\n"
+	    "       [-l size,size,... (sweep these sizes after the run)]\n"
+	    "       [-o align,align,... (sweep these alignments too)]\n"
+	    "notes: measures memmove(), or the first -i; with -l, -o or more\n"
+	    "       than one -i a size by alignment by implementation\n"
+	    "       table follows\n",
+	    DEFS, memimpl_names());
 
-	(void) sprintf(lm_header, "%8s", "size");
+	(void) sprintf(lm_header, "%8s %8s", "size", "impl");
 
 	return (0);
 }
@@ -90,12 +101,31 @@ benchmark_optswitch(int opt, char *optarg)
 	case 'a':
 		opta = sizetoint(optarg);
 		break;
+	case 'i':
+		opti = optarg;
+		break;
+	case 'l':
+		optl = optarg;
+		break;
+	case 'o':
+		opto = optarg;
+		break;
 	default:
 		return (-1);
 	}
 	return (0);
 }
 
+int
+benchmark_initrun()
+{
+	if ((nimpls = memimpl_list(opti, impls)) < 1) {
+		return (-1);
+	}
+
+	return (0);
+}
+
 int
 benchmark_initworker(void *tsd)
 {
@@ -125,13 +155,14 @@ benchmark(void *tsd, result_t *res)
 	int			i;
 	char			*src = ts->ts_src;
 	char			*dest = ts->ts_dest;
+	memcpy_t		fn = impls[0]->mi_move;
 
 	int bump = (int)opts;
 
 	if (bump < 1024)
 		bump = 1024; /* avoid prefetched area */
 	for (i = 0; i < lm_optB; i++) {
-		(void) memmove(dest, src, opts);
+		(void) fn(dest, src, opts);
 		if (optf) {
 			src += bump;
 			if (src + opts > ts->ts_src + ts->ts_srcsize)
@@ -154,7 +185,34 @@ benchmark_result()
 {
 	static char		result[256];
 
-	(void) sprintf(result, "%8lld", opts);
+	(void) sprintf(result, "%8lld %8s", opts, impls[0]->mi_name);
 
 	return (result);
 }
+
+int
+benchmark_finirun()
+{
+	long long		sizes[MAXSWEEP];
+	long long		aligns[MAXSWEEP];
+	int			nsizes = 1;
+	int			naligns = 1;
+
+	if (optl == NULL && opto == NULL && nimpls < 2) {
+		return (0);
+	}
+
+	sizes[0] = opts;
+	aligns[0] = opta;
+	if (optl != NULL) {
+		nsizes = memimpl_sizes(optl, sizes);
+	}
+	if (opto != NULL) {
+		naligns = memimpl_sizes(opto, aligns);
+	}
+
+	memimpl_sweep(MI_MOVE, impls, nimpls, sizes, nsizes, aligns, naligns,
+	    optf, optt);
+
+	return (0);
+}
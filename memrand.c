@@ -29,21 +29,62 @@
  */
 
 /*
- * memory access time check
+ * memory access time check: a chase down a chain of pointers, each
+ * load waiting on the one before.  Besides the original backwards
+ * stride the chain can be a random single cycle through cache lines
+ * or pages, which no prefetcher follows, or several chains walked in
+ * lockstep to show how many misses the memory system overlaps.  -m
+ * sweeps the working set from 4k up and picks out the latency
+ * plateaus of the caches (-x line) or of the TLBs (-x page)
  */
 
+#include <sys/types.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <fcntl.h>
 #include <string.h>
+#include <limits.h>
 
 #include "libmicro.h"
 
-static long	opts = 1024*1024;
+#define	LINE			64
+#define	STRIDE			128		/* longs */
+#define	MAXCHAINS		8
+#define	MINSWEEP		4096
+#define	HUGEALIGN		(2 * 1024 * 1024)
+#define	MAXLEVELS		16
+#define	CLIMB			1.10		/* per quarter octave */
+#define	RISE			1.25		/* over a whole climb */
+#define	HOPS			(1024 * 1024)	/* per sweep point */
+
+static char			*kinds[] = {
+	"stride", "line", "page", NULL
+};
+#define	K_STRIDE		0
+#define	K_LINE			1
+#define	K_PAGE			2
+
+static char			*pages[] = {
+	"base", "thp", "huge"
+};
+#define	PG_BASE			0
+#define	PG_THP			1
+#define	PG_HUGE			2
+
+static long long		opts = 1024*1024;
+static long long		optm = 0;
+static int			optc = 1;
+static int			opth = 0;
+static int			optx = K_STRIDE;
+static long			pagesize;
+static int			pagekind = PG_BASE;
 
 typedef struct {
-	long			**ts_data;
+	char			*ts_map;
+	size_t			ts_maplen;
+	void			*ts_heads[MAXCHAINS];
 	long			ts_result;
 } tsd_t;
 
@@ -52,15 +93,22 @@ benchmark_init()
 {
 	lm_tsdsize = sizeof (tsd_t);
 
-	(void) sprintf(lm_optstr, "s:");
+	(void) sprintf(lm_optstr, "c:hm:s:x:");
 
 	(void) sprintf(lm_usage,
+	    "       [-c chains walked together (default 1, at most %d)]\n"
+	    "       [-h] (back the buffer with huge pages)\n"
+	    "       [-m size] (also sweep 4k up to size, after the run)\n"
 	    "       [-s size] number of bytes to "
-	    " access (default %ld)\n"
-	    "notes: measures \"random\" memory access times\n",
-	    opts);
+	    " access (default %lld)\n"
+	    "       [-x stride|line|page (default stride)]\n"
+	    "notes: measures \"random\" memory access times; stride is a\n"
+	    "       backwards stride of %d longs, line and page a random\n"
+	    "       cycle through every line or one line in every page\n",
+	    MAXCHAINS, opts, STRIDE);
 
-	(void) sprintf(lm_header, "%8s", "size");
+	(void) sprintf(lm_header, "%8s %6s %6s %4s",
+	    "size", "chain", "pages", "mlp");
 
 	return (0);
 }
@@ -68,9 +116,31 @@ benchmark_init()
 int
 benchmark_optswitch(int opt, char *optarg)
 {
+	int			i;
+
 	switch (opt) {
+	case 'c':
+		optc = atoi(optarg);
+		break;
+	case 'h':
+		opth = 1;
+		break;
+	case 'm':
+		optm = sizetoll(optarg);
+		break;
 	case 's':
-		opts = sizetoint(optarg);
+		opts = sizetoll(optarg);
+		break;
+	case 'x':
+		for (i = 0; kinds[i] != NULL; i++) {
+			if (strcmp(optarg, kinds[i]) == 0) {
+				break;
+			}
+		}
+		if (kinds[i] == NULL) {
+			return (-1);
+		}
+		optx = i;
 		break;
 	default:
 		return (-1);
@@ -80,27 +150,233 @@ benchmark_optswitch(int opt, char *optarg)
 }
 
 int
-benchmark_initworker(void *tsd)
+benchmark_initrun()
 {
-	tsd_t			*ts = (tsd_t *)tsd;
-	int i, j;
+	pagesize = sysconf(_SC_PAGESIZE);
 
-	ts->ts_data = malloc(opts);
+	if (optc < 1 || optc > MAXCHAINS) {
+		(void) printf("ERROR: -c must be between 1 and %d\n",
+		    MAXCHAINS);
+		return (-1);
+	}
+	if (optx == K_STRIDE && optc > 1) {
+		(void) printf("ERROR: -c needs -x line or -x page\n");
+		return (-1);
+	}
+	if (opts < (optx == K_PAGE ? pagesize : STRIDE * sizeof (long))) {
+		(void) printf("ERROR: -s is too small for -x %s\n",
+		    kinds[optx]);
+		return (-1);
+	}
 
-	if (ts->ts_data == NULL) {
-		return (1);
+	return (0);
+}
+
+/*
+ * an anonymous mapping, aligned for huge pages; with -h we ask for
+ * hugetlb pages and fall back to transparent ones
+ */
+static char *
+region(size_t size, char **mapp, size_t *maplenp)
+{
+	char			*map;
+	size_t			len = size;
+	int			flags = MAP_PRIVATE | MAP_ANON;
+
+	pagekind = PG_BASE;
+
+#ifdef MAP_HUGETLB
+	if (opth) {
+		len = (size + HUGEALIGN - 1) & ~(size_t)(HUGEALIGN - 1);
+		/*LINTED*/
+		map = (char *)mmap(NULL, len, PROT_READ | PROT_WRITE,
+		    flags | MAP_HUGETLB, -1, 0L);
+		if (map != MAP_FAILED) {
+			pagekind = PG_HUGE;
+			*mapp = map;
+			*maplenp = len;
+			return (map);
+		}
+	}
+#endif
+
+	len = opth ? size + HUGEALIGN : size;
+	/*LINTED*/
+	map = (char *)mmap(NULL, len, PROT_READ | PROT_WRITE, flags, -1, 0L);
+	if (map == MAP_FAILED) {
+		return (NULL);
+	}
+	*mapp = map;
+	*maplenp = len;
+
+	if (!opth) {
+		return (map);
+	}
+
+	/*LINTED*/
+	map = (char *)(((unsigned long)map + HUGEALIGN - 1) &
+	    ~(unsigned long)(HUGEALIGN - 1));
+#ifdef MADV_HUGEPAGE
+	if (madvise(map, size, MADV_HUGEPAGE) == 0) {
+		pagekind = PG_THP;
+	}
+#endif
+
+	return (map);
+}
+
+/*
+ * link size bytes of buf into chains and return their heads; the
+ * random kinds shuffle the elements and cut the order into optc
+ * cycles, one cycle when optc is 1
+ */
+static int
+chain(char *buf, size_t size, void **heads)
+{
+	unsigned long long	seed = 0x9e3779b97f4a7c15ULL;
+	unsigned int		*order, t;
+	size_t			gran, n, i, j, first, last;
+	int			k;
+
+	for (k = 0; k < MAXCHAINS; k++) {
+		heads[k] = NULL;
+	}
+
+	if (optx == K_STRIDE) {
+		long		**data = (long **)buf;
+
+		n = size / sizeof (long);
+		for (i = 0; i < n; i++) {
+			j = i < STRIDE ? i + n - STRIDE : i - STRIDE;
+			data[i] = (long *)&data[j];
+		}
+		heads[0] = buf;
+		return (0);
+	}
+
+	gran = optx == K_PAGE ? pagesize : LINE;
+	n = size / gran;
+	if (n > UINT_MAX ||
+	    (order = malloc(n * sizeof (unsigned int))) == NULL) {
+		return (-1);
+	}
+
+	for (i = 0; i < n; i++) {
+		order[i] = i;
+	}
+	for (i = n - 1; i > 0; i--) {
+		j = rnd(&seed) % (i + 1);
+		t = order[i];
+		order[i] = order[j];
+		order[j] = t;
 	}
 
 	/*
-	 * use lmbench style backwards stride
+	 * page chains use a random line of each page, so they don't
+	 * all fall in the same cache sets
 	 */
+	if (optx == K_PAGE) {
+		for (i = 0; i < n; i++) {
+			order[i] = order[i] * (gran / LINE) +
+			    rnd(&seed) % (gran / LINE);
+		}
+	}
+
+	k = n < optc ? n : optc;
+	for (j = 0; j < k; j++) {
+		first = j * n / k;
+		last = (j + 1) * n / k - 1;
+		for (i = first; i < last; i++) {
+			*(void **)(buf + (size_t)order[i] * LINE) =
+			    buf + (size_t)order[i + 1] * LINE;
+		}
+		*(void **)(buf + (size_t)order[last] * LINE) =
+		    buf + (size_t)order[first] * LINE;
+		heads[j] = buf + (size_t)order[first] * LINE;
+	}
+
+	free(order);
+
+	return (0);
+}
+
+#define	HOP(p)		(p) = *(void **)(p)
+
+/*
+ * n hops down each of k chains; the hops of different chains don't
+ * depend on one another, so they may overlap
+ */
+static void
+chase(void **heads, int k, long n)
+{
+	void			*p0 = heads[0], *p1 = heads[1];
+	void			*p2 = heads[2], *p3 = heads[3];
+	void			*p4 = heads[4], *p5 = heads[5];
+	void			*p6 = heads[6], *p7 = heads[7];
+	long			i;
+
+	for (i = 0; i < n; i++) {
+		switch (k) {
+		case 8:
+			HOP(p7);
+			/* FALLTHROUGH */
+		case 7:
+			HOP(p6);
+			/* FALLTHROUGH */
+		case 6:
+			HOP(p5);
+			/* FALLTHROUGH */
+		case 5:
+			HOP(p4);
+			/* FALLTHROUGH */
+		case 4:
+			HOP(p3);
+			/* FALLTHROUGH */
+		case 3:
+			HOP(p2);
+			/* FALLTHROUGH */
+		case 2:
+			HOP(p1);
+			/* FALLTHROUGH */
+		default:
+			HOP(p0);
+		}
+	}
+
+	heads[0] = p0;
+	heads[1] = p1;
+	heads[2] = p2;
+	heads[3] = p3;
+	heads[4] = p4;
+	heads[5] = p5;
+	heads[6] = p6;
+	heads[7] = p7;
+}
 
-	for (i = 0; i < opts / sizeof (long); i++) {
-		j = i - 128;
-		if (j < 0)
-			j = j + opts / sizeof (long);
-		ts->ts_data[i] = (long *)&(ts->ts_data[j]);
+static int
+chains(size_t size)
+{
+	size_t			n;
+
+	if (optx == K_STRIDE) {
+		return (1);
 	}
+	n = size / (optx == K_PAGE ? pagesize : LINE);
+
+	return (n < optc ? (int)n : optc);
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	char			*buf;
+
+	if ((buf = region(opts, &ts->ts_map, &ts->ts_maplen)) == NULL ||
+	    chain(buf, opts, ts->ts_heads) == -1) {
+		return (1);
+	}
+
 	return (0);
 }
 
@@ -108,28 +384,23 @@ int
 benchmark(void *tsd, result_t *res)
 {
 	tsd_t			*ts = (tsd_t *)tsd;
-	int			i;
+	int			k = chains(opts);
 
-	long **ptr = ts->ts_data;
+	chase(ts->ts_heads, k, lm_optB);
 
+	ts->ts_result = (long)ts->ts_heads[0];
 
+	res->re_count = lm_optB * k;
 
-	for (i = 0; i < lm_optB; i += 10) {
-		ptr = (long **)*ptr;
-		ptr = (long **)*ptr;
-		ptr = (long **)*ptr;
-		ptr = (long **)*ptr;
-		ptr = (long **)*ptr;
-		ptr = (long **)*ptr;
-		ptr = (long **)*ptr;
-		ptr = (long **)*ptr;
-		ptr = (long **)*ptr;
-		ptr = (long **)*ptr;
-	}
+	return (0);
+}
 
-	ts->ts_result = (long)*ptr;
+int
+benchmark_finiworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
 
-	res->re_count = lm_optB;
+	(void) munmap(ts->ts_map, ts->ts_maplen);
 
 	return (0);
 }
@@ -137,10 +408,168 @@ benchmark(void *tsd, result_t *res)
 char *
 benchmark_result()
 {
-	static char  result[256];
-
-	(void) sprintf(result, "%8ld ", opts);
+	static char		result[256];
 
+	(void) sprintf(result, "%8lld %6s %6s %4d",
+	    opts, kinds[optx], pages[pagekind], chains(opts));
 
 	return (result);
 }
+
+/*
+ * nsecs per load at one working set size, the best of three runs
+ * after a pass to warm the caches and TLBs
+ */
+static double
+measure(char *buf, size_t size)
+{
+	void			*heads[MAXCHAINS];
+	long long		t0, best = 0;
+	long			warm;
+	int			k = chains(size);
+	int			i;
+
+	if (chain(buf, size, heads) == -1) {
+		return (0.0);
+	}
+
+	warm = size / (optx == K_PAGE ? pagesize : LINE) / k;
+	chase(heads, k, warm < HOPS ? HOPS : warm);
+
+	for (i = 0; i < 3; i++) {
+		t0 = getnsecs();
+		chase(heads, k, HOPS);
+		t0 = getnsecs() - t0;
+		if (i == 0 || t0 < best) {
+			best = t0;
+		}
+	}
+
+	return ((double)best / HOPS / k);
+}
+
+static char *
+human(long long size, char *buf)
+{
+	if (size >= 1024LL * 1024 * 1024 && size % (1024 * 1024) == 0) {
+		(void) sprintf(buf, "%.3gg", size / (1024.0 * 1024 * 1024));
+	} else if (size >= 1024 * 1024 && size % 1024 == 0) {
+		(void) sprintf(buf, "%.3gm", size / (1024.0 * 1024));
+	} else if (size >= 1024) {
+		(void) sprintf(buf, "%.3gk", size / 1024.0);
+	} else {
+		(void) sprintf(buf, "%lld", size);
+	}
+
+	return (buf);
+}
+
+/*
+ * the sweep goes up in quarter octaves.  A climb is a run of steps
+ * each CLIMB or more above the last, and one that rises RISE in all
+ * ends a plateau; slower drifts, such as TLB misses creeping into a
+ * cache level, don't.  What ends a line plateau is the capacity of
+ * a cache; what ends a page plateau is the reach of a TLB or, further
+ * out, of the caches holding the page tables
+ */
+static void
+sweep()
+{
+	long long		size[256];
+	double			ns[256];
+	int			lvl[MAXLEVELS];	/* first point of each */
+	int			end[MAXLEVELS];	/* and last */
+	char			*buf, *map;
+	size_t			maplen;
+	size_t			gran;
+	char			a[32], b[32];
+	long long		s;
+	int			npts = 0, nlvl = 0;
+	int			i, j, step;
+
+	gran = optx == K_PAGE ? pagesize : (optx == K_LINE ? LINE :
+	    STRIDE * sizeof (long));
+
+	if ((buf = region(optm, &map, &maplen)) == NULL) {
+		(void) printf("# sweep: out of memory\n");
+		return;
+	}
+
+	for (step = 0; npts < 256; step++) {
+		s = (long long)(MINSWEEP * (1LL << (step / 4)) *
+		    (1.0 + (step % 4) / 4.0));
+		s -= s % gran;
+		if (s > optm) {
+			break;
+		}
+		if (npts > 0 && s == size[npts - 1]) {
+			continue;
+		}
+		size[npts] = s;
+		ns[npts] = measure(buf, s);
+		npts++;
+	}
+
+	(void) munmap(map, maplen);
+
+	(void) printf("#\n# %s sweep, %s pages, %d chain%s, "
+	    "nsecs per load\n#\n# %8s %8s\n",
+	    kinds[optx], pages[pagekind], optc, optc > 1 ? "s" : "",
+	    "size", "nsecs");
+	for (i = 0; i < npts; i++) {
+		(void) printf("# %8s %8.2f\n", human(size[i], a), ns[i]);
+	}
+
+	if (npts == 0) {
+		return;
+	}
+
+	lvl[nlvl++] = 0;
+	for (i = 1; i < npts && nlvl < MAXLEVELS; i++) {
+		if (ns[i] < ns[i - 1] * CLIMB) {
+			continue;
+		}
+		for (j = i; i + 1 < npts && ns[i + 1] >= ns[i] * CLIMB; ) {
+			i++;
+		}
+		if (ns[i] >= ns[j - 1] * RISE) {
+			end[nlvl - 1] = j - 1;
+			lvl[nlvl++] = i;
+		}
+	}
+	end[nlvl - 1] = npts - 1;
+
+	(void) printf("#\n# %-6s %8s %8s %10s\n",
+	    "level", "nsecs", "reach", optx == K_PAGE ? "entries" : "");
+	for (i = 0; i < nlvl; i++) {
+		if (optx == K_PAGE) {
+			(void) sprintf(a, i == nlvl - 1 ? "walk" :
+			    "pg%d", i + 1);
+		} else {
+			(void) sprintf(a, i == nlvl - 1 && nlvl > 1 ?
+			    "mem" : "L%d", i + 1);
+		}
+		/* the latency halfway along, the reach at the end */
+		j = (lvl[i] + end[i]) / 2;
+		s = size[end[i]];
+		if (i == nlvl - 1) {
+			(void) printf("# %-6s %8.2f %8s\n", a, ns[j], "-");
+		} else if (optx == K_PAGE) {
+			(void) printf("# %-6s %8.2f %8s %10lld\n", a, ns[j],
+			    human(s, b), s / pagesize);
+		} else {
+			(void) printf("# %-6s %8.2f %8s\n", a, ns[j],
+			    human(s, b));
+		}
+	}
+}
+
+int
+benchmark_finirun()
+{
+	if (optm) {
+		sweep();
+	}
+
+	return (0);
+}
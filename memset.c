@@ -38,12 +38,18 @@
 #include <string.h>
 
 #include "libmicro.h"
+#include "memimpl.h"
 
 #define	DEFS			8192
 
 static long long		opts = DEFS;
 static int			opta = 0;
 static int			optu = 0;
+static char			*opti = "libc";
+static char			*optl = NULL;
+static char			*opto = NULL;
+static memimpl_t		*impls[MAXIMPLS];
+static int			nimpls;
 
 static char 			*optas = "4k";
 
@@ -58,16 +64,21 @@ benchmark_init()
 {
 	lm_tsdsize = sizeof (tsd_t);
 
-	(void) sprintf(lm_optstr, "a:us:");
+	(void) sprintf(lm_optstr, "a:i:l:o:us:");
 
 	(void) sprintf(lm_usage,
 	    "       [-s buffer-size (default %d)]\n"
 	    "       [-a alignment (force buffer alignment)]\n"
-	    "       [-u (try to always use uncached memory)]"
-	    "notes: measures memset()\n",
-	    DEFS);
+	    "       [-u (try to always use uncached memory)]\n"
+	    "       [-i %s|all, or a list (default libc)]\n"
+	    "       [-l size,size,... (sweep these sizes after the run)]\n"
+	    "       [-o align,align,... (sweep these alignments too)]\n"
+	    "notes: measures memset(), or the first -i; with -l, -o or more\n"
+	    "       than one -i a size by alignment by implementation\n"
+	    "       table follows\n",
+	    DEFS, memimpl_names());
 
-	(void) sprintf(lm_header, "%8s%16s", "size", "alignment");
+	(void) sprintf(lm_header, "%8s%16s %8s", "size", "alignment", "impl");
 
 	return (0);
 }
@@ -89,12 +100,31 @@ benchmark_optswitch(int opt, char *optarg)
 		else
 			optas = optarg;
 		break;
+	case 'i':
+		opti = optarg;
+		break;
+	case 'l':
+		optl = optarg;
+		break;
+	case 'o':
+		opto = optarg;
+		break;
 	default:
 		return (-1);
 	}
 	return (0);
 }
 
+int
+benchmark_initrun()
+{
+	if ((nimpls = memimpl_list(opti, impls)) < 1) {
+		return (-1);
+	}
+
+	return (0);
+}
+
 int
 benchmark_initworker(void *tsd)
 {
@@ -124,14 +154,14 @@ benchmark(void *tsd, result_t *res)
 {
 	int			i;
 	tsd_t			*ts = (tsd_t *)tsd;
-
+	memset_t		fn = impls[0]->mi_set;
 
 	if (optu) {
 		char *buf = ts->ts_buff + ts->ts_offset;
 		char *end = ts->ts_buff + ts->ts_size;
 		int offset = ts->ts_offset;
 		for (i = 0; i < lm_optB; i ++) {
-			(void) memset(buf, 0, opts);
+			(void) fn(buf, 0, opts);
 			buf = (char *)(((unsigned long)buf + opts + 4095) &
 			    ~4095) + offset;
 			if (buf + opts > end)
@@ -141,16 +171,16 @@ benchmark(void *tsd, result_t *res)
 		char *buf = ts->ts_buff + ts->ts_offset;
 
 		for (i = 0; i < lm_optB; i += 10) {
-			(void) memset(buf, 0, opts);
-			(void) memset(buf, 0, opts);
-			(void) memset(buf, 0, opts);
-			(void) memset(buf, 0, opts);
-			(void) memset(buf, 0, opts);
-			(void) memset(buf, 0, opts);
-			(void) memset(buf, 0, opts);
-			(void) memset(buf, 0, opts);
-			(void) memset(buf, 0, opts);
-			(void) memset(buf, 0, opts);
+			(void) fn(buf, 0, opts);
+			(void) fn(buf, 0, opts);
+			(void) fn(buf, 0, opts);
+			(void) fn(buf, 0, opts);
+			(void) fn(buf, 0, opts);
+			(void) fn(buf, 0, opts);
+			(void) fn(buf, 0, opts);
+			(void) fn(buf, 0, opts);
+			(void) fn(buf, 0, opts);
+			(void) fn(buf, 0, opts);
 		}
 	}
 	res->re_count = i;
@@ -163,7 +193,34 @@ benchmark_result()
 {
 	static char		result[256];
 
-	(void) sprintf(result, "%8lld%12s", opts, optas);
+	(void) sprintf(result, "%8lld%12s %8s", opts, optas, impls[0]->mi_name);
 
 	return (result);
 }
+
+int
+benchmark_finirun()
+{
+	long long		sizes[MAXSWEEP];
+	long long		aligns[MAXSWEEP];
+	int			nsizes = 1;
+	int			naligns = 1;
+
+	if (optl == NULL && opto == NULL && nimpls < 2) {
+		return (0);
+	}
+
+	sizes[0] = opts;
+	aligns[0] = opta;
+	if (optl != NULL) {
+		nsizes = memimpl_sizes(optl, sizes);
+	}
+	if (opto != NULL) {
+		naligns = memimpl_sizes(opto, aligns);
+	}
+
+	memimpl_sweep(MI_SET, impls, nimpls, sizes, nsizes, aligns, naligns,
+	    0, optu);
+
+	return (0);
+}
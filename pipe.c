@@ -31,11 +31,13 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <poll.h>
 #include <pthread.h>
 #include <signal.h>
 #include <string.h>
@@ -44,9 +46,34 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <mqueue.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 
 #include "libmicro.h"
 
+/*
+ * single producer, single consumer ring in shared memory; each side
+ * sleeps on the other's index with a futex only when it has to
+ */
+
+#define	RINGSLOTS		64
+
+typedef struct {
+	volatile unsigned int	rg_head;	/* next slot to fill */
+	volatile unsigned int	rg_hwait;	/* consumer asleep on head */
+	char			rg_pad1[56];
+	volatile unsigned int	rg_tail;	/* next slot to drain */
+	volatile unsigned int	rg_twait;	/* producer asleep on tail */
+	char			rg_pad2[56];
+	size_t			rg_slotsize;
+	char			rg_slots[1];	/* RINGSLOTS slots follow */
+} ring_t;
+
 typedef struct {
 	int			ts_once;
 	pid_t			ts_child;
@@ -57,6 +84,12 @@ typedef struct {
 	int			ts_out2;
 	int			ts_lsn;
 	struct sockaddr_in	ts_add;
+	long long		*ts_stamps;	/* send times, -w only */
+	long long		ts_msgs;	/* messages sent */
+	long long		ts_nsecs;	/* time spent sending them */
+	long long		ts_lat;		/* sum of round trip times */
+	long long		ts_latcnt;	/* number of round trips */
+	ring_t			*ts_rings[2];	/* -x shm only */
 } tsd_t;
 
 #define	FIRSTPORT		12345
@@ -67,11 +100,18 @@ static char			*modes[] = {"st", "mt", "mp", NULL};
 #define	MD_MULTIPROCESS		2
 
 static char			*xports[] = {"pipe", "fifo", "sock", "tcp",
+				    "efd", "dgrm", "seqp", "udp", "mq", "shm",
 				    NULL};
 #define	XP_PIPES		0
 #define	XP_FIFOS		1
 #define	XP_SOCKETPAIR		2
 #define	XP_LOCALTCP		3
+#define	XP_EVENTFD		4
+#define	XP_DGRAM		5
+#define	XP_SEQPACKET		6
+#define	XP_LOCALUDP		7
+#define	XP_MQUEUE		8
+#define	XP_SHMRING		9
 
 #define	DEFM			MD_SINGLE
 #define	DEFS			1024
@@ -80,17 +120,35 @@ static char			*xports[] = {"pipe", "fifo", "sock", "tcp",
 static int			optm = DEFM;
 static size_t			opts = DEFS;
 static int			optx = DEFX;
+static int			optw = 0;
+static int			opto = 0;
+static size_t			acks = 1;
 static void			*rbuf = NULL;
 static void			*wbuf = NULL;
 
 int readall(int s, void *buf, size_t len);
+int xwrite(tsd_t *ts, int fd, void *buf, size_t len);
+int xread(tsd_t *ts, int fd, void *buf, size_t len);
+void xclose(int fd);
+void closepeer(tsd_t *ts);
 void *loopback(void *arg);
+void *sink(void *arg);
+int setndelay(tsd_t *ts, int on);
+int windowed(tsd_t *ts, result_t *res);
+int streamed(tsd_t *ts, result_t *res);
 int prepare_pipes(tsd_t *tsd);
 int prepare_fifos(tsd_t *tsd);
 int cleanup_fifos(tsd_t *tsd);
 int prepare_socketpair(tsd_t *tsd);
 int prepare_localtcp(tsd_t *tsd);
 int prepare_localtcp_once(tsd_t *tsd);
+int prepare_eventfds(tsd_t *tsd);
+int prepare_dgrams(tsd_t *tsd, int type);
+int prepare_localudp(tsd_t *tsd);
+int prepare_mqueues(tsd_t *tsd);
+int prepare_shmrings(tsd_t *tsd);
+int ring_put(ring_t *r, void *buf, size_t len);
+int ring_get(ring_t *r, void *buf, size_t len);
 char *lookupa(int x, char *names[]);
 int lookup(char *x, char *names[]);
 
@@ -99,13 +157,23 @@ benchmark_init()
 {
 	lm_tsdsize = sizeof (tsd_t);
 
-	(void) sprintf(lm_optstr, "m:s:x:");
+	(void) sprintf(lm_optstr, "m:os:w:x:");
 
 	(void) sprintf(lm_usage,
 	    "       [-m mode (st|mt|mp, default %s)]\n"
+	    "       [-o] (one-way streaming to a sink peer)\n"
 	    "       [-s buffer-size (default %d)]\n"
-	    "       [-x transport (pipe|fifo|sock|tcp, default %s)]\n"
-	    "notes: measures write()/read() across various transports\n",
+	    "       [-w window of outstanding messages (default 1)]\n"
+	    "       [-x transport (pipe|fifo|sock|tcp|efd|dgrm|seqp|udp|"
+	    "mq|shm,\n"
+	    "           default %s)]\n"
+	    "notes: measures write()/read() across various transports\n"
+	    "       efd is an eventfd semaphore and always moves 8 bytes\n"
+	    "       dgrm and seqp are AF_UNIX SOCK_DGRAM/SOCK_SEQPACKET\n"
+	    "       mq is a POSIX message queue, shm a futex-signalled\n"
+	    "       shared memory ring\n"
+	    "       -w and -o need a peer (-m mt or mp) and report\n"
+	    "       msgs/sec, MB/sec and mean round trip in usecs\n",
 	    lookupa(DEFM, modes), DEFS, lookupa(DEFX, xports));
 
 	(void) sprintf(lm_header, "%2s %4s", "md", "xprt");
@@ -125,9 +193,15 @@ benchmark_optswitch(int opt, char *optarg)
 			return (-1);
 		optm = x;
 		break;
+	case 'o':
+		opto = 1;
+		break;
 	case 's':
 		opts = sizetoll(optarg);
 		break;
+	case 'w':
+		optw = sizetoint(optarg);
+		break;
 	case 'x':
 		x = lookup(optarg, xports);
 		if (x == -1)
@@ -150,11 +224,45 @@ benchmark_initrun()
 		}
 	}
 
+	if (optw < 0 || (optw > 1 && opto)) {
+		(void) printf("ERROR: -w must be positive and excludes -o\n");
+		return (-1);
+	}
+
+	if ((optw > 1 || opto) && optm == MD_SINGLE) {
+		(void) printf("ERROR: -w and -o need -m mt or -m mp\n");
+		return (-1);
+	}
+
+	if (optw > 1 && (optx == XP_MQUEUE || optx == XP_SHMRING)) {
+		(void) printf("ERROR: -w needs a pollable transport\n");
+		return (-1);
+	}
+
+	if (optw > 1 || opto) {
+		(void) strcat(lm_header, " wnd      msgs/s     MB/s   rtt");
+	}
+
+	/* an eventfd carries nothing but its 64-bit counter */
+	if (optx == XP_EVENTFD) {
+		opts = acks = sizeof (unsigned long long);
+	}
+
 	(void) setfdlimit(4 * lm_optT + 10);
 
 	rbuf = malloc(opts);
 	wbuf = malloc(opts);
 
+	if (rbuf == NULL || wbuf == NULL) {
+		(void) printf("ERROR: malloc() failed\n");
+		return (-1);
+	}
+
+	(void) memset(wbuf, 0, opts);
+	if (optx == XP_EVENTFD) {
+		*(unsigned long long *)wbuf = 1;
+	}
+
 	return (0);
 }
 
@@ -164,7 +272,7 @@ benchmark_initbatch(void *tsd)
 	tsd_t			*ts = (tsd_t *)tsd;
 	int			result;
 	pid_t			pid;
-	int			i;
+	void			*(*peer)(void *) = opto ? sink : loopback;
 
 	switch (optx) {
 	case XP_SOCKETPAIR:
@@ -176,6 +284,24 @@ benchmark_initbatch(void *tsd)
 	case XP_FIFOS:
 		result = prepare_fifos(ts);
 		break;
+	case XP_EVENTFD:
+		result = prepare_eventfds(ts);
+		break;
+	case XP_DGRAM:
+		result = prepare_dgrams(ts, SOCK_DGRAM);
+		break;
+	case XP_SEQPACKET:
+		result = prepare_dgrams(ts, SOCK_SEQPACKET);
+		break;
+	case XP_LOCALUDP:
+		result = prepare_localudp(ts);
+		break;
+	case XP_MQUEUE:
+		result = prepare_mqueues(ts);
+		break;
+	case XP_SHMRING:
+		result = prepare_shmrings(ts);
+		break;
 	case XP_PIPES:
 	default:
 		result = prepare_pipes(ts);
@@ -187,7 +313,7 @@ benchmark_initbatch(void *tsd)
 
 	switch (optm) {
 	case MD_MULTITHREAD:
-		result = pthread_create(&ts->ts_thread, NULL, loopback, tsd);
+		result = pthread_create(&ts->ts_thread, NULL, peer, tsd);
 		if (result == -1) {
 			return (1);
 		}
@@ -196,7 +322,7 @@ benchmark_initbatch(void *tsd)
 		pid = fork();
 		switch (pid) {
 		case 0:
-			(void) loopback(tsd);
+			(void) peer(tsd);
 			exit(0);
 			break;
 		case -1:
@@ -211,14 +337,27 @@ benchmark_initbatch(void *tsd)
 		break;
 	}
 
-	/* Prime the loopback */
-	if (write(ts->ts_out, wbuf, opts) != opts) {
+	/* Prime the loopback; a sink acknowledges with a single byte */
+	if (xwrite(ts, ts->ts_out, wbuf, opts) != opts) {
 		return (1);
 	}
-	if (readall(ts->ts_in, rbuf, opts) != opts) {
+	if (xread(ts, ts->ts_in, rbuf, opto ? acks : opts) == -1) {
 		return (1);
 	}
 
+	if (optw > 1) {
+		if (ts->ts_stamps == NULL) {
+			ts->ts_stamps = (long long *)malloc((optw + 1) *
+			    sizeof (long long));
+			if (ts->ts_stamps == NULL) {
+				return (1);
+			}
+		}
+		if (setndelay(ts, 1) == -1) {
+			return (1);
+		}
+	}
+
 	return (0);
 }
 
@@ -229,13 +368,21 @@ benchmark(void *tsd, result_t *res)
 	int			i;
 	int			n;
 
+	if (optw > 1) {
+		return (windowed(ts, res));
+	}
+
+	if (opto) {
+		return (streamed(ts, res));
+	}
+
 	for (i = 0; i < lm_optB; i++) {
-		if (write(ts->ts_out, wbuf, opts) != opts) {
+		if (xwrite(ts, ts->ts_out, wbuf, opts) != opts) {
 			res->re_errors++;
 			continue;
 		}
 
-		n = readall(ts->ts_in, rbuf, opts);
+		n = xread(ts, ts->ts_in, rbuf, opts);
 		if (n == -1) {
 			res->re_errors++;
 			continue;
@@ -251,19 +398,21 @@ benchmark_finibatch(void *tsd)
 {
 	tsd_t			*ts = (tsd_t *)tsd;
 
+	if (optw > 1) {
+		(void) setndelay(ts, 0);
+	}
+
 	/* Terminate the loopback */
-	(void) write(ts->ts_out, wbuf, opts);
-	(void) readall(ts->ts_in, rbuf, opts);
+	(void) xwrite(ts, ts->ts_out, wbuf, opts);
+	(void) xread(ts, ts->ts_in, rbuf, opto ? acks : opts);
 
 	switch (optm) {
 	case MD_MULTITHREAD:
-		(void) close(ts->ts_in2);
-		(void) close(ts->ts_out2);
+		closepeer(ts);
 		(void) pthread_join(ts->ts_thread, NULL);
 		break;
 	case MD_MULTIPROCESS:
-		(void) close(ts->ts_in2);
-		(void) close(ts->ts_out2);
+		closepeer(ts);
 		(void) waitpid(ts->ts_child, NULL, 0);
 		break;
 	case MD_SINGLE:
@@ -271,8 +420,10 @@ benchmark_finibatch(void *tsd)
 		break;
 	}
 
-	(void) close(ts->ts_in);
-	(void) close(ts->ts_out);
+	/* sockets use one descriptor for both directions */
+	xclose(ts->ts_in);
+	if (ts->ts_out != ts->ts_in)
+		xclose(ts->ts_out);
 
 	if (optx == XP_FIFOS) {
 		(void) cleanup_fifos(ts);
@@ -285,21 +436,181 @@ char *
 benchmark_result()
 {
 	static char		result[256];
+	tsd_t			*ts;
+	double			rate = 0.0;
+	long long		lat = 0;
+	long long		latcnt = 0;
+	int			p, t;
 
 	(void) sprintf(result, "%2s %4s",
 	    lookupa(optm, modes), lookupa(optx, xports));
 
+	if (optw <= 1 && !opto) {
+		return (result);
+	}
+
+	/* every thread streams independently, so their rates add up */
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			if (ts->ts_nsecs > 0) {
+				rate += (double)ts->ts_msgs * 1.0e9 /
+				    (double)ts->ts_nsecs;
+			}
+			lat += ts->ts_lat;
+			latcnt += ts->ts_latcnt;
+		}
+	}
+
+	(void) sprintf(result + strlen(result), " %3d %11.0f %8.2f",
+	    opto ? 0 : optw, rate, rate * opts / (1024.0 * 1024.0));
+
+	if (latcnt > 0) {
+		(void) sprintf(result + strlen(result), " %5.1f",
+		    (double)lat / (double)latcnt / 1000.0);
+	} else {
+		(void) strcat(result, "     -");
+	}
+
 	return (result);
 }
 
+/*
+ * keep up to optw messages in flight, treating the transport as a
+ * byte stream so that partial reads and writes simply carry over.
+ * Both ends are non-blocking; we only sleep in poll() when neither
+ * direction can make progress.
+ */
+int
+windowed(tsd_t *ts, result_t *res)
+{
+	long long		total = (long long)lm_optB * opts;
+	long long		wdone = 0;
+	long long		rdone = 0;
+	long long		limit = (long long)optw * opts;
+	long long		now;
+	struct pollfd		pfd[2];
+	int			progress;
+	int			w, r;
+	ssize_t			n;
+
+	while (rdone < total) {
+		progress = 0;
+		now = getnsecs();
+
+		if (wdone < total && wdone - rdone < limit) {
+			w = wdone % opts;
+			if (w == 0) {
+				ts->ts_stamps[(wdone / opts) % (optw + 1)] =
+				    now;
+			}
+			n = write(ts->ts_out, (char *)wbuf + w, opts - w);
+			if (n > 0) {
+				wdone += n;
+				progress++;
+			} else if (n == -1 && errno != EAGAIN) {
+				res->re_errors++;
+				break;
+			}
+		}
+
+		n = read(ts->ts_in, rbuf, opts);
+		if (n > 0) {
+			now = getnsecs();
+			/* account for every message this read completed */
+			for (r = rdone / opts; r < (rdone + n) / opts; r++) {
+				ts->ts_lat += now -
+				    ts->ts_stamps[r % (optw + 1)];
+				ts->ts_latcnt++;
+			}
+			rdone += n;
+			progress++;
+		} else if (n == 0 || errno != EAGAIN) {
+			res->re_errors++;
+			break;
+		}
+
+		if (progress == 0) {
+			pfd[0].fd = ts->ts_in;
+			pfd[0].events = POLLIN;
+			pfd[1].fd = ts->ts_out;
+			pfd[1].events = POLLOUT;
+			(void) poll(pfd,
+			    (wdone < total && wdone - rdone < limit) ? 2 : 1,
+			    -1);
+		}
+	}
+
+	res->re_count = rdone / opts;
+
+	ts->ts_msgs += res->re_count;
+	ts->ts_nsecs += getnsecs() - res->re_t0;
+
+	return (0);
+}
+
+/*
+ * one-way: write the whole batch and wait for the sink to
+ * acknowledge having read all of it
+ */
+int
+streamed(tsd_t *ts, result_t *res)
+{
+	int			i;
+
+	for (i = 0; i < lm_optB; i++) {
+		if (xwrite(ts, ts->ts_out, wbuf, opts) != opts) {
+			res->re_errors++;
+		}
+	}
+
+	if (xread(ts, ts->ts_in, rbuf, acks) == -1) {
+		res->re_errors++;
+	}
+
+	res->re_count = i;
+
+	ts->ts_msgs += i;
+	ts->ts_nsecs += getnsecs() - res->re_t0;
+
+	return (0);
+}
+
+int
+setndelay(tsd_t *ts, int on)
+{
+	int			flag = on ? O_NDELAY : 0;
+
+	if (fcntl(ts->ts_out, F_SETFL, flag) == -1) {
+		return (-1);
+	}
+	if (ts->ts_in != ts->ts_out &&
+	    fcntl(ts->ts_in, F_SETFL, flag) == -1) {
+		return (-1);
+	}
+
+	return (0);
+}
+
 int
 readall(int s, void *buf, size_t len)
 {
-	size_t			n;
+	ssize_t			n;
 	size_t			total = 0;
+	struct pollfd		pfd;
 
 	for (;;) {
 		n = read(s, (void *)((long)buf + total), len - total);
+		if (n == -1 && errno == EAGAIN) {
+			/*
+			 * an eventfd is one object shared by both sides,
+			 * so -w leaves the loopback's end non-blocking too
+			 */
+			pfd.fd = s;
+			pfd.events = POLLIN;
+			(void) poll(&pfd, 1, -1);
+			continue;
+		}
 		if (n < 1) {
 			return (-1);
 		}
@@ -310,6 +621,66 @@ readall(int s, void *buf, size_t len)
 	}
 }
 
+/*
+ * message I/O for the transports that don't speak read()/write();
+ * for -x shm the "descriptors" are indices into ts_rings[]
+ */
+int
+xwrite(tsd_t *ts, int fd, void *buf, size_t len)
+{
+	switch (optx) {
+	case XP_MQUEUE:
+		return (mq_send((mqd_t)fd, buf, len, 0) == 0 ? (int)len : -1);
+	case XP_SHMRING:
+		return (ring_put(ts->ts_rings[fd], buf, len));
+	default:
+		return (write(fd, buf, len));
+	}
+}
+
+int
+xread(tsd_t *ts, int fd, void *buf, size_t len)
+{
+	switch (optx) {
+	case XP_MQUEUE:
+		/* the buffer must be able to hold the largest message */
+		return (mq_receive((mqd_t)fd, buf, opts, NULL));
+	case XP_SHMRING:
+		return (ring_get(ts->ts_rings[fd], buf, len));
+	default:
+		return (readall(fd, buf, len));
+	}
+}
+
+/*
+ * close the loopback's descriptors; eventfds and message queues are
+ * the same object at both ends, so leave those to our own close
+ */
+void
+closepeer(tsd_t *ts)
+{
+	if (ts->ts_in2 != ts->ts_in && ts->ts_in2 != ts->ts_out)
+		xclose(ts->ts_in2);
+	if (ts->ts_out2 != ts->ts_in2 &&
+	    ts->ts_out2 != ts->ts_in && ts->ts_out2 != ts->ts_out)
+		xclose(ts->ts_out2);
+}
+
+void
+xclose(int fd)
+{
+	switch (optx) {
+	case XP_MQUEUE:
+		(void) mq_close((mqd_t)fd);
+		break;
+	case XP_SHMRING:
+		break;
+	default:
+		(void) close(fd);
+		break;
+	}
+}
+
 void *
 loopback(void *arg)
 {
@@ -320,11 +691,37 @@ loopback(void *arg)
 	m = lm_optB + 2;
 
 	for (i = 0; i < m; i++) {
-		n = readall(ts->ts_in2, rbuf, opts);
+		n = xread(ts, ts->ts_in2, rbuf, opts);
 		if (n == -1) {
 			break;
 		}
-		if (write(ts->ts_out2, wbuf, opts) != opts) {
+		if (xwrite(ts, ts->ts_out2, wbuf, opts) != opts) {
+			break;
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * peer for -o: swallow whatever is sent, acknowledging the priming
+ * message, the end of every batch and the termination message
+ */
+void *
+sink(void *arg)
+{
+	tsd_t			*ts = (tsd_t *)arg;
+	int			i, m;
+
+	/* Include priming and termination */
+	m = lm_optB + 2;
+
+	for (i = 0; i < m; i++) {
+		if (xread(ts, ts->ts_in2, rbuf, opts) == -1) {
+			break;
+		}
+		if ((i == 0 || i >= lm_optB) &&
+		    xwrite(ts, ts->ts_out2, wbuf, acks) != acks) {
 			break;
 		}
 	}
@@ -341,21 +738,26 @@ prepare_localtcp_once(tsd_t *ts)
 
 	j = FIRSTPORT;
 
-	ts->ts_lsn = socket(AF_INET, SOCK_STREAM, 0);
-	if (ts->ts_lsn == -1) {
-		return (-1);
-	}
-
-	if (setsockopt(ts->ts_lsn, SOL_SOCKET, SO_REUSEADDR,
-	    &opt, sizeof (int)) == -1) {
-		return (-1);
-	}
-
 	if ((host = gethostbyname("localhost")) == NULL) {
 		return (-1);
 	}
 
+	/*
+	 * with SO_REUSEADDR two threads can bind the same port, and
+	 * only the first to listen() wins; the loser moves on
+	 */
+
 	for (;;) {
+		ts->ts_lsn = socket(AF_INET, SOCK_STREAM, 0);
+		if (ts->ts_lsn == -1) {
+			return (-1);
+		}
+
+		if (setsockopt(ts->ts_lsn, SOL_SOCKET, SO_REUSEADDR,
+		    &opt, sizeof (int)) == -1) {
+			return (-1);
+		}
+
 		(void) memset(&ts->ts_add, 0,
 		    sizeof (struct sockaddr_in));
 		ts->ts_add.sin_family = AF_INET;
@@ -365,17 +767,16 @@ prepare_localtcp_once(tsd_t *ts)
 
 		if (bind(ts->ts_lsn,
 		    (struct sockaddr *)&ts->ts_add,
-		    sizeof (struct sockaddr_in)) == 0) {
+		    sizeof (struct sockaddr_in)) == 0 &&
+		    listen(ts->ts_lsn, 5) == 0) {
 			break;
 		}
 
 		if (errno != EADDRINUSE) {
 			return (-1);
 		}
-	}
 
-	if (listen(ts->ts_lsn, 5) == -1) {
-		return (-1);
+		(void) close(ts->ts_lsn);
 	}
 
 	return (0);
@@ -470,25 +871,33 @@ prepare_fifos(tsd_t *ts)
 
 	(void) sprintf(path, "/tmp/pipe_%ld.%dA",
 	    getpid(), pthread_self());
-	if (mknod(path, 0600, S_IFIFO) == -1) {
+	if (mknod(path, S_IFIFO | 0600, 0) == -1) {
 		return (-1);
 	}
 
+	/*
+	 * open the read sides non-blocking so that we don't wait for
+	 * a writer; they are made blocking again once both ends exist
+	 */
+
 	if (optm == MD_SINGLE) {
-		ts->ts_in = open(path, O_RDONLY);
+		ts->ts_in = open(path, O_RDONLY | O_NDELAY);
 		ts->ts_out = open(path, O_WRONLY);
+		(void) fcntl(ts->ts_in, F_SETFL, 0);
 	} else {
-		ts->ts_in = open(path, O_RDONLY);
+		ts->ts_in = open(path, O_RDONLY | O_NDELAY);
 		ts->ts_out2 = open(path, O_WRONLY);
 
 		(void) sprintf(path, "/tmp/pipe_%ld.%dB",
 		    getpid(), pthread_self());
-		if (mknod(path, 0600, S_IFIFO) == -1) {
+		if (mknod(path, S_IFIFO | 0600, 0) == -1) {
 			return (-1);
 		}
 
-		ts->ts_in2 = open(path, O_RDONLY);
+		ts->ts_in2 = open(path, O_RDONLY | O_NDELAY);
 		ts->ts_out = open(path, O_WRONLY);
+		(void) fcntl(ts->ts_in, F_SETFL, 0);
+		(void) fcntl(ts->ts_in2, F_SETFL, 0);
 	}
 
 	return (0);
@@ -537,6 +946,280 @@ prepare_pipes(tsd_t *ts)
 	return (0);
 }
 
+int
+prepare_eventfds(tsd_t *ts)
+{
+#ifdef __linux__
+	/* semaphore mode so that every write is one message */
+	ts->ts_in = eventfd(0, EFD_SEMAPHORE);
+	if (ts->ts_in == -1) {
+		return (-1);
+	}
+
+	if (optm == MD_SINGLE) {
+		ts->ts_out = ts->ts_in;
+	} else {
+		ts->ts_out2 = ts->ts_in;
+		ts->ts_out = eventfd(0, EFD_SEMAPHORE);
+		if (ts->ts_out == -1) {
+			return (-1);
+		}
+		ts->ts_in2 = ts->ts_out;
+	}
+
+	return (0);
+#else
+	return (-1);
+#endif
+}
+
+int
+prepare_dgrams(tsd_t *ts, int type)
+{
+	int			s[2];
+
+	if (socketpair(PF_UNIX, type, 0, s) == -1) {
+		return (-1);
+	}
+
+	if (optm == MD_SINGLE) {
+		ts->ts_in = s[0];
+		ts->ts_out = s[1];
+	} else {
+		ts->ts_in = s[0];
+		ts->ts_out = s[0];
+		ts->ts_in2 = s[1];
+		ts->ts_out2 = s[1];
+	}
+
+	return (0);
+}
+
+int
+prepare_localudp(tsd_t *ts)
+{
+	struct sockaddr_in	add[2];
+	socklen_t		size;
+	int			s[2];
+	int			i, n;
+
+	/* a single socket talking to itself will do for st */
+	n = (optm == MD_SINGLE) ? 1 : 2;
+
+	for (i = 0; i < n; i++) {
+		s[i] = socket(AF_INET, SOCK_DGRAM, 0);
+		if (s[i] == -1) {
+			return (-1);
+		}
+
+		(void) memset(&add[i], 0, sizeof (struct sockaddr_in));
+		add[i].sin_family = AF_INET;
+		add[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		add[i].sin_port = 0;
+
+		size = sizeof (struct sockaddr_in);
+		if (bind(s[i], (struct sockaddr *)&add[i], size) == -1 ||
+		    getsockname(s[i], (struct sockaddr *)&add[i],
+		    &size) == -1) {
+			return (-1);
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		if (connect(s[i], (struct sockaddr *)&add[n - 1 - i],
+		    sizeof (struct sockaddr_in)) == -1) {
+			return (-1);
+		}
+	}
+
+	if (optm == MD_SINGLE) {
+		ts->ts_in = s[0];
+		ts->ts_out = s[0];
+	} else {
+		ts->ts_in = s[0];
+		ts->ts_out = s[0];
+		ts->ts_in2 = s[1];
+		ts->ts_out2 = s[1];
+	}
+
+	return (0);
+}
+
+int
+prepare_mqueues(tsd_t *ts)
+{
+	struct mq_attr		attr;
+	char			path[64];
+	mqd_t			q[2];
+	int			i, n;
+
+	(void) memset(&attr, 0, sizeof (attr));
+	attr.mq_maxmsg = 10;
+	attr.mq_msgsize = opts;
+
+	/*
+	 * the queues are unlinked as soon as they are open; the
+	 * descriptors are all the loopback (or its child) needs
+	 */
+
+	n = (optm == MD_SINGLE) ? 1 : 2;
+
+	for (i = 0; i < n; i++) {
+		(void) sprintf(path, "/pipe_%ld.%d%c",
+		    (long)getpid(), (int)pthread_self(), 'A' + i);
+		q[i] = mq_open(path, O_RDWR | O_CREAT | O_EXCL, 0600, &attr);
+		if (q[i] == (mqd_t)-1) {
+			return (-1);
+		}
+		(void) mq_unlink(path);
+	}
+
+	if (optm == MD_SINGLE) {
+		ts->ts_in = (int)q[0];
+		ts->ts_out = (int)q[0];
+	} else {
+		ts->ts_in = (int)q[0];
+		ts->ts_out2 = (int)q[0];
+		ts->ts_in2 = (int)q[1];
+		ts->ts_out = (int)q[1];
+	}
+
+	return (0);
+}
+
+int
+prepare_shmrings(tsd_t *ts)
+{
+#ifdef __linux__
+	size_t			slotsize;
+	size_t			ringsize;
+	char			*p;
+	int			i;
+
+	/* each slot is a length followed by the message */
+	slotsize = ((sizeof (size_t) + opts + 63) / 64) * 64;
+	ringsize = ((sizeof (ring_t) + RINGSLOTS * slotsize + 63) / 64) * 64;
+
+	if (ts->ts_rings[0] == NULL) {
+		/* shared so that the -m mp child sees the same rings */
+		p = (char *)mmap(NULL, 2 * ringsize, PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_ANON, -1, 0L);
+		if (p == (char *)MAP_FAILED) {
+			return (-1);
+		}
+		ts->ts_rings[0] = (ring_t *)p;
+		ts->ts_rings[1] = (ring_t *)(p + ringsize);
+	}
+
+	for (i = 0; i < 2; i++) {
+		ts->ts_rings[i]->rg_head = 0;
+		ts->ts_rings[i]->rg_tail = 0;
+		ts->ts_rings[i]->rg_hwait = 0;
+		ts->ts_rings[i]->rg_twait = 0;
+		ts->ts_rings[i]->rg_slotsize = slotsize;
+	}
+
+	if (optm == MD_SINGLE) {
+		ts->ts_in = 0;
+		ts->ts_out = 0;
+	} else {
+		ts->ts_out = 0;
+		ts->ts_in2 = 0;
+		ts->ts_out2 = 1;
+		ts->ts_in = 1;
+	}
+
+	return (0);
+#else
+	return (-1);
+#endif
+}
+
+#ifdef __linux__
+/*
+ * sleep until *addr moves away from val; the flag tells the other
+ * side that a wakeup is needed, and FUTEX_WAIT rechecks the value
+ * so that a wakeup between the test and the sleep isn't lost
+ */
+static void
+ring_wait(volatile unsigned int *addr, volatile unsigned int *flag,
+    unsigned int val)
+{
+	*flag = 1;
+	__sync_synchronize();
+	if (*addr == val) {
+		(void) syscall(SYS_futex, addr, FUTEX_WAIT, val,
+		    NULL, NULL, 0);
+	}
+	*flag = 0;
+}
+
+static void
+ring_wake(volatile unsigned int *addr, volatile unsigned int *flag)
+{
+	__sync_synchronize();
+	if (*flag) {
+		(void) syscall(SYS_futex, addr, FUTEX_WAKE, 1,
+		    NULL, NULL, 0);
+	}
+}
+#endif
+
+int
+ring_put(ring_t *r, void *buf, size_t len)
+{
+#ifdef __linux__
+	unsigned int		head = r->rg_head;
+	char			*slot;
+
+	while (head - r->rg_tail == RINGSLOTS) {
+		ring_wait(&r->rg_tail, &r->rg_twait, head - RINGSLOTS);
+	}
+
+	slot = r->rg_slots + (head % RINGSLOTS) * r->rg_slotsize;
+	*(size_t *)slot = len;
+	(void) memcpy(slot + sizeof (size_t), buf, len);
+
+	__sync_synchronize();
+	r->rg_head = head + 1;
+	ring_wake(&r->rg_head, &r->rg_hwait);
+
+	return (len);
+#else
+	return (-1);
+#endif
+}
+
+int
+ring_get(ring_t *r, void *buf, size_t len)
+{
+#ifdef __linux__
+	unsigned int		tail = r->rg_tail;
+	char			*slot;
+	size_t			n;
+
+	while (r->rg_head == tail) {
+		ring_wait(&r->rg_head, &r->rg_hwait, tail);
+	}
+
+	__sync_synchronize();
+	slot = r->rg_slots + (tail % RINGSLOTS) * r->rg_slotsize;
+	n = *(size_t *)slot;
+	if (n > len) {
+		n = len;
+	}
+	(void) memcpy(buf, slot + sizeof (size_t), n);
+
+	__sync_synchronize();
+	r->rg_tail = tail + 1;
+	ring_wake(&r->rg_tail, &r->rg_twait);
+
+	return (n);
+#else
+	return (-1);
+#endif
+}
+
 char *
 lookupa(int x, char *names[])
 {
@@ -0,0 +1,615 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * hand off between threads: the -P/-T workers produce timestamps
+ * into a shared queue, -c consumer threads in the parent take them
+ * off and note how long each spent in transit; the queue is picked
+ * from the table below by name; Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libmicro.h"
+
+#define	MAXC			256
+#define	DEFC			1
+#define	DEFS			1024
+
+/* a word alone on its cache line */
+typedef struct {
+	unsigned long long	l_val;
+	char			l_pad[64 - sizeof (unsigned long long)];
+} line_t;
+
+/* an mpmc slot: the sequence says whose turn it is */
+typedef struct {
+	unsigned long long	c_seq;
+	long long		c_val;
+} cell_t;
+
+/* a treiber stack node; links are node index + 1, 0 is the end */
+typedef struct {
+	unsigned		n_next;
+	long long		n_val;
+} node_t;
+
+/*
+ * everything any of the queues needs, mapped shared before the
+ * workers fork; the arrays follow it in the same mapping
+ */
+typedef struct {
+	line_t			q_tail;		/* producers' index */
+	line_t			q_head;		/* consumers' index */
+	line_t			q_top;		/* treiber: tag << 32 | link */
+	line_t			q_free;		/* and its free list */
+	pthread_mutex_t		q_mutex;
+	pthread_cond_t		q_notempty;
+	pthread_cond_t		q_notfull;
+	unsigned long long	q_count;
+	int			q_efd;
+	long long		*q_ring;	/* mutex and spsc */
+	cell_t			*q_cells;	/* mpmc and eventfd */
+	node_t			*q_nodes;	/* treiber */
+} queue_t;
+
+typedef struct {
+	long long		ts_items;
+	span_t			ts_batch;	/* this batch */
+	long long		ts_span;	/* first worker: all batches */
+} tsd_t;
+
+typedef struct {
+	char			*qo_name;
+	int			(*qo_put)(long long);
+	int			(*qo_get)(long long *);
+} queueops_t;
+
+int mutex_put(long long v);
+int mutex_get(long long *v);
+int spsc_put(long long v);
+int spsc_get(long long *v);
+int mpmc_put(long long v);
+int mpmc_get(long long *v);
+int treiber_put(long long v);
+int treiber_get(long long *v);
+int eventfd_put(long long v);
+int eventfd_get(long long *v);
+
+static queueops_t		queueops[] = {
+	{ "mutex",	mutex_put,	mutex_get },
+	{ "spsc",	spsc_put,	spsc_get },
+	{ "mpmc",	mpmc_put,	mpmc_get },
+	{ "treiber",	treiber_put,	treiber_get },
+	{ "eventfd",	eventfd_put,	eventfd_get },
+	{ NULL,		NULL,		NULL }
+};
+
+static queueops_t		*optq = &queueops[0];
+static int			opta = 0;
+static int			optc = DEFC;
+static int			opts = DEFS;
+static unsigned long long	mask;
+static queue_t			*q;
+static long long		(*hists)[NBUCKETS];
+
+void *consumer(void *arg);
+void pin(int n);
+
+int
+benchmark_init()
+{
+	lm_tsdsize = sizeof (tsd_t);
+
+	(void) sprintf(lm_optstr, "ac:q:s:");
+
+	(void) sprintf(lm_usage,
+	    "       [-a] (pin producers, then consumers, to cpus in turn)\n"
+	    "       [-c consumer threads (default %d, max %d)]\n"
+	    "       [-q mutex|spsc|mpmc|treiber|eventfd (default mutex)]\n"
+	    "       [-s queue capacity, a power of two (default %d)]\n"
+	    "notes: the -P/-T workers are the producers; spsc takes one\n"
+	    "       of each; Mitem/s is for all producers together, the\n"
+	    "       percentiles are of enqueue to dequeue time in usecs\n",
+	    DEFC, MAXC, DEFS);
+
+	(void) sprintf(lm_header, "%7s %4s %4s %6s %8s %8s %8s %8s",
+	    "queue", "prod", "cons", "size", "Mitem/s", "p50", "p99",
+	    "p999");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	queueops_t		*qo;
+
+	switch (opt) {
+	case 'a':
+		opta = 1;
+		break;
+	case 'c':
+		optc = atoi(optarg);
+		break;
+	case 'q':
+		for (qo = queueops; qo->qo_name != NULL; qo++) {
+			if (strcmp(optarg, qo->qo_name) == 0) {
+				break;
+			}
+		}
+		if (qo->qo_name == NULL) {
+			return (-1);
+		}
+		optq = qo;
+		break;
+	case 's':
+		opts = sizetoint(optarg);
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * the queue and its consumers are set up in the parent, and the
+ * workers fork with the queue mapped
+ */
+int
+benchmark_initrun()
+{
+	pthread_mutexattr_t	ma;
+	pthread_condattr_t	ca;
+	pthread_t		tid;
+	size_t			len;
+	char			*p;
+	int			i;
+
+	if (optc <= 0 || optc > MAXC) {
+		(void) printf("ERROR: -c must be between 1 and %d\n", MAXC);
+		return (-1);
+	}
+	if (opts < 2 || (opts & (opts - 1)) != 0) {
+		(void) printf("ERROR: -s must be a power of two\n");
+		return (-1);
+	}
+	if (optq->qo_put == spsc_put && (optc > 1 || lm_optP * lm_optT > 1)) {
+		(void) printf("ERROR: spsc takes one producer, one consumer\n");
+		return (-1);
+	}
+
+	mask = opts - 1;
+
+	len = sizeof (queue_t) + opts * (sizeof (long long) +
+	    sizeof (cell_t) + sizeof (node_t));
+	/*LINTED*/
+	p = (char *)mmap(NULL, len, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_ANON, -1, 0L);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		return (-1);
+	}
+
+	/*LINTED*/
+	q = (queue_t *)p;
+	p += sizeof (queue_t);
+	/*LINTED*/
+	q->q_ring = (long long *)p;
+	p += opts * sizeof (long long);
+	/*LINTED*/
+	q->q_cells = (cell_t *)p;
+	p += opts * sizeof (cell_t);
+	/*LINTED*/
+	q->q_nodes = (node_t *)p;
+
+	for (i = 0; i < opts; i++) {
+		q->q_cells[i].c_seq = i;
+		q->q_nodes[i].n_next = i;	/* every node starts free */
+	}
+	q->q_free.l_val = opts;
+
+	(void) pthread_mutexattr_init(&ma);
+	(void) pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED);
+	(void) pthread_condattr_init(&ca);
+	(void) pthread_condattr_setpshared(&ca, PTHREAD_PROCESS_SHARED);
+	if (pthread_mutex_init(&q->q_mutex, &ma) != 0 ||
+	    pthread_cond_init(&q->q_notempty, &ca) != 0 ||
+	    pthread_cond_init(&q->q_notfull, &ca) != 0) {
+		return (-1);
+	}
+
+	if ((q->q_efd = eventfd(0, EFD_SEMAPHORE)) == -1) {
+		perror("eventfd");
+		return (-1);
+	}
+
+	hists = calloc(optc, sizeof (*hists));
+	if (hists == NULL) {
+		return (-1);
+	}
+
+	for (i = 0; i < optc; i++) {
+		if (pthread_create(&tid, NULL, consumer,
+		    (void *)(long)i) != 0) {
+			perror("pthread_create");
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	if (opta) {
+		pin(getpindex() * lm_optT + gettindex());
+	}
+
+	return (0);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	int			spins;
+	int			i;
+
+	for (i = 0; i < lm_optB; i++) {
+		spins = 0;
+		while (optq->qo_put(getnsecs()) == -1) {
+			relax(&spins);
+		}
+	}
+	res->re_count = i;
+
+	ts->ts_items += i;
+	(void) span_stamp(&ts->ts_batch, res);
+
+	return (0);
+}
+
+int
+benchmark_finibatch(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	ts->ts_span += span_batch(offsetof(tsd_t, ts_batch));
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	static long long	hist[NBUCKETS];
+	static double		pcts[] = { 0.50, 0.99, 0.999 };
+	long long		pct[3];
+	tsd_t			*ts;
+	long long		items = 0;
+	int			p, t, b, k;
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			items += ts->ts_items;
+		}
+	}
+
+	for (k = 0; k < optc; k++) {
+		for (b = 0; b < NBUCKETS; b++) {
+			hist[b] += hists[k][b];
+		}
+	}
+
+	for (k = 0; k < 3; k++) {
+		pct[k] = percentile(hist, pcts[k]);
+	}
+
+	ts = (tsd_t *)gettsd(0, 0);
+	(void) sprintf(result, "%7s %4d %4d %6d %8.3f %8.2f %8.2f %8.2f",
+	    optq->qo_name, lm_optP * lm_optT, optc, opts,
+	    ts->ts_span ? (double)items * 1.0e3 / (double)ts->ts_span : 0.0,
+	    pct[0] / 1000.0, pct[1] / 1000.0, pct[2] / 1000.0);
+
+	return (result);
+}
+
+void *
+consumer(void *arg)
+{
+	long long		*hist = hists[(long)arg];
+	long long		v;
+	int			spins;
+
+	if (opta) {
+		pin(lm_optP * lm_optT + (int)(long)arg);
+	}
+
+	for (;;) {
+		spins = 0;
+		while (optq->qo_get(&v) == -1) {
+			relax(&spins);
+		}
+		hist[bucket(getnsecs() - v)]++;
+	}
+
+	/*NOTREACHED*/
+	return (NULL);
+}
+
+void
+pin(int n)
+{
+	cpu_set_t		set;
+
+	CPU_ZERO(&set);
+	CPU_SET(n % sysconf(_SC_NPROCESSORS_ONLN), &set);
+	(void) sched_setaffinity(0, sizeof (set), &set);
+}
+
+/*
+ * a ring under a mutex, with condition variables for full and
+ * empty; never fails, it waits instead.  Each put and get signals,
+ * since more than one thread may be waiting on either side
+ */
+int
+mutex_put(long long v)
+{
+	(void) pthread_mutex_lock(&q->q_mutex);
+	while (q->q_count == opts) {
+		(void) pthread_cond_wait(&q->q_notfull, &q->q_mutex);
+	}
+	q->q_ring[q->q_tail.l_val++ & mask] = v;
+	q->q_count++;
+	(void) pthread_cond_signal(&q->q_notempty);
+	(void) pthread_mutex_unlock(&q->q_mutex);
+
+	return (0);
+}
+
+int
+mutex_get(long long *v)
+{
+	(void) pthread_mutex_lock(&q->q_mutex);
+	while (q->q_count == 0) {
+		(void) pthread_cond_wait(&q->q_notempty, &q->q_mutex);
+	}
+	*v = q->q_ring[q->q_head.l_val++ & mask];
+	q->q_count--;
+	(void) pthread_cond_signal(&q->q_notfull);
+	(void) pthread_mutex_unlock(&q->q_mutex);
+
+	return (0);
+}
+
+/*
+ * Lamport's single producer, single consumer ring: each side
+ * owns one index and only reads the other's
+ */
+int
+spsc_put(long long v)
+{
+	unsigned long long	t = q->q_tail.l_val;
+
+	if (t - __atomic_load_n(&q->q_head.l_val, __ATOMIC_ACQUIRE) == opts) {
+		return (-1);
+	}
+	q->q_ring[t & mask] = v;
+	__atomic_store_n(&q->q_tail.l_val, t + 1, __ATOMIC_RELEASE);
+
+	return (0);
+}
+
+int
+spsc_get(long long *v)
+{
+	unsigned long long	h = q->q_head.l_val;
+
+	if (__atomic_load_n(&q->q_tail.l_val, __ATOMIC_ACQUIRE) == h) {
+		return (-1);
+	}
+	*v = q->q_ring[h & mask];
+	__atomic_store_n(&q->q_head.l_val, h + 1, __ATOMIC_RELEASE);
+
+	return (0);
+}
+
+/*
+ * Vyukov's bounded multi producer, multi consumer ring: a cell's
+ * sequence is its index when free for the lap, index + 1 when full
+ */
+int
+mpmc_put(long long v)
+{
+	unsigned long long	pos, seq;
+	cell_t			*c;
+
+	pos = __atomic_load_n(&q->q_tail.l_val, __ATOMIC_RELAXED);
+	for (;;) {
+		c = &q->q_cells[pos & mask];
+		seq = __atomic_load_n(&c->c_seq, __ATOMIC_ACQUIRE);
+		if (seq == pos) {
+			if (__atomic_compare_exchange_n(&q->q_tail.l_val, &pos,
+			    pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if ((long long)(seq - pos) < 0) {
+			return (-1);
+		} else {
+			pos = __atomic_load_n(&q->q_tail.l_val,
+			    __ATOMIC_RELAXED);
+		}
+	}
+
+	c->c_val = v;
+	__atomic_store_n(&c->c_seq, pos + 1, __ATOMIC_RELEASE);
+
+	return (0);
+}
+
+int
+mpmc_get(long long *v)
+{
+	unsigned long long	pos, seq;
+	cell_t			*c;
+
+	pos = __atomic_load_n(&q->q_head.l_val, __ATOMIC_RELAXED);
+	for (;;) {
+		c = &q->q_cells[pos & mask];
+		seq = __atomic_load_n(&c->c_seq, __ATOMIC_ACQUIRE);
+		if (seq == pos + 1) {
+			if (__atomic_compare_exchange_n(&q->q_head.l_val, &pos,
+			    pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if ((long long)(seq - (pos + 1)) < 0) {
+			return (-1);
+		} else {
+			pos = __atomic_load_n(&q->q_head.l_val,
+			    __ATOMIC_RELAXED);
+		}
+	}
+
+	*v = c->c_val;
+	__atomic_store_n(&c->c_seq, pos + mask + 1, __ATOMIC_RELEASE);
+
+	return (0);
+}
+
+/*
+ * Treiber stacks of node indices; the top word carries a count
+ * of changes in its upper half, so a top that was popped and
+ * pushed back in between (ABA) no longer compares equal
+ */
+static void
+push(unsigned long long *top, unsigned n)
+{
+	unsigned long long	old, new;
+
+	old = __atomic_load_n(top, __ATOMIC_RELAXED);
+	do {
+		q->q_nodes[n].n_next = (unsigned)old;
+		new = ((old >> 32) + 1) << 32 | (n + 1);
+	} while (!__atomic_compare_exchange_n(top, &old, new, 1,
+	    __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static int
+pop(unsigned long long *top)
+{
+	unsigned long long	old, new;
+	unsigned		n;
+
+	old = __atomic_load_n(top, __ATOMIC_ACQUIRE);
+	do {
+		if ((unsigned)old == 0) {
+			return (-1);
+		}
+		n = (unsigned)old - 1;
+		/* stale if someone got here first; then the CAS fails */
+		new = ((old >> 32) + 1) << 32 |
+		    __atomic_load_n(&q->q_nodes[n].n_next, __ATOMIC_RELAXED);
+	} while (!__atomic_compare_exchange_n(top, &old, new, 1,
+	    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+	return (n);
+}
+
+int
+treiber_put(long long v)
+{
+	int			n;
+
+	if ((n = pop(&q->q_free.l_val)) == -1) {
+		return (-1);
+	}
+	q->q_nodes[n].n_val = v;
+	push(&q->q_top.l_val, n);
+
+	return (0);
+}
+
+int
+treiber_get(long long *v)
+{
+	int			n;
+
+	if ((n = pop(&q->q_top.l_val)) == -1) {
+		return (-1);
+	}
+	*v = q->q_nodes[n].n_val;
+	push(&q->q_free.l_val, n);
+
+	return (0);
+}
+
+/*
+ * the mpmc ring, with consumers sleeping in a semaphore mode
+ * eventfd that counts what's in it
+ */
+int
+eventfd_put(long long v)
+{
+	eventfd_t		one = 1;
+
+	if (mpmc_put(v) == -1) {
+		return (-1);
+	}
+	(void) write(q->q_efd, &one, sizeof (one));
+
+	return (0);
+}
+
+int
+eventfd_get(long long *v)
+{
+	eventfd_t		one;
+	int			spins = 0;
+
+	if (read(q->q_efd, &one, sizeof (one)) != sizeof (one)) {
+		return (-1);
+	}
+	/* each one counted was already in the ring, so one is ours */
+	while (mpmc_get(v) == -1) {
+		relax(&spins);
+	}
+
+	return (0);
+}
@@ -0,0 +1,104 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+
+/*
+ * maps an io_uring's submission and completion queues; with
+ * IORING_SETUP_SQPOLL in flags the kernel's polling thread idles
+ * after a second
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "ring.h"
+
+int
+ring_setup(ring_t *r, unsigned entries, unsigned flags)
+{
+	struct io_uring_params	p;
+	size_t			sqsize, cqsize;
+	char			*sq, *cq;
+
+	(void) memset(&p, 0, sizeof (p));
+	(void) memset(r, 0, sizeof (*r));
+	p.flags = flags;
+	if (flags & IORING_SETUP_SQPOLL) {
+		p.sq_thread_idle = 1000;
+	}
+
+	if ((r->r_fd = syscall(__NR_io_uring_setup, entries, &p)) == -1) {
+		return (-1);
+	}
+	r->r_entries = p.sq_entries;
+
+	sqsize = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+	cqsize = p.cq_off.cqes + p.cq_entries *
+	    sizeof (struct io_uring_cqe);
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (cqsize > sqsize) {
+			sqsize = cqsize;
+		}
+	}
+
+	sq = mmap(NULL, sqsize, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, r->r_fd, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED) {
+		return (-1);
+	}
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		cq = sq;
+	} else {
+		cq = mmap(NULL, cqsize, PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_POPULATE, r->r_fd, IORING_OFF_CQ_RING);
+		if (cq == MAP_FAILED) {
+			return (-1);
+		}
+	}
+
+	r->r_sqes = mmap(NULL, p.sq_entries * sizeof (struct io_uring_sqe),
+	    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->r_fd,
+	    IORING_OFF_SQES);
+	if (r->r_sqes == MAP_FAILED) {
+		return (-1);
+	}
+
+	r->r_sqhead = (unsigned *)(sq + p.sq_off.head);
+	r->r_sqtail = (unsigned *)(sq + p.sq_off.tail);
+	r->r_sqmask = (unsigned *)(sq + p.sq_off.ring_mask);
+	r->r_sqflags = (unsigned *)(sq + p.sq_off.flags);
+	r->r_sqarray = (unsigned *)(sq + p.sq_off.array);
+	r->r_cqhead = (unsigned *)(cq + p.cq_off.head);
+	r->r_cqtail = (unsigned *)(cq + p.cq_off.tail);
+	r->r_cqmask = (unsigned *)(cq + p.cq_off.ring_mask);
+	r->r_cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	return (0);
+}
@@ -0,0 +1,54 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef RING_H
+#define	RING_H
+
+#include <linux/io_uring.h>
+
+/*
+ * an io_uring set up by hand, without liburing, shared by uring
+ * and rpc; Linux only
+ */
+
+typedef struct {
+	int			r_fd;
+	unsigned		r_entries;
+	unsigned		r_pending;	/* queued, not yet entered */
+	unsigned		*r_sqhead;
+	unsigned		*r_sqtail;
+	unsigned		*r_sqmask;
+	unsigned		*r_sqflags;
+	unsigned		*r_sqarray;
+	unsigned		*r_cqhead;
+	unsigned		*r_cqtail;
+	unsigned		*r_cqmask;
+	struct io_uring_sqe	*r_sqes;
+	struct io_uring_cqe	*r_cqes;
+} ring_t;
+
+int	ring_setup(ring_t *r, unsigned entries, unsigned flags);
+
+#endif /* RING_H */
@@ -0,0 +1,733 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * request/response over loopback TCP against an echo server
+ * started by the parent process before the workers fork, built
+ * as a thread per connection, one epoll loop, several epoll
+ * loops on SO_REUSEPORT listeners, or one io_uring loop; the
+ * workers are the clients; Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <errno.h>
+
+#include "libmicro.h"
+#include "ring.h"
+
+#define	MIN(x, y)		((x) > (y) ? (y) : (x))
+
+#define	MAXC			256
+#define	DEFC			1
+#define	DEFN			4
+#define	DEFS			64
+#define	NEVENTS			64
+#define	RINGSIZE		1024
+
+#define	HOW_THREAD		0
+#define	HOW_EPOLL		1
+#define	HOW_REUSEPORT		2
+#define	HOW_URING		3
+
+static char			*hows[] = {
+	"thread", "epoll", "reuseport", "uring", NULL
+};
+
+typedef struct {
+	char			*ts_buf;
+	int			ts_conns[MAXC];
+	long long		ts_t0[MAXC];
+	long long		ts_reqs;
+	long long		ts_nsecs;
+	long long		ts_hist[NBUCKETS];
+} tsd_t;
+
+/* server side state for a connection */
+typedef struct {
+	int			c_fd;
+	int			c_sending;
+	int			c_polling;	/* epoll: for EPOLLOUT */
+	long long		c_done;
+	char			*c_buf;
+} conn_t;
+
+
+static int			optc = DEFC;
+static int			optn = DEFN;
+static long long		opts = DEFS;
+static int			optx = HOW_EPOLL;
+static struct sockaddr_in	add;
+
+int prepare_listener(int port);
+int readall(int s, char *buf, long long len);
+int writeall(int s, char *buf, long long len);
+conn_t *newconn(int s);
+void *acceptor(void *arg);
+void *handler(void *arg);
+void *eventloop(void *arg);
+int serve(int epfd, conn_t *c);
+void *uringloop(void *arg);
+struct io_uring_sqe *ring_get(ring_t *r);
+int ring_enter(ring_t *r, int wait);
+void queue_io(ring_t *r, conn_t *c);
+
+int
+benchmark_init()
+{
+	lm_defB = 256;
+	lm_tsdsize = sizeof (tsd_t);
+
+	(void) sprintf(lm_optstr, "c:n:s:x:");
+
+	(void) sprintf(lm_usage,
+	    "       [-c connections per client thread (default %d, "
+	    "max %d)]\n"
+	    "       [-n server loops for -x reuseport (default %d)]\n"
+	    "       [-s request and response size (default %d)]\n"
+	    "       [-x thread|epoll|reuseport|uring (default epoll)]\n"
+	    "notes: each worker thread keeps one request outstanding on\n"
+	    "       each of its connections; usecs/call is per request,\n"
+	    "       the percentiles are of request round trip times\n",
+	    DEFC, MAXC, DEFN, DEFS);
+
+	(void) sprintf(lm_header, "%9s %4s %5s %6s %9s %8s %8s %8s",
+	    "server", "nsrv", "conns", "size", "Kreq/s", "p50_us",
+	    "p99_us", "p999_us");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	int			i;
+
+	switch (opt) {
+	case 'c':
+		optc = atoi(optarg);
+		break;
+	case 'n':
+		optn = atoi(optarg);
+		break;
+	case 's':
+		opts = sizetoll(optarg);
+		break;
+	case 'x':
+		for (i = 0; hows[i] != NULL; i++) {
+			if (strcmp(optarg, hows[i]) == 0) {
+				break;
+			}
+		}
+		if (hows[i] == NULL) {
+			return (-1);
+		}
+		optx = i;
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * the server lives in the parent, and outlives the workers
+ */
+int
+benchmark_initrun()
+{
+	struct io_uring_params	p;
+	pthread_t		tid;
+	socklen_t		size = sizeof (struct sockaddr_in);
+	int			lsn;
+	int			i, s;
+
+	if (optc <= 0 || optc > MAXC) {
+		(void) printf("ERROR: -c must be between 1 and %d\n", MAXC);
+		return (-1);
+	}
+	if (opts <= 0) {
+		(void) printf("ERROR: -s must be positive\n");
+		return (-1);
+	}
+	if (optx != HOW_REUSEPORT) {
+		optn = 1;
+	} else if (optn <= 0) {
+		(void) printf("ERROR: -n must be positive\n");
+		return (-1);
+	}
+
+	if (optx == HOW_URING) {
+		(void) memset(&p, 0, sizeof (p));
+		if ((s = syscall(__NR_io_uring_setup, 1, &p)) == -1) {
+			(void) printf(
+			    "#\n"
+			    "# benchmark rpc -x uring skipped: "
+			    "io_uring_setup: %s\n"
+			    "#\n",
+			    strerror(errno));
+			exit(0);
+		}
+		(void) close(s);
+	}
+
+	(void) setfdlimit(2 * lm_optP * lm_optT * optc + optn + 20);
+
+	if ((lsn = prepare_listener(0)) == -1 ||
+	    getsockname(lsn, (struct sockaddr *)&add, &size) == -1) {
+		perror("prepare_listener");
+		return (-1);
+	}
+
+	for (i = 0; i < optn; i++) {
+		if (i > 0 && (lsn = prepare_listener(add.sin_port)) == -1) {
+			perror("prepare_listener");
+			return (-1);
+		}
+
+		if (pthread_create(&tid, NULL, optx == HOW_THREAD ?
+		    acceptor : (optx == HOW_URING ? uringloop : eventloop),
+		    (void *)(long)lsn) != 0) {
+			perror("pthread_create");
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	int			opt = 1;
+	int			i;
+
+	if ((ts->ts_buf = malloc(opts)) == NULL) {
+		return (1);
+	}
+	(void) memset(ts->ts_buf, 'a', opts);
+
+	for (i = 0; i < optc; i++) {
+		ts->ts_conns[i] = socket(AF_INET, SOCK_STREAM, 0);
+		if (ts->ts_conns[i] == -1 ||
+		    connect(ts->ts_conns[i], (struct sockaddr *)&add,
+		    sizeof (struct sockaddr_in)) == -1) {
+			perror("connect");
+			return (1);
+		}
+		(void) setsockopt(ts->ts_conns[i], IPPROTO_TCP, TCP_NODELAY,
+		    &opt, sizeof (int));
+	}
+
+	return (0);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	char			*buf = ts->ts_buf;
+	long long		t1;
+	int			i, j, n;
+
+	/*
+	 * a request on every connection, then collect the answers
+	 */
+	for (i = 0; i < lm_optB; i += n) {
+		n = MIN(optc, lm_optB - i);
+
+		for (j = 0; j < n; j++) {
+			ts->ts_t0[j] = getnsecs();
+			if (writeall(ts->ts_conns[j], buf, opts) == -1) {
+				res->re_errors++;
+			}
+		}
+		for (j = 0; j < n; j++) {
+			if (readall(ts->ts_conns[j], buf, opts) == -1) {
+				res->re_errors++;
+			}
+			t1 = getnsecs();
+			ts->ts_hist[bucket(t1 - ts->ts_t0[j])]++;
+		}
+	}
+	res->re_count = i;
+
+	ts->ts_reqs += i;
+	ts->ts_nsecs += getnsecs() - res->re_t0;
+
+	return (0);
+}
+
+int
+benchmark_finiworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	int			i;
+
+	for (i = 0; i < optc; i++) {
+		(void) close(ts->ts_conns[i]);
+	}
+	free(ts->ts_buf);
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	static long long	hist[NBUCKETS];
+	static double		pcts[] = { 0.50, 0.99, 0.999 };
+	long long		pct[3];
+	tsd_t			*ts;
+	double			rate = 0.0;
+	int			p, t, b, k;
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			if (ts->ts_nsecs > 0) {
+				rate += (double)ts->ts_reqs * 1.0e6 /
+				    (double)ts->ts_nsecs;
+			}
+			for (b = 0; b < NBUCKETS; b++) {
+				hist[b] += ts->ts_hist[b];
+			}
+		}
+	}
+
+	for (k = 0; k < 3; k++) {
+		pct[k] = percentile(hist, pcts[k]);
+	}
+
+	(void) sprintf(result, "%9s %4d %5d %6lld %9.1f %8.2f %8.2f %8.2f",
+	    hows[optx], optn, optc * lm_optT * lm_optP, opts, rate,
+	    pct[0] / 1000.0, pct[1] / 1000.0, pct[2] / 1000.0);
+
+	return (result);
+}
+
+/*
+ * thread per connection
+ */
+void *
+acceptor(void *arg)
+{
+	int			lsn = (int)(long)arg;
+	pthread_attr_t		attr;
+	pthread_t		tid;
+	conn_t			*c;
+	int			s;
+
+	(void) pthread_attr_init(&attr);
+	(void) pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	while ((s = accept(lsn, NULL, NULL)) != -1 ||
+	    errno == EINTR || errno == ECONNABORTED) {
+		if (s != -1 && (c = newconn(s)) != NULL) {
+			(void) pthread_create(&tid, &attr, handler, c);
+		}
+	}
+
+	return (NULL);
+}
+
+void *
+handler(void *arg)
+{
+	conn_t			*c = (conn_t *)arg;
+
+	while (readall(c->c_fd, c->c_buf, opts) == 0 &&
+	    writeall(c->c_fd, c->c_buf, opts) == 0)
+		;
+
+	(void) close(c->c_fd);
+	free(c->c_buf);
+	free(c);
+
+	return (NULL);
+}
+
+/*
+ * level triggered epoll loop over non-blocking sockets: a request
+ * is read until it has all arrived, and the answer sent for as long
+ * as the socket takes it, the rest waiting for EPOLLOUT so that one
+ * slow client holds up no other
+ */
+void *
+eventloop(void *arg)
+{
+	int			lsn = (int)(long)arg;
+	struct epoll_event	evs[NEVENTS];
+	struct epoll_event	ev;
+	conn_t			*c;
+	int			epfd;
+	int			i, n, s;
+
+	if ((epfd = epoll_create1(0)) == -1) {
+		perror("epoll_create1");
+		return (NULL);
+	}
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	(void) epoll_ctl(epfd, EPOLL_CTL_ADD, lsn, &ev);
+
+	for (;;) {
+		n = epoll_wait(epfd, evs, NEVENTS, -1);
+
+		for (i = 0; i < n; i++) {
+			if ((c = evs[i].data.ptr) == NULL) {
+				while ((s = accept4(lsn, NULL, NULL,
+				    SOCK_NONBLOCK)) != -1) {
+					if ((c = newconn(s)) == NULL) {
+						(void) close(s);
+						continue;
+					}
+					ev.events = EPOLLIN;
+					ev.data.ptr = c;
+					(void) epoll_ctl(epfd, EPOLL_CTL_ADD,
+					    s, &ev);
+				}
+				continue;
+			}
+
+			if (serve(epfd, c) == -1) {
+				/* closing removes it from the epoll set */
+				(void) close(c->c_fd);
+				free(c->c_buf);
+				free(c);
+			}
+		}
+	}
+
+	/* NOTREACHED */
+	return (NULL);
+}
+
+/*
+ * moves what it can of a connection's request or answer without
+ * blocking, and waits on whichever of reading or writing is next;
+ * -1 once the client has gone
+ */
+int
+serve(int epfd, conn_t *c)
+{
+	struct epoll_event	ev;
+	ssize_t			r;
+
+	if (!c->c_sending) {
+		r = read(c->c_fd, c->c_buf + c->c_done, opts - c->c_done);
+		if (r == -1 && errno == EAGAIN) {
+			return (0);
+		}
+		if (r <= 0) {
+			return (-1);
+		}
+		if ((c->c_done += r) < opts) {
+			return (0);
+		}
+		c->c_done = 0;
+		c->c_sending = 1;
+	}
+
+	while (c->c_done < opts) {
+		r = send(c->c_fd, c->c_buf + c->c_done, opts - c->c_done,
+		    MSG_NOSIGNAL);
+		if (r == -1 && errno == EAGAIN) {
+			break;
+		}
+		if (r <= 0) {
+			return (-1);
+		}
+		c->c_done += r;
+	}
+
+	if (c->c_done == opts) {
+		c->c_done = 0;
+		c->c_sending = 0;
+	}
+
+	/* EPOLLOUT only while an answer is stuck */
+	if (c->c_sending != c->c_polling) {
+		c->c_polling = c->c_sending;
+		ev.events = c->c_sending ? EPOLLOUT : EPOLLIN;
+		ev.data.ptr = c;
+		(void) epoll_ctl(epfd, EPOLL_CTL_MOD, c->c_fd, &ev);
+	}
+
+	return (0);
+}
+
+/*
+ * io_uring loop: one accept always outstanding, and on each
+ * connection either a recv or a send of what's left to move
+ */
+void *
+uringloop(void *arg)
+{
+	int			lsn = (int)(long)arg;
+	ring_t			ring;
+	struct io_uring_sqe	*sqe;
+	struct io_uring_cqe	*cqe;
+	conn_t			*c;
+	unsigned		head, tail;
+	int			accepting = 0;
+	int			res;
+
+	if (ring_setup(&ring, RINGSIZE, 0) == -1) {
+		perror("io_uring_setup");
+		return (NULL);
+	}
+
+	for (;;) {
+		if (!accepting && (sqe = ring_get(&ring)) != NULL) {
+			sqe->opcode = IORING_OP_ACCEPT;
+			sqe->fd = lsn;
+			sqe->user_data = 0;
+			accepting = 1;
+		}
+
+		if (ring_enter(&ring, 1) == -1) {
+			perror("io_uring_enter");
+			return (NULL);
+		}
+
+		head = *ring.r_cqhead;
+		tail = __atomic_load_n(ring.r_cqtail, __ATOMIC_ACQUIRE);
+
+		for (; head != tail; head++) {
+			cqe = &ring.r_cqes[head & *ring.r_cqmask];
+			c = (conn_t *)(unsigned long)cqe->user_data;
+			res = cqe->res;
+
+			if (c == NULL) {
+				accepting = 0;
+				if (res >= 0 && (c = newconn(res)) != NULL) {
+					queue_io(&ring, c);
+				}
+				continue;
+			}
+
+			if (res <= 0) {
+				(void) close(c->c_fd);
+				free(c->c_buf);
+				free(c);
+				continue;
+			}
+
+			c->c_done += res;
+			if (c->c_done == opts) {
+				c->c_done = 0;
+				c->c_sending = !c->c_sending;
+			}
+			queue_io(&ring, c);
+		}
+
+		__atomic_store_n(ring.r_cqhead, head, __ATOMIC_RELEASE);
+	}
+
+	/* NOTREACHED */
+	return (NULL);
+}
+
+void
+queue_io(ring_t *r, conn_t *c)
+{
+	struct io_uring_sqe	*sqe;
+
+	if ((sqe = ring_get(r)) == NULL) {
+		return;
+	}
+
+	sqe->opcode = c->c_sending ? IORING_OP_SEND : IORING_OP_RECV;
+	sqe->msg_flags = c->c_sending ? MSG_NOSIGNAL : 0;
+	sqe->fd = c->c_fd;
+	sqe->addr = (unsigned long)(c->c_buf + c->c_done);
+	sqe->len = opts - c->c_done;
+	sqe->user_data = (unsigned long)c;
+}
+
+/*
+ * the next free submission entry, flushing the queue if it's full
+ */
+struct io_uring_sqe *
+ring_get(ring_t *r)
+{
+	struct io_uring_sqe	*sqe;
+	unsigned		tail = *r->r_sqtail;
+	unsigned		idx;
+
+	if (tail - __atomic_load_n(r->r_sqhead, __ATOMIC_ACQUIRE) ==
+	    r->r_entries && ring_enter(r, 0) == -1) {
+		return (NULL);
+	}
+
+	idx = tail & *r->r_sqmask;
+	sqe = &r->r_sqes[idx];
+	(void) memset(sqe, 0, sizeof (*sqe));
+	r->r_sqarray[idx] = idx;
+	r->r_pending++;
+
+	__atomic_store_n(r->r_sqtail, tail + 1, __ATOMIC_RELEASE);
+
+	return (sqe);
+}
+
+int
+ring_enter(ring_t *r, int wait)
+{
+	int			n;
+
+	for (;;) {
+		n = syscall(__NR_io_uring_enter, r->r_fd, r->r_pending,
+		    wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+		if (n != -1) {
+			r->r_pending -= n;
+			return (0);
+		}
+		if (errno != EINTR) {
+			return (-1);
+		}
+	}
+}
+
+
+conn_t *
+newconn(int s)
+{
+	conn_t			*c;
+	int			opt = 1;
+
+	if ((c = calloc(1, sizeof (conn_t))) == NULL ||
+	    (c->c_buf = malloc(opts)) == NULL) {
+		free(c);
+		return (NULL);
+	}
+	c->c_fd = s;
+
+	(void) setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof (int));
+
+	return (c);
+}
+
+int
+prepare_listener(int port)
+{
+	struct sockaddr_in	sin;
+	int			opt = 1;
+	int			s;
+
+	/* event loops accept until there's nothing left */
+	if ((s = socket(AF_INET, SOCK_STREAM | (optx == HOW_EPOLL ||
+	    optx == HOW_REUSEPORT ? SOCK_NONBLOCK : 0), 0)) == -1) {
+		return (-1);
+	}
+
+	if (optx == HOW_REUSEPORT && setsockopt(s, SOL_SOCKET,
+	    SO_REUSEPORT, &opt, sizeof (int)) == -1) {
+		return (-1);
+	}
+
+	(void) memset(&sin, 0, sizeof (struct sockaddr_in));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = port;
+
+	if (bind(s, (struct sockaddr *)&sin, sizeof (sin)) == -1 ||
+	    listen(s, MAXC) == -1) {
+		return (-1);
+	}
+
+	return (s);
+}
+
+/*
+ * blocking or not, move all of it; a client that has gone away
+ * must not take the server down with SIGPIPE
+ */
+int
+readall(int s, char *buf, long long len)
+{
+	struct pollfd		pfd;
+	ssize_t			n;
+
+	while (len > 0) {
+		if ((n = read(s, buf, len)) > 0) {
+			buf += n;
+			len -= n;
+			continue;
+		}
+		if (n == -1 && errno == EAGAIN) {
+			pfd.fd = s;
+			pfd.events = POLLIN;
+			(void) poll(&pfd, 1, -1);
+			continue;
+		}
+		return (-1);
+	}
+
+	return (0);
+}
+
+int
+writeall(int s, char *buf, long long len)
+{
+	struct pollfd		pfd;
+	ssize_t			n;
+
+	while (len > 0) {
+		if ((n = send(s, buf, len, MSG_NOSIGNAL)) > 0) {
+			buf += n;
+			len -= n;
+			continue;
+		}
+		if (n == -1 && errno == EAGAIN) {
+			pfd.fd = s;
+			pfd.events = POLLOUT;
+			(void) poll(&pfd, 1, -1);
+			continue;
+		}
+		return (-1);
+	}
+
+	return (0);
+}
@@ -0,0 +1,264 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+
+/*
+ * the draws behind the -d and -g options of the mem* and str*
+ * benchmarks: n always, uniform or log-uniform between two sizes, or
+ * in proportion to the weights of a histogram, such as one taken of
+ * a production service's calls
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "libmicro.h"
+#include "sizedist.h"
+
+#define	U53			(1.0 / 9007199254740992.0)
+
+static double
+uniform(unsigned long long *state)
+{
+	return ((rnd(state) >> 11) * U53);
+}
+
+/*
+ * lo-hi
+ */
+static int
+range(char *s, long long *lo, long long *hi)
+{
+	char			*dash;
+
+	if ((dash = strchr(s, '-')) == NULL) {
+		return (-1);
+	}
+	*dash = '\0';
+	*lo = sizetoll(s);
+	*hi = sizetoll(dash + 1);
+	*dash = '-';
+
+	return (*lo < 0 || *hi < *lo ? -1 : 0);
+}
+
+/*
+ * draws from a histogram file; each line holds a size and its
+ * weight, and # starts a comment
+ */
+static int
+histogram(char *name, long long *out, unsigned long long *state)
+{
+	FILE			*fp;
+	char			line[256];
+	char			size[64];
+	long long		*sizes = NULL;
+	double			*cum = NULL;
+	double			weight, total = 0.0, u;
+	int			n = 0, max = 0;
+	int			i, lo, hi, mid;
+
+	if ((fp = fopen(name, "r")) == NULL) {
+		perror(name);
+		return (-1);
+	}
+
+	while (fgets(line, sizeof (line), fp) != NULL) {
+		if (line[0] == '#' ||
+		    sscanf(line, "%63s %lf", size, &weight) != 2) {
+			continue;
+		}
+		if (weight <= 0.0) {
+			continue;
+		}
+		if (n == max) {
+			max = max ? 2 * max : 256;
+			sizes = realloc(sizes, max * sizeof (long long));
+			cum = realloc(cum, max * sizeof (double));
+			if (sizes == NULL || cum == NULL) {
+				(void) fclose(fp);
+				return (-1);
+			}
+		}
+		sizes[n] = sizetoll(size);
+		total += weight;
+		cum[n++] = total;
+	}
+	(void) fclose(fp);
+
+	if (n == 0) {
+		(void) printf("ERROR: %s holds no sizes\n", name);
+		return (-1);
+	}
+
+	for (i = 0; i < SD_N; i++) {
+		u = uniform(state) * total;
+		for (lo = 0, hi = n - 1; lo < hi; ) {
+			mid = (lo + hi) / 2;
+			if (cum[mid] <= u) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		out[i] = sizes[lo];
+	}
+
+	free(sizes);
+	free(cum);
+
+	return (0);
+}
+
+static int
+draw(char *spec, long long def, long long *out, unsigned long long seed)
+{
+	unsigned long long	state = seed;
+	long long		lo, hi;
+	int			i;
+
+	if (spec == NULL) {
+		for (i = 0; i < SD_N; i++) {
+			out[i] = def;
+		}
+		return (0);
+	}
+
+	if (strncmp(spec, "file:", 5) == 0) {
+		return (histogram(spec + 5, out, &state));
+	}
+
+	if (strncmp(spec, "uniform:", 8) == 0) {
+		if (range(spec + 8, &lo, &hi) == -1) {
+			return (-1);
+		}
+		for (i = 0; i < SD_N; i++) {
+			out[i] = lo + (long long)(uniform(&state) *
+			    (hi - lo + 1));
+		}
+		return (0);
+	}
+
+	if (strncmp(spec, "log:", 4) == 0) {
+		if (range(spec + 4, &lo, &hi) == -1 || lo < 1) {
+			return (-1);
+		}
+		for (i = 0; i < SD_N; i++) {
+			out[i] = (long long)exp(log((double)lo) +
+			    uniform(&state) *
+			    (log(hi + 1.0) - log((double)lo)));
+			if (out[i] > hi) {
+				out[i] = hi;
+			}
+		}
+		return (0);
+	}
+
+	if (*spec < '0' || *spec > '9') {
+		return (-1);
+	}
+	lo = sizetoll(spec);
+	for (i = 0; i < SD_N; i++) {
+		out[i] = lo;
+	}
+
+	return (lo < 0 ? -1 : 0);
+}
+
+/*
+ * sizes from one distribution and alignments from another, where
+ * either may be NULL for a fixed size or alignment; the seeds are
+ * fixed so that runs are repeatable
+ */
+int
+sizedist_init(sizedist_t *sd, char *sizes, long long size, char *aligns,
+    long long align)
+{
+	int			i;
+
+	if (draw(sizes, size, sd->sd_size, 0x9e3779b97f4a7c15ULL) == -1) {
+		(void) printf("ERROR: can't draw sizes from %s\n", sizes);
+		return (-1);
+	}
+	if (draw(aligns, align, sd->sd_align, 0xd1b54a32d192ed03ULL) == -1) {
+		(void) printf("ERROR: can't draw alignments from %s\n",
+		    aligns);
+		return (-1);
+	}
+
+	sd->sd_maxsize = sd->sd_maxalign = 0;
+	sd->sd_mean = 0.0;
+	for (i = 0; i < SD_N; i++) {
+		if (sd->sd_size[i] > sd->sd_maxsize) {
+			sd->sd_maxsize = sd->sd_size[i];
+		}
+		if (sd->sd_align[i] > sd->sd_maxalign) {
+			sd->sd_maxalign = sd->sd_align[i];
+		}
+		sd->sd_mean += sd->sd_size[i];
+	}
+	sd->sd_mean /= SD_N;
+
+	return (0);
+}
+
+/*
+ * a string for each draw, of the drawn length and at the drawn
+ * offset from a 64 byte boundary, all carved from one allocation
+ */
+char **
+sizedist_strings(sizedist_t *sd)
+{
+	static char		*demo =
+	    "The quick brown fox jumps over the lazy dog.";
+	char			**strs;
+	char			*arena;
+	size_t			len = 0;
+	long long		j;
+	int			l = strlen(demo);
+	int			i;
+
+	for (i = 0; i < SD_N; i++) {
+		len += (sd->sd_align[i] + sd->sd_size[i] + 1 + 63) & ~63LL;
+	}
+
+	if ((strs = malloc(SD_N * sizeof (char *))) == NULL ||
+	    posix_memalign((void **)&arena, 64, len) != 0) {
+		return (NULL);
+	}
+
+	for (i = 0; i < SD_N; i++) {
+		strs[i] = arena + sd->sd_align[i];
+		for (j = 0; j < sd->sd_size[i]; j++) {
+			strs[i][j] = demo[j % l];
+		}
+		strs[i][j] = '\0';
+		arena += (sd->sd_align[i] + sd->sd_size[i] + 1 + 63) & ~63LL;
+	}
+
+	return (strs);
+}
@@ -0,0 +1,54 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef SIZEDIST_H
+#define	SIZEDIST_H
+
+/*
+ * sizes and alignments drawn ahead of time from a distribution, so
+ * that calls cycling through them can't settle on one path through
+ * the routine under test
+ */
+
+#define	SD_N			4096	/* draws, a power of two */
+
+#define	SD_USAGE							\
+	"       dist is n, uniform:lo-hi, log:lo-hi (uniform in the\n"	\
+	"       log of the size) or file:name, a histogram of lines of\n" \
+	"       size and weight\n"
+
+typedef struct {
+	long long		sd_size[SD_N];
+	long long		sd_align[SD_N];
+	long long		sd_maxsize;
+	long long		sd_maxalign;
+	double			sd_mean;	/* size */
+} sizedist_t;
+
+int	sizedist_init(sizedist_t *sd, char *sizes, long long size,
+	    char *aligns, long long align);
+char	**sizedist_strings(sizedist_t *sd);
+
+#endif /* SIZEDIST_H */
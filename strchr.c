@@ -34,14 +34,21 @@
 #include <string.h>
 
 #include "libmicro.h"
+#include "sizedist.h"
 
 static int unaligned = 0;
 static int opts = 100;
+static char *optd = NULL;
+static char *optg = NULL;
+static int dist;
+static sizedist_t sd;
 
 typedef struct {
 	int	ts_once;
 	char 	*ts_string;
 	char	*ts_fakegcc;
+	char	**ts_strs;
+	int	ts_next;
 } tsd_t;
 
 int
@@ -50,13 +57,17 @@ benchmark_init()
 
 	lm_tsdsize = sizeof (tsd_t);
 
-	(void) sprintf(lm_optstr, "s:n");
+	(void) sprintf(lm_optstr, "d:g:s:n");
 
 	(void) sprintf(lm_usage,
 	    "       [-s string size (default %d)]\n"
 	    "       [-n causes unaligned strchr]\n"
-	    "notes: measures strchr()\n",
-	    opts);
+	    "       [-d dist (draw string sizes from dist instead of -s)]\n"
+	    "       [-g dist (draw alignments from dist instead of -n)]\n"
+	    SD_USAGE
+	    "notes: measures strchr(); with -d or -g the calls cycle\n"
+	    "       through %d draws and size is their mean\n",
+	    opts, SD_N);
 
 	(void) sprintf(lm_header, "%8s", "size");
 
@@ -67,6 +78,12 @@ int
 benchmark_optswitch(int opt, char *optarg)
 {
 	switch (opt) {
+	case 'd':
+		optd = optarg;
+		break;
+	case 'g':
+		optg = optarg;
+		break;
 	case 'n':
 		unaligned = 1;
 		break;
@@ -79,6 +96,17 @@ benchmark_optswitch(int opt, char *optarg)
 	return (0);
 }
 
+int
+benchmark_initrun()
+{
+	dist = optd != NULL || optg != NULL;
+	if (dist && sizedist_init(&sd, optd, opts, optg, unaligned) == -1) {
+		return (-1);
+	}
+
+	return (0);
+}
+
 int
 benchmark_initbatch(void *tsd)
 {
@@ -87,6 +115,12 @@ benchmark_initbatch(void *tsd)
 	static char	*demo =
 	    "The quick brown fox jumps over the lazy dog.";
 
+	if (ts->ts_once == 0 && dist) {
+		ts->ts_once++;
+		if ((ts->ts_strs = sizedist_strings(&sd)) == NULL)
+			return (1);
+	}
+
 	if (ts->ts_once++ == 0) {
 		int l = strlen(demo);
 		int i;
@@ -111,6 +145,16 @@ benchmark(void *tsd, result_t *res)
 	int			i;
 	tsd_t			*ts = (tsd_t *)tsd;
 	char 			*src = ts->ts_string;
+	char			**strs = ts->ts_strs;
+
+	if (dist) {
+		for (i = 0; i < lm_optB; i++) {
+			ts->ts_fakegcc =
+			    strchr(strs[ts->ts_next++ & (SD_N - 1)], 'X');
+		}
+		res->re_count = i;
+		return (0);
+	}
 
 	for (i = 0; i < lm_optB; i += 10) {
 		ts->ts_fakegcc = strchr(src, 'X');
@@ -135,7 +179,11 @@ benchmark_result()
 {
 	static char		result[256];
 
-	if (unaligned == 0)
+	if (dist)
+		(void) sprintf(result, "%8.0f <%s%s%s>", sd.sd_mean,
+		    optd ? optd : "fixed", optg ? ", align " : "",
+		    optg ? optg : "");
+	else if (unaligned == 0)
 		(void) sprintf(result, "%8d", opts);
 	else
 		(void) sprintf(result, "%8d <unaligned>", opts);
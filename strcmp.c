@@ -34,15 +34,23 @@
 #include <string.h>
 
 #include "libmicro.h"
+#include "sizedist.h"
 
 static int unaligned = 0;
 static int opts = 100;
+static char *optd = NULL;
+static char *optg = NULL;
+static int dist;
+static sizedist_t sd;
 
 typedef struct {
 	int	ts_once;
 	char 	*ts_a;
 	char 	*ts_b;
 	int	ts_fakegcc;
+	char	**ts_as;
+	char	**ts_bs;
+	int	ts_next;
 } tsd_t;
 
 int
@@ -51,13 +59,17 @@ benchmark_init()
 
 	lm_tsdsize = sizeof (tsd_t);
 
-	(void) sprintf(lm_optstr, "s:n");
+	(void) sprintf(lm_optstr, "d:g:s:n");
 
 	(void) sprintf(lm_usage,
 	    "       [-s string size (default %d)]\n"
 	    "       [-n causes unaligned cmp]\n"
-	    "notes: measures strcmp()\n",
-	    opts);
+	    "       [-d dist (draw string sizes from dist instead of -s)]\n"
+	    "       [-g dist (draw alignments from dist instead of -n)]\n"
+	    SD_USAGE
+	    "notes: measures strcmp(); with -d or -g the calls cycle\n"
+	    "       through %d draws and size is their mean\n",
+	    opts, SD_N);
 
 	(void) sprintf(lm_header, "%8s", "size");
 
@@ -68,6 +80,12 @@ int
 benchmark_optswitch(int opt, char *optarg)
 {
 	switch (opt) {
+	case 'd':
+		optd = optarg;
+		break;
+	case 'g':
+		optg = optarg;
+		break;
 	case 'n':
 		unaligned = 1;
 		break;
@@ -80,6 +98,17 @@ benchmark_optswitch(int opt, char *optarg)
 	return (0);
 }
 
+int
+benchmark_initrun()
+{
+	dist = optd != NULL || optg != NULL;
+	if (dist && sizedist_init(&sd, optd, opts, optg, unaligned) == -1) {
+		return (-1);
+	}
+
+	return (0);
+}
+
 int
 benchmark_initbatch(void *tsd)
 {
@@ -87,6 +116,14 @@ benchmark_initbatch(void *tsd)
 	static char		*demo =
 	    "The quick brown fox jumps over the lazy dog.";
 
+	if (ts->ts_once == 0 && dist) {
+		ts->ts_once++;
+		ts->ts_as = sizedist_strings(&sd);
+		ts->ts_bs = sizedist_strings(&sd);
+		if (ts->ts_as == NULL || ts->ts_bs == NULL)
+			return (1);
+	}
+
 	if (ts->ts_once++ == 0) {
 		int l = strlen(demo);
 		int i;
@@ -112,9 +149,19 @@ benchmark(void *tsd, result_t *res)
 	int			*sum = &ts->ts_fakegcc;
 	char			*src = ts->ts_a;
 	char			*src2 = ts->ts_b;
+	int			k;
 
 	res->re_errors = 0;
 
+	if (dist) {
+		for (i = 0; i < lm_optB; i++) {
+			k = ts->ts_next++ & (SD_N - 1);
+			*sum += strcmp(ts->ts_as[k], ts->ts_bs[k]);
+		}
+		res->re_count = i;
+		return (0);
+	}
+
 	for (i = 0; i < lm_optB; i += 10) {
 		*sum += strcmp(src, src2);
 		*sum += strcmp(src, src2);
@@ -138,7 +185,11 @@ benchmark_result()
 {
 	static char	result[256];
 
-	if (unaligned == 0)
+	if (dist)
+		(void) sprintf(result, "%8.0f <%s%s%s>", sd.sd_mean,
+		    optd ? optd : "fixed", optg ? ", align " : "",
+		    optg ? optg : "");
+	else if (unaligned == 0)
 		(void) sprintf(result, "%8d", opts);
 	else
 		(void) sprintf(result, "%8d <unaligned>", opts);
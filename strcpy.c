@@ -34,14 +34,21 @@
 #include <string.h>
 
 #include "libmicro.h"
+#include "sizedist.h"
 
 static int unaligned = 0;
 static int opts = 100;
+static char *optd = NULL;
+static char *optg = NULL;
+static int dist;
+static sizedist_t sd;
 
 typedef struct {
 	int	ts_once;
 	char 	*ts_a;
 	char 	*ts_b;
+	char	**ts_bs;
+	int	ts_next;
 } tsd_t;
 
 int
@@ -50,13 +57,17 @@ benchmark_init()
 
 	lm_tsdsize = sizeof (tsd_t);
 
-	(void) sprintf(lm_optstr, "s:n");
+	(void) sprintf(lm_optstr, "d:g:s:n");
 
 	(void) sprintf(lm_usage,
 	    "       [-s string size (default %d)]\n"
 	    "       [-n causes unaligned cmp]\n"
-	    "notes: measures strcpy()\n",
-	    opts);
+	    "       [-d dist (draw string sizes from dist instead of -s)]\n"
+	    "       [-g dist (draw alignments from dist instead of -n)]\n"
+	    SD_USAGE
+	    "notes: measures strcpy(); with -d or -g the calls cycle\n"
+	    "       through %d draws and size is their mean\n",
+	    opts, SD_N);
 
 	(void) sprintf(lm_header, "%8s", "size");
 
@@ -67,6 +78,12 @@ int
 benchmark_optswitch(int opt, char *optarg)
 {
 	switch (opt) {
+	case 'd':
+		optd = optarg;
+		break;
+	case 'g':
+		optg = optarg;
+		break;
 	case 'n':
 		unaligned = 1;
 		break;
@@ -79,6 +96,17 @@ benchmark_optswitch(int opt, char *optarg)
 	return (0);
 }
 
+int
+benchmark_initrun()
+{
+	dist = optd != NULL || optg != NULL;
+	if (dist && sizedist_init(&sd, optd, opts, optg, unaligned) == -1) {
+		return (-1);
+	}
+
+	return (0);
+}
+
 int
 benchmark_initbatch(void *tsd)
 {
@@ -86,6 +114,14 @@ benchmark_initbatch(void *tsd)
 	static char		*demo =
 	    "The quick brown fox jumps over the lazy dog.";
 
+	if (ts->ts_once == 0 && dist) {
+		ts->ts_once++;
+		ts->ts_a = malloc(sd.sd_maxsize + 1);
+		ts->ts_bs = sizedist_strings(&sd);
+		if (ts->ts_a == NULL || ts->ts_bs == NULL)
+			return (1);
+	}
+
 	if (ts->ts_once++ == 0) {
 		int l = strlen(demo);
 		int i;
@@ -110,9 +146,18 @@ benchmark(void *tsd, result_t *res)
 
 	char *src = ts->ts_a;
 	char *src2 = ts->ts_b;
+	char **srcs = ts->ts_bs;
 
 	res->re_errors = 0;
 
+	if (dist) {
+		for (i = 0; i < lm_optB; i++) {
+			(void) strcpy(src, srcs[ts->ts_next++ & (SD_N - 1)]);
+		}
+		res->re_count = i;
+		return (0);
+	}
+
 	for (i = 0; i < lm_optB; i += 10) {
 		(void) strcpy(src, src2);
 		(void) strcpy(src, src2);
@@ -136,7 +181,11 @@ benchmark_result()
 {
 	static char  result[256];
 
-	if (unaligned == 0)
+	if (dist)
+		(void) sprintf(result, "%8.0f <%s%s%s>", sd.sd_mean,
+		    optd ? optd : "fixed", optg ? ", align " : "",
+		    optg ? optg : "");
+	else if (unaligned == 0)
 		(void) sprintf(result, "%8d", opts);
 	else
 		(void) sprintf(result, "%8d <unaligned>", opts);
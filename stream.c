@@ -0,0 +1,508 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * sustained memory bandwidth, STREAM style: every -P/-T worker is
+ * pinned to a cpu of its own and runs a kernel over arrays of its
+ * own, which it touches first so they come from its own node.  The
+ * kernels are scalar C or, on x86, SSE2, AVX2 or AVX-512 picked by
+ * cpuid at run time, with ordinary or non-temporal stores; Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define	X86
+#include <immintrin.h>
+#endif
+
+#include "libmicro.h"
+
+#define	MAXCPU			1024
+#define	DEFS			(32 * 1024 * 1024)
+#define	SKEW			(4096 + 64)	/* between the arrays */
+#define	SCALAR			3.0
+
+static char			*kernels[] = {
+	"copy", "scale", "add", "triad", "read", "write", NULL
+};
+#define	K_COPY			0	/* c = a */
+#define	K_SCALE			1	/* b = s * c */
+#define	K_ADD			2	/* c = a + b */
+#define	K_TRIAD			3	/* a = b + s * c */
+#define	K_READ			4	/* sum += a */
+#define	K_WRITE			5	/* a = s */
+
+/* bytes each kernel reads and writes per element, as STREAM counts */
+static int			bytes[] = {
+	16, 16, 24, 24, 8, 8
+};
+
+typedef double (*kern_t)(double *, double *, double *, long);
+
+static double			kern_scalar(double *, double *, double *, long);
+#ifdef X86
+static double			kern_sse2(double *, double *, double *, long);
+static double			kern_avx2(double *, double *, double *, long);
+static double			kern_avx512(double *, double *, double *, long);
+#endif
+
+typedef struct {
+	char			*is_name;
+	kern_t			is_kern;
+} isa_t;
+
+static isa_t			isas[] = {
+	{ "scalar",	kern_scalar },
+#ifdef X86
+	{ "sse2",	kern_sse2 },
+	{ "avx2",	kern_avx2 },
+	{ "avx512",	kern_avx512 },
+#endif
+	{ NULL,		NULL }
+};
+
+typedef struct {
+	char			*ts_map;
+	size_t			ts_maplen;
+	double			*ts_a;
+	double			*ts_b;
+	double			*ts_c;
+	double			ts_sum;
+	long long		ts_bytes;
+	long long		ts_nsecs;
+	span_t			ts_batch;	/* this batch */
+	long long		ts_span;	/* of all batches */
+} tsd_t;
+
+static char			*optc = NULL;
+static char			*opti = NULL;
+static int			optn = 0;
+static long long		opts = DEFS;
+static int			optx = K_TRIAD;
+static isa_t			*isa;
+static long			nelem;
+static int			cpus[MAXCPU];
+static int			ncpu;
+
+int
+benchmark_init()
+{
+	lm_tsdsize = sizeof (tsd_t);
+
+	lm_defB = 1;
+
+	(void) sprintf(lm_optstr, "c:i:ns:x:");
+
+	(void) sprintf(lm_usage,
+	    "       [-c cpulist to pin the workers to, in order "
+	    "(default all we may use)]\n"
+	    "       [-i scalar|sse2|avx2|avx512 (default the widest "
+	    "the cpu has)]\n"
+	    "       [-n] (non-temporal stores)\n"
+	    "       [-s bytes per array (default %dm)]\n"
+	    "       [-x copy|scale|add|triad|read|write (default triad)]\n"
+	    "notes: measures memory bandwidth; an op is one pass over a\n"
+	    "       worker's arrays; GB/s is all workers together over the\n"
+	    "       span of each batch, min and max single workers; the\n"
+	    "       reads a write-allocate adds aren't counted\n",
+	    DEFS / (1024 * 1024));
+
+	(void) sprintf(lm_header, "%6s %6s %2s %4s %8s %8s %8s %8s",
+	    "kernel", "isa", "nt", "thr", "size", "GB/s", "thr-min",
+	    "thr-max");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	int			i;
+
+	switch (opt) {
+	case 'c':
+		optc = optarg;
+		break;
+	case 'i':
+		opti = optarg;
+		break;
+	case 'n':
+		optn = 1;
+		break;
+	case 's':
+		opts = sizetoll(optarg);
+		break;
+	case 'x':
+		for (i = 0; kernels[i] != NULL; i++) {
+			if (strcmp(optarg, kernels[i]) == 0) {
+				break;
+			}
+		}
+		if (kernels[i] == NULL) {
+			return (-1);
+		}
+		optx = i;
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * whether this cpu, and the kernel, will run an isa's instructions
+ */
+static int
+supported(isa_t *ip)
+{
+#ifdef X86
+	__builtin_cpu_init();
+
+	if (ip->is_kern == kern_sse2) {
+		return (__builtin_cpu_supports("sse2"));
+	}
+	if (ip->is_kern == kern_avx2) {
+		return (__builtin_cpu_supports("avx2"));
+	}
+	if (ip->is_kern == kern_avx512) {
+		return (__builtin_cpu_supports("avx512f"));
+	}
+#endif
+
+	return (1);
+}
+
+int
+benchmark_initrun()
+{
+	cpu_set_t		set;
+	isa_t			*ip;
+	int			i;
+
+	if (opti == NULL) {
+		for (ip = isas; ip->is_name != NULL; ip++) {
+			if (supported(ip)) {
+				isa = ip;
+			}
+		}
+	} else {
+		for (ip = isas; ip->is_name != NULL; ip++) {
+			if (strcmp(opti, ip->is_name) == 0) {
+				break;
+			}
+		}
+		if (ip->is_name == NULL || !supported(ip)) {
+			(void) printf("ERROR: this cpu can't run -i %s\n",
+			    opti);
+			return (-1);
+		}
+		isa = ip;
+	}
+	if (optn && isa->is_kern == kern_scalar) {
+		(void) printf("ERROR: -n needs a SIMD -i\n");
+		return (-1);
+	}
+
+	/* so that four of the widest vectors divide it */
+	nelem = opts / sizeof (double) & ~31L;
+	if (nelem == 0) {
+		(void) printf("ERROR: -s must be at least 256 bytes\n");
+		return (-1);
+	}
+
+	if (optc != NULL) {
+		ncpu = cpulist(optc, cpus, MAXCPU);
+	} else {
+		if (sched_getaffinity(0, sizeof (set), &set) < 0) {
+			perror("sched_getaffinity");
+			return (-1);
+		}
+		for (ncpu = 0, i = 0; i < CPU_SETSIZE && ncpu < MAXCPU; i++) {
+			if (CPU_ISSET(i, &set)) {
+				cpus[ncpu++] = i;
+			}
+		}
+	}
+	if (ncpu == 0) {
+		(void) printf("ERROR: no cpus to run on\n");
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*
+ * pin first and then touch the arrays, so that first touch puts
+ * their pages on this cpu's node
+ */
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	cpu_set_t		set;
+	size_t			len = nelem * sizeof (double) + SKEW;
+	long			i;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpus[(getpindex() * lm_optT + gettindex()) % ncpu], &set);
+	if (sched_setaffinity(0, sizeof (set), &set) < 0) {
+		perror("sched_setaffinity");
+		return (1);
+	}
+
+	ts->ts_maplen = 3 * len;
+	/*LINTED*/
+	ts->ts_map = (char *)mmap(NULL, ts->ts_maplen,
+	    PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0L);
+	if (ts->ts_map == MAP_FAILED) {
+		perror("mmap");
+		return (1);
+	}
+
+	/*LINTED*/
+	ts->ts_a = (double *)ts->ts_map;
+	/*LINTED*/
+	ts->ts_b = (double *)(ts->ts_map + len);
+	/*LINTED*/
+	ts->ts_c = (double *)(ts->ts_map + 2 * len);
+
+	for (i = 0; i < nelem; i++) {
+		ts->ts_a[i] = 1.0;
+		ts->ts_b[i] = 2.0;
+		ts->ts_c[i] = 0.0;
+	}
+
+	return (0);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	int			i;
+
+	for (i = 0; i < lm_optB; i++) {
+		ts->ts_sum += isa->is_kern(ts->ts_a, ts->ts_b, ts->ts_c,
+		    nelem);
+	}
+	res->re_count = i;
+
+	ts->ts_bytes += (long long)i * nelem * bytes[optx];
+	ts->ts_nsecs += span_stamp(&ts->ts_batch, res);
+
+	return (0);
+}
+
+int
+benchmark_finibatch(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	ts->ts_span += span_batch(offsetof(tsd_t, ts_batch));
+
+	return (0);
+}
+
+int
+benchmark_finiworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	(void) munmap(ts->ts_map, ts->ts_maplen);
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	tsd_t			*ts;
+	long long		total = 0;
+	double			rate, lo = 0.0, hi = 0.0;
+	int			p, t;
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			total += ts->ts_bytes;
+			rate = ts->ts_nsecs ?
+			    (double)ts->ts_bytes / ts->ts_nsecs : 0.0;
+			if ((p == 0 && t == 0) || rate < lo) {
+				lo = rate;
+			}
+			if (rate > hi) {
+				hi = rate;
+			}
+		}
+	}
+
+	ts = (tsd_t *)gettsd(0, 0);
+	(void) sprintf(result, "%6s %6s %2s %4d %7lldk %8.2f %8.2f %8.2f",
+	    kernels[optx], isa->is_name, optn ? "y" : "n",
+	    lm_optP * lm_optT, opts / 1024,
+	    ts->ts_span ? (double)total / ts->ts_span : 0.0, lo, hi);
+
+	return (result);
+}
+
+static double
+kern_scalar(double *a, double *b, double *c, long n)
+{
+	double			s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+	long			i;
+
+	switch (optx) {
+	case K_COPY:
+		for (i = 0; i < n; i++) {
+			c[i] = a[i];
+		}
+		break;
+	case K_SCALE:
+		for (i = 0; i < n; i++) {
+			b[i] = SCALAR * c[i];
+		}
+		break;
+	case K_ADD:
+		for (i = 0; i < n; i++) {
+			c[i] = a[i] + b[i];
+		}
+		break;
+	case K_TRIAD:
+		for (i = 0; i < n; i++) {
+			a[i] = b[i] + SCALAR * c[i];
+		}
+		break;
+	case K_READ:
+		for (i = 0; i < n; i += 4) {
+			s0 += a[i];
+			s1 += a[i + 1];
+			s2 += a[i + 2];
+			s3 += a[i + 3];
+		}
+		break;
+	case K_WRITE:
+		for (i = 0; i < n; i++) {
+			a[i] = SCALAR;
+		}
+		break;
+	}
+
+	return (s0 + s1 + s2 + s3);
+}
+
+#ifdef X86
+
+/*
+ * the SIMD kernels differ only in the width of the vector and the
+ * prefix of the intrinsics: _mm_, _mm256_ or _mm512_.  Each is
+ * compiled for its own isa, so the rest of the file needn't be.
+ * read keeps four sums, so it waits on the loads and not the adds
+ */
+#define	ST(pfx, p, v)	(optn ? _mm##pfx##_stream_pd(p, v) :		\
+			    _mm##pfx##_store_pd(p, v))
+#define	LD(pfx, p)	_mm##pfx##_load_pd(p)
+
+#define	KERN(fn, tgt, vec, pfx, w)					\
+__attribute__((target(tgt))) static double				\
+fn(double *a, double *b, double *c, long n)				\
+{									\
+	vec			s = _mm##pfx##_set1_pd(SCALAR);		\
+	vec			s0 = _mm##pfx##_setzero_pd();		\
+	vec			s1 = s0, s2 = s0, s3 = s0;		\
+	double			r[w];					\
+	double			t = 0.0;				\
+	long			i;					\
+									\
+	switch (optx) {							\
+	case K_COPY:							\
+		for (i = 0; i < n; i += w) {				\
+			ST(pfx, c + i, LD(pfx, a + i));			\
+		}							\
+		break;							\
+	case K_SCALE:							\
+		for (i = 0; i < n; i += w) {				\
+			ST(pfx, b + i,					\
+			    _mm##pfx##_mul_pd(s, LD(pfx, c + i)));	\
+		}							\
+		break;							\
+	case K_ADD:							\
+		for (i = 0; i < n; i += w) {				\
+			ST(pfx, c + i, _mm##pfx##_add_pd(LD(pfx, a + i), \
+			    LD(pfx, b + i)));				\
+		}							\
+		break;							\
+	case K_TRIAD:							\
+		for (i = 0; i < n; i += w) {				\
+			ST(pfx, a + i, _mm##pfx##_add_pd(LD(pfx, b + i), \
+			    _mm##pfx##_mul_pd(s, LD(pfx, c + i))));	\
+		}							\
+		break;							\
+	case K_READ:							\
+		for (i = 0; i < n; i += 4 * w) {			\
+			s0 = _mm##pfx##_add_pd(s0, LD(pfx, a + i));	\
+			s1 = _mm##pfx##_add_pd(s1, LD(pfx, a + i + w));	\
+			s2 = _mm##pfx##_add_pd(s2,			\
+			    LD(pfx, a + i + 2 * w));			\
+			s3 = _mm##pfx##_add_pd(s3,			\
+			    LD(pfx, a + i + 3 * w));			\
+		}							\
+		break;							\
+	case K_WRITE:							\
+		for (i = 0; i < n; i += w) {				\
+			ST(pfx, a + i, s);				\
+		}							\
+		break;							\
+	}								\
+									\
+	if (optn) {							\
+		_mm_sfence();						\
+	}								\
+									\
+	s0 = _mm##pfx##_add_pd(_mm##pfx##_add_pd(s0, s1),		\
+	    _mm##pfx##_add_pd(s2, s3));					\
+	_mm##pfx##_storeu_pd(r, s0);					\
+	for (i = 0; i < w; i++) {					\
+		t += r[i];						\
+	}								\
+									\
+	return (t);							\
+}
+
+KERN(kern_sse2, "sse2", __m128d, , 2)
+KERN(kern_avx2, "avx2", __m256d, 256, 4)
+KERN(kern_avx512, "avx512f", __m512d, 512, 8)
+
+#endif
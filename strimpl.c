@@ -0,0 +1,358 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+
+/*
+ * the string and search routines done with SSE2 or AVX2 vectors, for
+ * strsearch to measure beside libc's.  Loads that might run past the
+ * end of what the caller handed us are aligned, so they never cross
+ * into a page it didn't; the others stop a vector short and finish a
+ * byte at a time.  strspn and strcspn compare against each character
+ * of sets of up to a vector's worth, and leave longer sets to libc
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define	X86
+#include <immintrin.h>
+#endif
+
+#include "libmicro.h"
+#include "strimpl.h"
+
+#ifdef X86
+
+#define	LD(pfx, si, p)		_mm##pfx##_load_##si((void *)(p))
+#define	LDU(pfx, si, p)		_mm##pfx##_loadu_##si((void *)(p))
+#define	EQ(pfx, a, b)		_mm##pfx##_cmpeq_epi8(a, b)
+#define	MASK(pfx, v)		((unsigned int)_mm##pfx##_movemask_epi8(v))
+#define	FIRST(m)		__builtin_ctz(m)
+#define	LAST(m)			(31 - __builtin_clz(m))
+#define	ALIGN(p, w)		((const unsigned char *)((unsigned long)(p) & \
+				    ~(unsigned long)((w) - 1)))
+
+/*
+ * as with memimpl.c, one definition for both widths; all = the mask
+ * with a bit for every byte of a vector
+ */
+#define	STRING(nm, tgt, vec, pfx, si, w, all)				\
+__attribute__((target(tgt))) static void *				\
+nm##_memchr(const void *s, int c, size_t n)				\
+{									\
+	const unsigned char	*p = s;					\
+	vec			v = _mm##pfx##_set1_epi8((char)c);	\
+	unsigned int		m;					\
+	size_t			i;					\
+									\
+	for (i = 0; i + w <= n; i += w) {				\
+		if ((m = MASK(pfx, EQ(pfx, LDU(pfx, si, p + i), v)))) {	\
+			return ((void *)(p + i + FIRST(m)));		\
+		}							\
+	}								\
+	for (; i < n; i++) {						\
+		if (p[i] == (unsigned char)c) {				\
+			return ((void *)(p + i));			\
+		}							\
+	}								\
+									\
+	return (NULL);							\
+}									\
+									\
+__attribute__((target(tgt))) static void *				\
+nm##_memrchr(const void *s, int c, size_t n)				\
+{									\
+	const unsigned char	*p = s;					\
+	vec			v = _mm##pfx##_set1_epi8((char)c);	\
+	unsigned int		m;					\
+	size_t			i = n;					\
+									\
+	while (i >= w) {						\
+		i -= w;							\
+		if ((m = MASK(pfx, EQ(pfx, LDU(pfx, si, p + i), v)))) {	\
+			return ((void *)(p + i + LAST(m)));		\
+		}							\
+	}								\
+	while (i-- > 0) {						\
+		if (p[i] == (unsigned char)c) {				\
+			return ((void *)(p + i));			\
+		}							\
+	}								\
+									\
+	return (NULL);							\
+}									\
+									\
+__attribute__((target(tgt))) static void *				\
+nm##_rawmemchr(const void *s, int c)					\
+{									\
+	const unsigned char	*p = s;					\
+	const unsigned char	*a = ALIGN(p, w);			\
+	vec			v = _mm##pfx##_set1_epi8((char)c);	\
+	unsigned int		m;					\
+									\
+	if ((m = MASK(pfx, EQ(pfx, LD(pfx, si, a), v)) >> (p - a))) {	\
+		return ((void *)(p + FIRST(m)));			\
+	}								\
+	for (a += w; ; a += w) {					\
+		if ((m = MASK(pfx, EQ(pfx, LD(pfx, si, a), v)))) {	\
+			return ((void *)(a + FIRST(m)));		\
+		}							\
+	}								\
+}									\
+									\
+__attribute__((target(tgt))) static int					\
+nm##_memcmp(const void *s1, const void *s2, size_t n)			\
+{									\
+	const unsigned char	*a = s1;				\
+	const unsigned char	*b = s2;				\
+	unsigned int		m;					\
+	size_t			i;					\
+									\
+	for (i = 0; i + w <= n; i += w) {				\
+		m = MASK(pfx, EQ(pfx, LDU(pfx, si, a + i),		\
+		    LDU(pfx, si, b + i)));				\
+		if (m != (all)) {					\
+			i += FIRST(~m);					\
+			return (a[i] - b[i]);				\
+		}							\
+	}								\
+	for (; i < n; i++) {						\
+		if (a[i] != b[i]) {					\
+			return (a[i] - b[i]);				\
+		}							\
+	}								\
+									\
+	return (0);							\
+}									\
+									\
+__attribute__((target(tgt))) static size_t				\
+nm##_strnlen(const char *s, size_t max)					\
+{									\
+	const unsigned char	*p = (const unsigned char *)s;		\
+	const unsigned char	*a = ALIGN(p, w);			\
+	vec			z = _mm##pfx##_setzero_##si();		\
+	unsigned int		m;					\
+	size_t			len;					\
+									\
+	m = MASK(pfx, EQ(pfx, LD(pfx, si, a), z)) >> (p - a);		\
+	for (len = 0; m == 0; ) {					\
+		a += w;							\
+		if ((len = a - p) >= max) {				\
+			return (max);					\
+		}							\
+		m = MASK(pfx, EQ(pfx, LD(pfx, si, a), z));		\
+	}								\
+	len += FIRST(m);						\
+									\
+	return (len < max ? len : max);					\
+}									\
+									\
+/*								\
+ * candidates are where both the first and the last byte of the	\
+ * needle match, and only they are compared in full		\
+ */								\
+__attribute__((target(tgt))) static void *				\
+nm##_memmem(const void *hs, size_t hn, const void *ns, size_t nn)	\
+{									\
+	const unsigned char	*h = hs;				\
+	const unsigned char	*nd = ns;				\
+	vec			f, l;					\
+	unsigned int		m;					\
+	size_t			i;					\
+									\
+	if (nn == 0) {							\
+		return ((void *)h);					\
+	}								\
+	if (nn > hn) {							\
+		return (NULL);						\
+	}								\
+	if (nn == 1) {							\
+		return (nm##_memchr(h, nd[0], hn));			\
+	}								\
+									\
+	f = _mm##pfx##_set1_epi8((char)nd[0]);				\
+	l = _mm##pfx##_set1_epi8((char)nd[nn - 1]);			\
+	for (i = 0; i + nn - 1 + w <= hn; i += w) {			\
+		m = MASK(pfx, _mm##pfx##_and_##si(			\
+		    EQ(pfx, LDU(pfx, si, h + i), f),			\
+		    EQ(pfx, LDU(pfx, si, h + i + nn - 1), l)));		\
+		for (; m != 0; m &= m - 1) {				\
+			if (memcmp(h + i + FIRST(m) + 1, nd + 1,	\
+			    nn - 2) == 0) {				\
+				return ((void *)(h + i + FIRST(m)));	\
+			}						\
+		}							\
+	}								\
+	for (; i + nn <= hn; i++) {					\
+		if (h[i] == nd[0] && memcmp(h + i, nd, nn) == 0) {	\
+			return ((void *)(h + i));			\
+		}							\
+	}								\
+									\
+	return (NULL);							\
+}									\
+									\
+__attribute__((target(tgt))) static char *				\
+nm##_strstr(const char *h, const char *nd)				\
+{									\
+	const char		*end = nm##_rawmemchr(h, '\0');		\
+									\
+	return (nm##_memmem(h, end - h, nd, strlen(nd)));		\
+}									\
+									\
+/*								\
+ * the first byte of s out of the set, or for cspn in it or the	\
+ * terminating nul						\
+ */								\
+__attribute__((target(tgt))) static size_t				\
+nm##_span(const char *s, const char *set, int cspn)			\
+{									\
+	const unsigned char	*p = (const unsigned char *)s;		\
+	const unsigned char	*a = ALIGN(p, w);			\
+	vec			sv[w];					\
+	vec			x, in;					\
+	unsigned int		m;					\
+	int			k = strlen(set);			\
+	int			j, first = 1;				\
+									\
+	for (j = 0; j < k; j++) {					\
+		sv[j] = _mm##pfx##_set1_epi8(set[j]);			\
+	}								\
+									\
+	for (;; a += w, first = 0) {					\
+		x = LD(pfx, si, a);					\
+		in = cspn ? EQ(pfx, x, _mm##pfx##_setzero_##si()) :	\
+		    _mm##pfx##_setzero_##si();				\
+		for (j = 0; j < k; j++) {				\
+			in = _mm##pfx##_or_##si(in, EQ(pfx, x, sv[j]));	\
+		}							\
+		m = MASK(pfx, in);					\
+		if (!cspn) {						\
+			m = ~m & (all);					\
+		}							\
+		if (first) {						\
+			m >>= p - a;					\
+			if (m) {					\
+				return (FIRST(m));			\
+			}						\
+		} else if (m) {						\
+			return (a - p + FIRST(m));			\
+		}							\
+	}								\
+}									\
+									\
+static size_t								\
+nm##_strspn(const char *s, const char *set)				\
+{									\
+	if (strlen(set) > w) {						\
+		return (strspn(s, set));				\
+	}								\
+	return (nm##_span(s, set, 0));					\
+}									\
+									\
+static size_t								\
+nm##_strcspn(const char *s, const char *set)				\
+{									\
+	if (strlen(set) > w) {						\
+		return (strcspn(s, set));				\
+	}								\
+	return (nm##_span(s, set, 1));					\
+}									\
+									\
+static char *								\
+nm##_strtok_r(char *s, const char *delim, char **last)			\
+{									\
+	char			*e;					\
+									\
+	if (s == NULL) {						\
+		s = *last;						\
+	}								\
+	s += nm##_strspn(s, delim);					\
+	if (*s == '\0') {						\
+		*last = s;						\
+		return (NULL);						\
+	}								\
+	e = s + nm##_strcspn(s, delim);					\
+	if (*e != '\0') {						\
+		*e++ = '\0';						\
+	}								\
+	*last = e;							\
+									\
+	return (s);							\
+}
+
+STRING(sse2, "sse2", __m128i, , si128, 16, 0xffff)
+STRING(avx2, "avx2", __m256i, 256, si256, 32, 0xffffffff)
+
+#endif
+
+strimpl_t			strimpls[] = {
+	{ "libc", memchr, memrchr, rawmemchr, memcmp, strnlen, strstr,
+	    memmem, strspn, strcspn, strtok_r },
+#ifdef X86
+	{ "sse2", sse2_memchr, sse2_memrchr, sse2_rawmemchr, sse2_memcmp,
+	    sse2_strnlen, sse2_strstr, sse2_memmem, sse2_strspn,
+	    sse2_strcspn, sse2_strtok_r },
+	{ "avx2", avx2_memchr, avx2_memrchr, avx2_rawmemchr, avx2_memcmp,
+	    avx2_strnlen, avx2_strstr, avx2_memmem, avx2_strspn,
+	    avx2_strcspn, avx2_strtok_r },
+#endif
+	{ NULL }
+};
+
+/*
+ * the implementations in a comma separated list, or all of them
+ * the cpu can run; -1 for one it doesn't know or can't run
+ */
+int
+strimpl_list(char *list, strimpl_t **impls)
+{
+	int			which[MAXSTRIMPLS];
+	int			n, i;
+
+	n = impl_list(list, strimpls, sizeof (strimpl_t), which, MAXSTRIMPLS);
+	for (i = 0; i < n; i++) {
+		impls[i] = &strimpls[which[i]];
+	}
+
+	return (n);
+}
+
+/*
+ * libc|sse2|avx2, for usage messages
+ */
+char *
+strimpl_names()
+{
+	static char		names[256];
+
+	return (impl_names(strimpls, sizeof (strimpl_t), names,
+	    sizeof (names)));
+}
@@ -0,0 +1,58 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+
+#ifndef STRIMPL_H
+#define	STRIMPL_H
+
+#include <sys/types.h>
+
+/*
+ * implementations of the string and search routines to set against
+ * libc's, for strsearch
+ */
+
+typedef struct {
+	char	*si_name;
+	void	*(*si_memchr)(const void *, int, size_t);
+	void	*(*si_memrchr)(const void *, int, size_t);
+	void	*(*si_rawmemchr)(const void *, int);
+	int	(*si_memcmp)(const void *, const void *, size_t);
+	size_t	(*si_strnlen)(const char *, size_t);
+	char	*(*si_strstr)(const char *, const char *);
+	void	*(*si_memmem)(const void *, size_t, const void *, size_t);
+	size_t	(*si_strspn)(const char *, const char *);
+	size_t	(*si_strcspn)(const char *, const char *);
+	char	*(*si_strtok_r)(char *, const char *, char **);
+} strimpl_t;
+
+#define	MAXSTRIMPLS		8
+
+extern strimpl_t		strimpls[];
+
+int	strimpl_list(char *list, strimpl_t **impls);
+char	*strimpl_names(void);
+
+#endif /* STRIMPL_H */
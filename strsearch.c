@@ -0,0 +1,587 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+
+/*
+ * string and search routines beyond the ones strlen, strchr, strcmp,
+ * strcpy and strcasecmp measure, libc's or the SSE2 and AVX2 ones of
+ * strimpl.c, with the match early, midway, late or nowhere in the
+ * buffer, and the buffer straddling a page boundary or flush against
+ * an unmapped page; Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libmicro.h"
+#include "strimpl.h"
+
+#define	DEFS			1024
+#define	MAXK			64
+#define	MAXSETK			16
+#define	MAXSWEEP		64
+#define	WORK			(4 * 1024 * 1024)	/* bytes per run */
+
+static char			*routines[] = {
+	"memchr", "memrchr", "rawmemchr", "memcmp", "strnlen", "strstr",
+	"memmem", "strspn", "strcspn", "strtok_r", NULL
+};
+#define	X_MEMCHR		0
+#define	X_MEMRCHR		1
+#define	X_RAWMEMCHR		2
+#define	X_MEMCMP		3
+#define	X_STRNLEN		4
+#define	X_STRSTR		5
+#define	X_MEMMEM		6
+#define	X_STRSPN		7
+#define	X_STRCSPN		8
+#define	X_STRTOK		9
+
+/* the length -k sets for each: a needle, a set or a token */
+static int			defk[] = {
+	0, 0, 0, 0, 0, 8, 8, 4, 4, 8
+};
+
+static char			*wheres[] = {
+	"early", "middle", "late", "none", NULL
+};
+#define	W_EARLY			0
+#define	W_MIDDLE		1
+#define	W_LATE			2
+#define	W_NONE			3
+
+#define	SPNSET			"abcdefghijklmnop"
+#define	CSPNSET			"#$%&*+/<=>@[]^_|"
+#define	DELIMS			" ,"
+
+static char			*demo =
+	"The quick brown fox jumps over the lazy dog.";
+
+typedef struct {
+	char			*ts_map;
+	size_t			ts_maplen;
+	char			*ts_map2;
+	size_t			ts_maplen2;
+	char			*ts_h;
+	char			*ts_h2;		/* for memcmp */
+	long			ts_fake;
+} tsd_t;
+
+static int			opte = 0;
+static char			*opti = "libc";
+static int			optk = -1;
+static char			*optl = NULL;
+static char			*optm = NULL;
+static int			optp = 0;
+static long long		opts = DEFS;
+static int			optx = X_MEMCHR;
+static strimpl_t		*impls[MAXSTRIMPLS];
+static int			nimpls;
+static int			where[8];
+static int			nwhere;
+static char			arg[MAXK + 1];	/* needle or set */
+static long			pagesize;
+static volatile long		sink;		/* keeps the sweep's calls */
+
+int
+benchmark_init()
+{
+	lm_tsdsize = sizeof (tsd_t);
+
+	(void) sprintf(lm_optstr, "ei:k:l:m:ps:x:");
+
+	(void) sprintf(lm_usage,
+	    "       [-e] (end the buffer against an unmapped page)\n"
+	    "       [-i %s|all, or a list (default libc)]\n"
+	    "       [-k needle, set or token length]\n"
+	    "       [-l size,size,... (sweep these sizes after the run)]\n"
+	    "       [-m early|middle|late|none, or a list (default none,\n"
+	    "           late for rawmemchr)]\n"
+	    "       [-p] (straddle a page boundary)\n"
+	    "       [-s buffer size (default %d)]\n"
+	    "       [-x memchr|memrchr|rawmemchr|memcmp|strnlen|strstr|\n"
+	    "           memmem|strspn|strcspn|strtok_r (default memchr)]\n"
+	    "notes: measures a string or search routine; -m places the\n"
+	    "       match, the first difference or the end in the order\n"
+	    "       the routine looks; strtok_r splits the whole buffer\n"
+	    "       into tokens.  With -l, -m or -i lists a size by match\n"
+	    "       by implementation table follows\n",
+	    strimpl_names(), DEFS);
+
+	(void) sprintf(lm_header, "%9s %5s %8s %6s", "routine", "impl",
+	    "size", "match");
+
+	return (0);
+}
+
+static int
+lookup(char *s, char **names)
+{
+	int			i;
+
+	for (i = 0; names[i] != NULL; i++) {
+		if (strcmp(s, names[i]) == 0) {
+			return (i);
+		}
+	}
+
+	return (-1);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	switch (opt) {
+	case 'e':
+		opte = 1;
+		break;
+	case 'i':
+		opti = optarg;
+		break;
+	case 'k':
+		optk = atoi(optarg);
+		break;
+	case 'l':
+		optl = optarg;
+		break;
+	case 'm':
+		optm = optarg;
+		break;
+	case 'p':
+		optp = 1;
+		break;
+	case 's':
+		opts = sizetoll(optarg);
+		break;
+	case 'x':
+		if ((optx = lookup(optarg, routines)) == -1) {
+			return (-1);
+		}
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+int
+benchmark_initrun()
+{
+	char			*copy, *tok, *last;
+	int			i;
+
+	pagesize = sysconf(_SC_PAGESIZE);
+
+	if ((nimpls = strimpl_list(opti, impls)) < 1) {
+		return (-1);
+	}
+
+	if (optm == NULL) {
+		optm = optx == X_RAWMEMCHR ? "late" : "none";
+	}
+	if ((copy = strdup(optm)) == NULL) {
+		return (-1);
+	}
+	for (nwhere = 0, tok = strtok_r(copy, ",", &last);
+	    tok != NULL && nwhere < 8; tok = strtok_r(NULL, ",", &last)) {
+		if ((where[nwhere++] = lookup(tok, wheres)) == -1) {
+			(void) printf("ERROR: -m %s is not a place\n", tok);
+			return (-1);
+		}
+		if (optx == X_RAWMEMCHR && where[nwhere - 1] == W_NONE) {
+			(void) printf("ERROR: rawmemchr must find a match\n");
+			return (-1);
+		}
+	}
+	free(copy);
+
+	if (opte && optp) {
+		(void) printf("ERROR: -e and -p can't both place it\n");
+		return (-1);
+	}
+
+	if (optk == -1) {
+		optk = defk[optx];
+	}
+	if (optk < 0 || optk > MAXK ||
+	    ((optx == X_STRSPN || optx == X_STRCSPN) && optk > MAXSETK) ||
+	    (optx == X_STRTOK && optk < 1)) {
+		(void) printf("ERROR: -k is out of range for %s\n",
+		    routines[optx]);
+		return (-1);
+	}
+	if (opts < optk + 2) {
+		(void) printf("ERROR: -s is too small\n");
+		return (-1);
+	}
+
+	/* a needle with demo's near misses, or a set */
+	switch (optx) {
+	case X_STRSTR:
+	case X_MEMMEM:
+		for (i = 0; i < optk; i++) {
+			arg[i] = demo[(4 + i) % strlen(demo)];
+		}
+		if (optk > 0) {
+			arg[optk - 1] = 'X';
+		}
+		break;
+	case X_STRSPN:
+		(void) strncpy(arg, SPNSET, optk);
+		break;
+	case X_STRCSPN:
+		(void) strncpy(arg, CSPNSET, optk);
+		break;
+	}
+
+	return (0);
+}
+
+/*
+ * a buffer of size bytes, at the start of its own mapping, across a
+ * page boundary with -p, or with -e ending where an unmapped page
+ * begins
+ */
+static char *
+place(size_t size, char **mapp, size_t *lenp)
+{
+	size_t			span, half = size / 2;
+	char			*map;
+
+	span = (size + pagesize - 1) & ~(pagesize - 1);
+	*lenp = span + 3 * pagesize;
+
+	/*LINTED*/
+	map = (char *)mmap(NULL, *lenp, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANON, -1, 0L);
+	if (map == MAP_FAILED) {
+		return (NULL);
+	}
+	*mapp = map;
+
+	if (opte) {
+		(void) mprotect(map + *lenp - pagesize, pagesize, PROT_NONE);
+		return (map + *lenp - pagesize - size);
+	}
+	if (optp) {
+		return (map + pagesize + ((half + pagesize - 1) &
+		    ~(pagesize - 1)) - half);
+	}
+
+	return (map);
+}
+
+/*
+ * where in the buffer the match goes, -1 for nowhere
+ */
+static long
+position(size_t size, int w)
+{
+	long			last;
+
+	switch (optx) {
+	case X_STRSPN:
+	case X_STRCSPN:
+		last = size - 2;
+		break;
+	case X_STRSTR:
+		last = size - 1 - optk;
+		break;
+	case X_MEMMEM:
+		last = size - optk;
+		break;
+	default:
+		last = size - 1;
+		break;
+	}
+
+	switch (w) {
+	case W_EARLY:
+		return (last / 16);
+	case W_MIDDLE:
+		return (last / 2);
+	case W_LATE:
+		return (last);
+	}
+
+	return (-1);
+}
+
+static void
+fill(char *h, char *h2, size_t size, int w)
+{
+	long			pos = position(size, w);
+	size_t			i;
+	int			l = strlen(demo);
+
+	for (i = 0; i < size; i++) {
+		switch (optx) {
+		case X_STRSPN:
+			h[i] = SPNSET[i % optk];
+			break;
+		case X_STRTOK:
+			h[i] = i % (optk + 1) == optk ? ' ' : demo[i % l];
+			break;
+		default:
+			h[i] = demo[i % l];
+			break;
+		}
+	}
+	if (optx != X_MEMCHR && optx != X_MEMRCHR && optx != X_MEMCMP &&
+	    optx != X_MEMMEM && optx != X_RAWMEMCHR && optx != X_STRNLEN) {
+		h[size - 1] = '\0';
+	}
+	if (optx == X_MEMCMP) {
+		(void) memcpy(h2, h, size);
+	}
+
+	if (pos == -1 || optx == X_STRTOK) {
+		return;
+	}
+
+	switch (optx) {
+	case X_MEMCHR:
+	case X_RAWMEMCHR:
+		h[pos] = 'X';
+		break;
+	case X_MEMRCHR:
+		h[size - 1 - pos] = 'X';
+		break;
+	case X_MEMCMP:
+		h2[pos] = 'X';
+		break;
+	case X_STRNLEN:
+		h[pos] = '\0';
+		break;
+	case X_STRSTR:
+	case X_MEMMEM:
+		(void) memcpy(h + pos, arg, optk);
+		break;
+	case X_STRSPN:
+		h[pos] = 'X';
+		break;
+	case X_STRCSPN:
+		h[pos] = arg[0];
+		break;
+	}
+}
+
+/*
+ * one call, or for strtok_r one pass over the buffer, after which
+ * the delimiters it overwrote are put back
+ */
+static long
+call(strimpl_t *si, char *h, char *h2, size_t size)
+{
+	char			*t, *last;
+	long			r = 0;
+	size_t			i;
+
+	switch (optx) {
+	case X_MEMCHR:
+		return ((long)si->si_memchr(h, 'X', size));
+	case X_MEMRCHR:
+		return ((long)si->si_memrchr(h, 'X', size));
+	case X_RAWMEMCHR:
+		return ((long)si->si_rawmemchr(h, 'X'));
+	case X_MEMCMP:
+		return (si->si_memcmp(h, h2, size));
+	case X_STRNLEN:
+		return (si->si_strnlen(h, size));
+	case X_STRSTR:
+		return ((long)si->si_strstr(h, arg));
+	case X_MEMMEM:
+		return ((long)si->si_memmem(h, size, arg, optk));
+	case X_STRSPN:
+		return (si->si_strspn(h, arg));
+	case X_STRCSPN:
+		return (si->si_strcspn(h, arg));
+	case X_STRTOK:
+		for (t = si->si_strtok_r(h, DELIMS, &last); t != NULL;
+		    t = si->si_strtok_r(NULL, DELIMS, &last)) {
+			r++;
+		}
+		for (i = optk; i < size - 1; i += optk + 1) {
+			h[i] = ' ';
+		}
+		return (r);
+	}
+
+	return (0);
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	ts->ts_h = place(opts, &ts->ts_map, &ts->ts_maplen);
+	ts->ts_h2 = place(opts, &ts->ts_map2, &ts->ts_maplen2);
+	if (ts->ts_h == NULL || ts->ts_h2 == NULL) {
+		return (1);
+	}
+
+	fill(ts->ts_h, ts->ts_h2, opts, where[0]);
+
+	return (0);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	strimpl_t		*si = impls[0];
+	int			i;
+
+	for (i = 0; i < lm_optB; i++) {
+		ts->ts_fake += call(si, ts->ts_h, ts->ts_h2, opts);
+	}
+	res->re_count = i;
+
+	return (0);
+}
+
+int
+benchmark_finiworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	(void) munmap(ts->ts_map, ts->ts_maplen);
+	(void) munmap(ts->ts_map2, ts->ts_maplen2);
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+
+	(void) sprintf(result, "%9s %5s %8lld %6s%s",
+	    routines[optx], impls[0]->si_name, opts,
+	    optx == X_STRTOK ? "-" : wheres[where[0]],
+	    opte ? " <guard>" : optp ? " <page>" : "");
+
+	return (result);
+}
+
+/*
+ * nsecs per call at one size and match, the best of three runs
+ * after one to warm up
+ */
+static double
+measure(strimpl_t *si, char *h, char *h2, size_t size)
+{
+	long long		t0, best = 0;
+	long			calls = WORK / (size + 64) + 8;
+	long			i;
+	int			run;
+
+	for (run = 0; run < 4; run++) {
+		t0 = getnsecs();
+		for (i = 0; i < calls; i++) {
+			sink += call(si, h, h2, size);
+		}
+		t0 = getnsecs() - t0;
+		if (run == 1 || (run > 1 && t0 < best)) {
+			best = t0;
+		}
+	}
+
+	return ((double)best / calls);
+}
+
+/*
+ * a table of nsecs per call, a row for each size and match and a
+ * column for each implementation
+ */
+static void
+sweep()
+{
+	long long		sizes[MAXSWEEP];
+	char			*copy, *tok, *last;
+	char			*map, *map2, *h, *h2;
+	size_t			len, len2;
+	int			nsizes = 0;
+	int			i, j, k;
+
+	if (optl == NULL) {
+		sizes[nsizes++] = opts;
+	} else if ((copy = strdup(optl)) != NULL) {
+		for (tok = strtok_r(copy, ",", &last);
+		    tok != NULL && nsizes < MAXSWEEP;
+		    tok = strtok_r(NULL, ",", &last)) {
+			if ((sizes[nsizes] = sizetoll(tok)) >= optk + 2) {
+				nsizes++;
+			}
+		}
+		free(copy);
+	}
+
+	(void) printf("#\n# %s sweep, nsecs per call%s\n#\n# %8s %6s",
+	    routines[optx], opte ? ", against an unmapped page" :
+	    optp ? ", across a page boundary" : "", "size", "match");
+	for (k = 0; k < nimpls; k++) {
+		(void) printf(" %8s", impls[k]->si_name);
+	}
+	(void) printf("\n");
+
+	for (i = 0; i < nsizes; i++) {
+		h = place(sizes[i], &map, &len);
+		h2 = place(sizes[i], &map2, &len2);
+		if (h == NULL || h2 == NULL) {
+			(void) printf("# sweep: out of memory\n");
+			return;
+		}
+		for (j = 0; j < nwhere; j++) {
+			fill(h, h2, sizes[i], where[j]);
+			(void) printf("# %8lld %6s", sizes[i],
+			    optx == X_STRTOK ? "-" : wheres[where[j]]);
+			for (k = 0; k < nimpls; k++) {
+				(void) printf(" %8.2f",
+				    measure(impls[k], h, h2, sizes[i]));
+			}
+			(void) printf("\n");
+		}
+		(void) munmap(map, len);
+		(void) munmap(map2, len2);
+	}
+}
+
+int
+benchmark_finirun()
+{
+	if (optl != NULL || nwhere > 1 || nimpls > 1) {
+		sweep();
+	}
+
+	return (0);
+}
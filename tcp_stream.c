@@ -0,0 +1,449 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * bulk TCP bandwidth over loopback, one stream per thread,
+ * optionally with MSG_ZEROCOPY or TCP_CORK; Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/errqueue.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <errno.h>
+
+#include "libmicro.h"
+
+#ifndef SO_ZEROCOPY
+#define	SO_ZEROCOPY		60
+#endif
+#ifndef MSG_ZEROCOPY
+#define	MSG_ZEROCOPY		0x4000000
+#endif
+
+typedef struct {
+	int			ts_snd;
+	int			ts_rcv;
+	char			*ts_buf;
+	pthread_t		ts_thread;
+	long long		ts_bytes;	/* sent */
+	long long		ts_nsecs;	/* time spent sending */
+	long long		ts_cpu;		/* sender cpu nsecs */
+	long long		ts_rbytes;	/* received */
+	long long		ts_rcpu;	/* receiver cpu nsecs */
+	long long		ts_zsent;	/* zerocopy sends issued */
+	long long		ts_zdone;	/* ... and completed */
+	long long		ts_zcopied;	/* ... but copied anyway */
+} tsd_t;
+
+#define	DEFS			(64 * 1024)
+
+static long long		opts = DEFS;
+static int			optb = 0;
+static int			optr = 0;
+static int			optz = 0;
+static int			optc = 0;
+
+int prepare_stream(tsd_t *ts);
+int sendall(tsd_t *ts);
+int reap(tsd_t *ts, int wait);
+void *sink(void *arg);
+
+int
+benchmark_init()
+{
+	lm_defB = 64;
+	lm_tsdsize = sizeof (tsd_t);
+
+	(void) sprintf(lm_optstr, "b:cr:s:z");
+
+	(void) sprintf(lm_usage,
+	    "       [-b SO_SNDBUF bytes (default system)]\n"
+	    "       [-c] (set TCP_CORK, uncorking at the end of a batch)\n"
+	    "       [-r SO_RCVBUF bytes (default system)]\n"
+	    "       [-s message size (default %d)]\n"
+	    "       [-z] (send with MSG_ZEROCOPY and reap completions)\n"
+	    "notes: measures bulk send() over loopback TCP, one stream\n"
+	    "       per thread; reports aggregate Gb/sec and cpu nsecs\n"
+	    "       per KB on the sending and receiving sides\n",
+	    DEFS);
+
+	(void) sprintf(lm_header, "%8s %7s %7s %5s %7s %7s %7s",
+	    "size", "sndbuf", "rcvbuf", "flags", "Gb/sec", "snd/KB",
+	    "rcv/KB");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	switch (opt) {
+	case 'b':
+		optb = sizetoint(optarg);
+		break;
+	case 'c':
+		optc = 1;
+		break;
+	case 'r':
+		optr = sizetoint(optarg);
+		break;
+	case 's':
+		opts = sizetoll(optarg);
+		break;
+	case 'z':
+		optz = 1;
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+int
+benchmark_initrun()
+{
+	if (opts <= 0) {
+		(void) printf("ERROR: -s must be positive\n");
+		return (-1);
+	}
+
+	(void) setfdlimit(3 * lm_optT + 10);
+
+	return (0);
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	ts->ts_buf = valloc(opts);
+	if (ts->ts_buf == NULL) {
+		return (1);
+	}
+	(void) memset(ts->ts_buf, 'a', opts);
+
+	if (prepare_stream(ts) == -1) {
+		perror("prepare_stream");
+		return (1);
+	}
+
+	if (pthread_create(&ts->ts_thread, NULL, sink, ts) != 0) {
+		return (1);
+	}
+
+	return (0);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	long long		cpu = cputime();
+	int			opt;
+	int			i;
+
+	if (optc) {
+		opt = 1;
+		(void) setsockopt(ts->ts_snd, IPPROTO_TCP, TCP_CORK,
+		    &opt, sizeof (int));
+	}
+
+	for (i = 0; i < lm_optB; i++) {
+		if (sendall(ts) == -1) {
+			res->re_errors++;
+		}
+	}
+
+	if (optc) {
+		opt = 0;
+		(void) setsockopt(ts->ts_snd, IPPROTO_TCP, TCP_CORK,
+		    &opt, sizeof (int));
+	}
+
+	/* the buffers aren't ours again until the kernel says so */
+	if (optz && reap(ts, 1) == -1) {
+		res->re_errors++;
+	}
+
+	res->re_count = i;
+
+	ts->ts_bytes += (long long)i * opts;
+	ts->ts_nsecs += getnsecs() - res->re_t0;
+	ts->ts_cpu += cputime() - cpu;
+
+	return (0);
+}
+
+int
+benchmark_finiworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	(void) shutdown(ts->ts_snd, SHUT_WR);
+	(void) pthread_join(ts->ts_thread, NULL);
+	(void) close(ts->ts_snd);
+	(void) close(ts->ts_rcv);
+
+	return (0);
+}
+
+int
+benchmark_finirun()
+{
+	tsd_t			*ts;
+	long long		sent = 0;
+	long long		copied = 0;
+	int			p, t;
+
+	if (!optz) {
+		return (0);
+	}
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			sent += ts->ts_zdone;
+			copied += ts->ts_zcopied;
+		}
+	}
+
+	/* loopback has nowhere to DMA from, so expect copies here */
+	(void) printf("# MSG_ZEROCOPY: %lld of %lld completions were "
+	    "copied by the kernel\n", copied, sent);
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	char			flags[3];
+	tsd_t			*ts;
+	double			rate = 0.0;
+	long long		bytes = 0;
+	long long		cpu = 0;
+	long long		rbytes = 0;
+	long long		rcpu = 0;
+	int			p, t;
+
+	/* every stream runs independently, so their rates add up */
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			if (ts->ts_nsecs > 0) {
+				rate += (double)ts->ts_bytes * 8.0 /
+				    (double)ts->ts_nsecs;
+			}
+			bytes += ts->ts_bytes;
+			cpu += ts->ts_cpu;
+			rbytes += ts->ts_rbytes;
+			rcpu += ts->ts_rcpu;
+		}
+	}
+
+	flags[0] = optz ? 'z' : '-';
+	flags[1] = optc ? 'c' : '-';
+	flags[2] = 0;
+
+	(void) sprintf(result, "%8lld %7d %7d %5s %7.2f %7.1f %7.1f",
+	    opts, optb, optr, flags, rate,
+	    bytes ? (double)cpu * 1024.0 / (double)bytes : 0.0,
+	    rbytes ? (double)rcpu * 1024.0 / (double)rbytes : 0.0);
+
+	return (result);
+}
+
+/*
+ * send one message, waiting out the zerocopy notification limit
+ */
+int
+sendall(tsd_t *ts)
+{
+	size_t			done = 0;
+	ssize_t			n;
+
+	while (done < opts) {
+		n = send(ts->ts_snd, ts->ts_buf + done, opts - done,
+		    optz ? MSG_ZEROCOPY : 0);
+		if (n == -1) {
+			if (optz && errno == ENOBUFS) {
+				if (reap(ts, 1) == -1)
+					return (-1);
+				continue;
+			}
+			return (-1);
+		}
+		if (optz) {
+			ts->ts_zsent++;
+			/* keep the error queue short as we go */
+			(void) reap(ts, 0);
+		}
+		done += n;
+	}
+
+	return (0);
+}
+
+/*
+ * collect MSG_ZEROCOPY completions from the error queue; each
+ * notification covers the range of sends [ee_info, ee_data]
+ */
+int
+reap(tsd_t *ts, int wait)
+{
+	struct sock_extended_err *serr;
+	struct msghdr		msg;
+	struct cmsghdr		*cm;
+	struct pollfd		pfd;
+	char			control[128];
+
+	while (ts->ts_zdone < ts->ts_zsent) {
+		(void) memset(&msg, 0, sizeof (msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof (control);
+
+		if (recvmsg(ts->ts_snd, &msg, MSG_ERRQUEUE) == -1) {
+			if (errno != EAGAIN) {
+				return (-1);
+			}
+			if (!wait) {
+				break;
+			}
+			/* a pending error queue shows up as POLLERR */
+			pfd.fd = ts->ts_snd;
+			pfd.events = 0;
+			(void) poll(&pfd, 1, -1);
+			continue;
+		}
+
+		for (cm = CMSG_FIRSTHDR(&msg); cm != NULL;
+		    cm = CMSG_NXTHDR(&msg, cm)) {
+			serr = (struct sock_extended_err *)CMSG_DATA(cm);
+			if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+				continue;
+			}
+			ts->ts_zdone += serr->ee_data - serr->ee_info + 1;
+			if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+				ts->ts_zcopied += serr->ee_data -
+				    serr->ee_info + 1;
+			}
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * the receiver copies everything out, as a real one would
+ */
+void *
+sink(void *arg)
+{
+	tsd_t			*ts = (tsd_t *)arg;
+	long long		cpu = cputime();
+	char			*buf;
+	ssize_t			n;
+
+	if ((buf = malloc(opts)) == NULL) {
+		return (NULL);
+	}
+
+	while ((n = recv(ts->ts_rcv, buf, opts, 0)) > 0) {
+		ts->ts_rbytes += n;
+	}
+
+	ts->ts_rcpu = cputime() - cpu;
+	free(buf);
+
+	return (NULL);
+}
+
+int
+prepare_stream(tsd_t *ts)
+{
+	struct sockaddr_in	add;
+	socklen_t		size = sizeof (struct sockaddr_in);
+	int			opt = 1;
+	int			lsn;
+
+	lsn = socket(AF_INET, SOCK_STREAM, 0);
+	if (lsn == -1) {
+		return (-1);
+	}
+
+	/* buffer sizes must be set before the handshake fixes the scale */
+	if (optr && setsockopt(lsn, SOL_SOCKET, SO_RCVBUF,
+	    &optr, sizeof (int)) == -1) {
+		return (-1);
+	}
+
+	(void) memset(&add, 0, sizeof (struct sockaddr_in));
+	add.sin_family = AF_INET;
+	add.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(lsn, (struct sockaddr *)&add, size) == -1 ||
+	    getsockname(lsn, (struct sockaddr *)&add, &size) == -1 ||
+	    listen(lsn, 1) == -1) {
+		return (-1);
+	}
+
+	ts->ts_snd = socket(AF_INET, SOCK_STREAM, 0);
+	if (ts->ts_snd == -1) {
+		return (-1);
+	}
+
+	if (optb && setsockopt(ts->ts_snd, SOL_SOCKET, SO_SNDBUF,
+	    &optb, sizeof (int)) == -1) {
+		return (-1);
+	}
+
+	if (optz && setsockopt(ts->ts_snd, SOL_SOCKET, SO_ZEROCOPY,
+	    &opt, sizeof (int)) == -1) {
+		return (-1);
+	}
+
+	if (connect(ts->ts_snd, (struct sockaddr *)&add, size) == -1) {
+		return (-1);
+	}
+
+	ts->ts_rcv = accept(lsn, NULL, NULL);
+	(void) close(lsn);
+
+	return (ts->ts_rcv == -1 ? -1 : 0);
+}
@@ -0,0 +1,469 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * loopback UDP packet rate: sendto/recvfrom per packet against
+ * sendmmsg/recvmmsg or UDP GSO/GRO batches; Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libmicro.h"
+
+#ifndef UDP_SEGMENT
+#define	UDP_SEGMENT		103
+#endif
+#ifndef UDP_GRO
+#define	UDP_GRO			104
+#endif
+
+#define	MIN(x, y)		((x) > (y) ? (y) : (x))
+
+#define	MAXBATCH		1024	/* UIO_MAXIOV */
+#define	MAXSEGS			64	/* UDP_MAX_SEGMENTS */
+#define	MAXUDP			65507
+#define	RCVBUF			(4 * 1024 * 1024)
+
+typedef struct {
+	int			ts_snd;
+	int			ts_rcv;
+	struct sockaddr_in	ts_add;
+	char			*ts_buf;
+	struct mmsghdr		*ts_msgs;
+	struct iovec		*ts_iovs;
+	pthread_t		ts_thread;
+	long long		ts_pkts;	/* sent */
+	long long		ts_nsecs;	/* time spent sending */
+	long long		ts_rpkts;	/* received */
+	long long		ts_rcpu;	/* receiver cpu nsecs */
+} tsd_t;
+
+#define	DEFS			64
+
+static int			opts = DEFS;
+static int			optb = 1;
+static int			optm = 0;
+static int			optg = 0;
+static int			optr = 0;
+static int			port = 0;
+
+int prepare_udp(tsd_t *ts);
+int send_to(tsd_t *ts, int n);
+int send_mmsg(tsd_t *ts, int n);
+int send_gso(tsd_t *ts, int n);
+void *sink(void *arg);
+
+int
+benchmark_init()
+{
+	lm_defB = MAXBATCH;
+	lm_tsdsize = sizeof (tsd_t);
+
+	(void) sprintf(lm_optstr, "b:gmrs:");
+
+	(void) sprintf(lm_usage,
+	    "       [-b packets per batch (default 1, max %d)]\n"
+	    "       [-g] (one send per batch using UDP GSO, GRO on receive)\n"
+	    "       [-m] (use sendmmsg/recvmmsg instead of sendto/recvfrom)\n"
+	    "       [-r] (all receivers share one port with SO_REUSEPORT)\n"
+	    "       [-s payload size (default %d)]\n"
+	    "notes: each thread sends to its own receiving thread, or\n"
+	    "       to the shared port with -r; usecs/call is the cost\n"
+	    "       per packet sent, rcv%% the fraction that arrived\n",
+	    MAXBATCH, DEFS);
+
+	(void) sprintf(lm_header, "%6s %5s %4s %8s %6s %7s",
+	    "size", "batch", "how", "Mpkt/s", "rcv%", "rcv/pkt");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	switch (opt) {
+	case 'b':
+		optb = sizetoint(optarg);
+		break;
+	case 'g':
+		optg = 1;
+		break;
+	case 'm':
+		optm = 1;
+		break;
+	case 'r':
+		optr = 1;
+		break;
+	case 's':
+		opts = sizetoint(optarg);
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+int
+benchmark_initrun()
+{
+	struct sockaddr_in	add;
+	socklen_t		size = sizeof (struct sockaddr_in);
+	int			s;
+
+	if (opts <= 0 || opts > MAXUDP) {
+		(void) printf("ERROR: -s must be between 1 and %d\n", MAXUDP);
+		return (-1);
+	}
+	if (optb <= 0 || optb > MAXBATCH) {
+		(void) printf("ERROR: -b must be between 1 and %d\n",
+		    MAXBATCH);
+		return (-1);
+	}
+	if (optg && optm) {
+		(void) printf("ERROR: -g and -m are exclusive\n");
+		return (-1);
+	}
+	if (optg && (optb > MAXSEGS || (long long)optb * opts > MAXUDP)) {
+		(void) printf("ERROR: -g needs -b <= %d and -b * -s <= %d\n",
+		    MAXSEGS, MAXUDP);
+		return (-1);
+	}
+
+	(void) setfdlimit(3 * lm_optT + 10);
+
+	if (!optr) {
+		return (0);
+	}
+
+	/*
+	 * pick the shared port up front so that every process
+	 * binds the same one; nobody else should take it meanwhile
+	 */
+	if ((s = socket(AF_INET, SOCK_DGRAM, 0)) == -1) {
+		perror("socket");
+		return (-1);
+	}
+	(void) memset(&add, 0, sizeof (struct sockaddr_in));
+	add.sin_family = AF_INET;
+	add.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(s, (struct sockaddr *)&add, size) == -1 ||
+	    getsockname(s, (struct sockaddr *)&add, &size) == -1) {
+		perror("bind");
+		return (-1);
+	}
+	port = add.sin_port;
+	(void) close(s);
+
+	return (0);
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	int			i;
+
+	ts->ts_buf = malloc((size_t)opts * optb);
+	ts->ts_msgs = calloc(optb, sizeof (struct mmsghdr));
+	ts->ts_iovs = calloc(optb, sizeof (struct iovec));
+	if (ts->ts_buf == NULL || ts->ts_msgs == NULL ||
+	    ts->ts_iovs == NULL) {
+		return (1);
+	}
+	(void) memset(ts->ts_buf, 'a', (size_t)opts * optb);
+
+	if (prepare_udp(ts) == -1) {
+		perror("prepare_udp");
+		return (1);
+	}
+
+	for (i = 0; i < optb; i++) {
+		ts->ts_iovs[i].iov_base = ts->ts_buf + (size_t)i * opts;
+		ts->ts_iovs[i].iov_len = opts;
+		ts->ts_msgs[i].msg_hdr.msg_name = &ts->ts_add;
+		ts->ts_msgs[i].msg_hdr.msg_namelen =
+		    sizeof (struct sockaddr_in);
+		ts->ts_msgs[i].msg_hdr.msg_iov = &ts->ts_iovs[i];
+		ts->ts_msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	if (pthread_create(&ts->ts_thread, NULL, sink, ts) != 0) {
+		return (1);
+	}
+
+	return (0);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	int			i, n;
+
+	for (i = 0; i < lm_optB; i += n) {
+		n = MIN(optb, lm_optB - i);
+
+		if (optg) {
+			n = send_gso(ts, n);
+		} else if (optm) {
+			n = send_mmsg(ts, n);
+		} else {
+			n = send_to(ts, n);
+		}
+
+		if (n <= 0) {
+			res->re_errors++;
+			break;
+		}
+	}
+
+	res->re_count = i;
+
+	ts->ts_pkts += i;
+	ts->ts_nsecs += getnsecs() - res->re_t0;
+
+	return (0);
+}
+
+int
+benchmark_finiworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	/* not connected, so this fails, but still wakes the receiver */
+	(void) shutdown(ts->ts_rcv, SHUT_RD);
+	(void) pthread_join(ts->ts_thread, NULL);
+	(void) close(ts->ts_snd);
+	(void) close(ts->ts_rcv);
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	tsd_t			*ts;
+	double			rate = 0.0;
+	long long		pkts = 0;
+	long long		rpkts = 0;
+	long long		rcpu = 0;
+	int			p, t;
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			if (ts->ts_nsecs > 0) {
+				rate += (double)ts->ts_pkts * 1000.0 /
+				    (double)ts->ts_nsecs;
+			}
+			pkts += ts->ts_pkts;
+			rpkts += ts->ts_rpkts;
+			rcpu += ts->ts_rcpu;
+		}
+	}
+
+	(void) sprintf(result, "%6d %5d %4s %8.3f %6.1f %7.0f",
+	    opts, optb, optg ? "gso" : (optm ? "mmsg" : "to"), rate,
+	    pkts ? 100.0 * (double)rpkts / (double)pkts : 0.0,
+	    rpkts ? (double)rcpu / (double)rpkts : 0.0);
+
+	return (result);
+}
+
+int
+send_to(tsd_t *ts, int n)
+{
+	int			i;
+
+	for (i = 0; i < n; i++) {
+		if (sendto(ts->ts_snd, ts->ts_iovs[i].iov_base, opts, 0,
+		    (struct sockaddr *)&ts->ts_add,
+		    sizeof (struct sockaddr_in)) != opts) {
+			break;
+		}
+	}
+
+	return (i);
+}
+
+int
+send_mmsg(tsd_t *ts, int n)
+{
+	return (sendmmsg(ts->ts_snd, ts->ts_msgs, n, 0));
+}
+
+/*
+ * the socket has UDP_SEGMENT set, so the kernel cuts the
+ * buffer into opts sized datagrams on the way out
+ */
+int
+send_gso(tsd_t *ts, int n)
+{
+	size_t			len = (size_t)n * opts;
+
+	if (sendto(ts->ts_snd, ts->ts_buf, len, 0,
+	    (struct sockaddr *)&ts->ts_add,
+	    sizeof (struct sockaddr_in)) != len) {
+		return (-1);
+	}
+
+	return (n);
+}
+
+/*
+ * receive until shut down, counting datagrams; with GRO one
+ * read may return several, each gso_size long but the last
+ */
+void *
+sink(void *arg)
+{
+	tsd_t			*ts = (tsd_t *)arg;
+	long long		cpu = cputime();
+	struct mmsghdr		*msgs;
+	struct iovec		*iovs;
+	struct cmsghdr		*cm;
+	char			control[CMSG_SPACE(sizeof (int))];
+	char			*buf;
+	size_t			slot = optg ? MAXUDP : opts;
+	int			vlen = optm ? optb : 1;	/* as sent */
+	int			gso;
+	int			i, n;
+
+	buf = malloc(slot * vlen);
+	msgs = calloc(vlen, sizeof (struct mmsghdr));
+	iovs = calloc(vlen, sizeof (struct iovec));
+	if (buf == NULL || msgs == NULL || iovs == NULL) {
+		return (NULL);
+	}
+
+	for (i = 0; i < vlen; i++) {
+		iovs[i].iov_base = buf + slot * i;
+		iovs[i].iov_len = slot;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	for (;;) {
+		if (optm) {
+			n = recvmmsg(ts->ts_rcv, msgs, vlen, MSG_WAITFORONE,
+			    NULL);
+			if (n <= 0 || msgs[0].msg_len == 0) {
+				break;
+			}
+			ts->ts_rpkts += n;
+		} else if (optg) {
+			msgs[0].msg_hdr.msg_control = control;
+			msgs[0].msg_hdr.msg_controllen = sizeof (control);
+			n = recvmsg(ts->ts_rcv, &msgs[0].msg_hdr, 0);
+			if (n <= 0) {
+				break;
+			}
+			gso = n;
+			for (cm = CMSG_FIRSTHDR(&msgs[0].msg_hdr); cm != NULL;
+			    cm = CMSG_NXTHDR(&msgs[0].msg_hdr, cm)) {
+				if (cm->cmsg_level == SOL_UDP &&
+				    cm->cmsg_type == UDP_GRO) {
+					(void) memcpy(&gso, CMSG_DATA(cm),
+					    sizeof (int));
+				}
+			}
+			ts->ts_rpkts += (n + gso - 1) / gso;
+		} else {
+			n = recvfrom(ts->ts_rcv, buf, slot, 0, NULL, NULL);
+			if (n <= 0) {
+				break;
+			}
+			ts->ts_rpkts++;
+		}
+	}
+
+	ts->ts_rcpu = cputime() - cpu;
+
+	free(buf);
+	free(msgs);
+	free(iovs);
+
+	return (NULL);
+}
+
+int
+prepare_udp(tsd_t *ts)
+{
+	socklen_t		size = sizeof (struct sockaddr_in);
+	int			opt = 1;
+
+	ts->ts_rcv = socket(AF_INET, SOCK_DGRAM, 0);
+	ts->ts_snd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (ts->ts_rcv == -1 || ts->ts_snd == -1) {
+		return (-1);
+	}
+
+	/* best effort: capped at net.core.rmem_max */
+	opt = RCVBUF;
+	(void) setsockopt(ts->ts_rcv, SOL_SOCKET, SO_RCVBUF,
+	    &opt, sizeof (int));
+
+	opt = 1;
+	if (optr && setsockopt(ts->ts_rcv, SOL_SOCKET, SO_REUSEPORT,
+	    &opt, sizeof (int)) == -1) {
+		return (-1);
+	}
+
+	if (optg) {
+		if (setsockopt(ts->ts_rcv, SOL_UDP, UDP_GRO,
+		    &opt, sizeof (int)) == -1 ||
+		    setsockopt(ts->ts_snd, SOL_UDP, UDP_SEGMENT,
+		    &opts, sizeof (int)) == -1) {
+			return (-1);
+		}
+	}
+
+	(void) memset(&ts->ts_add, 0, sizeof (struct sockaddr_in));
+	ts->ts_add.sin_family = AF_INET;
+	ts->ts_add.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ts->ts_add.sin_port = port;
+
+	if (bind(ts->ts_rcv, (struct sockaddr *)&ts->ts_add, size) == -1 ||
+	    getsockname(ts->ts_rcv, (struct sockaddr *)&ts->ts_add,
+	    &size) == -1) {
+		return (-1);
+	}
+
+	return (0);
+}
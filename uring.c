@@ -0,0 +1,615 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * io_uring through the raw system calls: nops, file reads and
+ * writes, and loopback TCP send/recv, keeping up to -q operations
+ * in flight per thread; Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "libmicro.h"
+#include "ring.h"
+
+#define	MAXQ			256
+#define	DEFQ			1
+#define	DEFS			4096
+#define	DEFFSIZE		(16 * 1024 * 1024)
+
+#define	OP_NOP			0
+#define	OP_READ			1
+#define	OP_WRITE		2
+#define	OP_SEND			3
+#define	OP_RECV			4
+
+static char			*ops[] = {
+	"nop", "read", "write", "send", "recv", NULL
+};
+
+
+typedef struct {
+	ring_t			ts_ring;
+	int			ts_sock;	/* our end of the connection */
+	int			ts_peer;	/* the peer thread's end */
+	pthread_t		ts_thread;
+	long long		ts_off;
+	char			*ts_bufs[MAXQ];
+	long long		ts_t0[MAXQ];	/* when each slot went in */
+	int			ts_free[MAXQ];
+	int			ts_nfree;
+	long long		ts_ops;
+	long long		ts_nsecs;
+	long long		ts_lat;
+} tsd_t;
+
+static int			optx = OP_NOP;
+static char			*optf = NULL;
+static long long		opts = DEFS;
+static int			optq = DEFQ;
+static int			optb = 1;
+static int			optd = 0;
+static int			optr = 0;
+static int			optk = 0;
+static int			optp = 0;
+static int			fd = -1;
+static long long		fsize;
+static char			scratch[256];
+
+int ring_enter(ring_t *r, int submit, int wait);
+void prep(tsd_t *ts, int slot);
+int reap(tsd_t *ts, result_t *res);
+int prepare_socket(tsd_t *ts);
+void *peer(void *arg);
+
+int
+benchmark_init()
+{
+	lm_defB = 256;
+	lm_tsdsize = sizeof (tsd_t);
+
+	(void) sprintf(lm_optstr, "b:df:kpq:rs:x:");
+
+	(void) sprintf(lm_usage,
+	    "       [-b submissions per io_uring_enter (default 1)]\n"
+	    "       [-d] (open the file O_DIRECT)\n"
+	    "       [-f file (default scratch file of %d bytes)]\n"
+	    "       [-k] (register the buffers, use READ/WRITE_FIXED)\n"
+	    "       [-p] (submit through an SQPOLL kernel thread)\n"
+	    "       [-q queue depth (default %d, max %d)]\n"
+	    "       [-r] (register the file or socket)\n"
+	    "       [-s size (default %d)]\n"
+	    "       [-x nop|read|write|send|recv (default nop)]\n"
+	    "notes: measures io_uring; usecs/call is per operation,\n"
+	    "       lat_us from submission to completion; file offsets\n"
+	    "       walk the file sequentially, send and recv talk to a\n"
+	    "       peer thread over loopback TCP\n",
+	    DEFFSIZE, DEFQ, MAXQ, DEFS);
+
+	(void) sprintf(lm_header, "%5s %7s %4s %5s %5s %9s %8s",
+	    "op", "size", "qd", "batch", "flags", "IOPS", "lat_us");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	int			i;
+
+	switch (opt) {
+	case 'b':
+		optb = atoi(optarg);
+		break;
+	case 'd':
+		optd = 1;
+		break;
+	case 'f':
+		optf = optarg;
+		break;
+	case 'k':
+		optk = 1;
+		break;
+	case 'p':
+		optp = 1;
+		break;
+	case 'q':
+		optq = atoi(optarg);
+		break;
+	case 'r':
+		optr = 1;
+		break;
+	case 's':
+		opts = sizetoll(optarg);
+		break;
+	case 'x':
+		for (i = 0; ops[i] != NULL; i++) {
+			if (strcmp(optarg, ops[i]) == 0) {
+				break;
+			}
+		}
+		if (ops[i] == NULL) {
+			return (-1);
+		}
+		optx = i;
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+int
+benchmark_initrun()
+{
+	struct io_uring_params	p;
+	struct stat		st;
+	char			*buf;
+	long long		i;
+	int			probe;
+
+	if (optq <= 0 || optq > MAXQ) {
+		(void) printf("ERROR: -q must be between 1 and %d\n", MAXQ);
+		return (-1);
+	}
+	if (optb <= 0 || optb > optq) {
+		(void) printf("ERROR: -b must be between 1 and -q\n");
+		return (-1);
+	}
+	if (opts <= 0) {
+		(void) printf("ERROR: -s must be positive\n");
+		return (-1);
+	}
+	if (optk && optx != OP_READ && optx != OP_WRITE) {
+		(void) printf("ERROR: -k applies to read and write only\n");
+		return (-1);
+	}
+
+	/* seccomp or kernel.io_uring_disabled may forbid it outright */
+	(void) memset(&p, 0, sizeof (p));
+	if ((probe = syscall(__NR_io_uring_setup, 1, &p)) == -1) {
+		(void) printf(
+		    "#\n"
+		    "# benchmark uring skipped: io_uring_setup: %s\n"
+		    "#\n",
+		    strerror(errno));
+		exit(0);
+	}
+	(void) close(probe);
+
+	(void) setfdlimit(4 * lm_optT + 10);
+
+	if (optx != OP_READ && optx != OP_WRITE) {
+		return (0);
+	}
+
+	if (optf == NULL) {
+		fsize = opts > DEFFSIZE ? opts : DEFFSIZE;
+
+		(void) strcpy(scratch, "/var/tmp/uring.XXXXXX");
+		if ((fd = mkstemp(scratch)) == -1 ||
+		    (buf = calloc(1, 1024 * 1024)) == NULL) {
+			perror("scratch file");
+			return (-1);
+		}
+		for (i = 0; i < fsize; i += 1024 * 1024) {
+			if (write(fd, buf, 1024 * 1024) == -1) {
+				perror("scratch file");
+				return (-1);
+			}
+		}
+		free(buf);
+		(void) close(fd);
+		optf = scratch;
+	}
+
+	fd = open(optf, (optx == OP_READ ? O_RDONLY : O_WRONLY) |
+	    (optd ? O_DIRECT : 0));
+	if (fd == -1 || fstat(fd, &st) == -1) {
+		perror(optf);
+		return (-1);
+	}
+
+	fsize = st.st_size - st.st_size % opts;
+	if (fsize < opts) {
+		(void) printf("ERROR: %s is smaller than -s\n", optf);
+		return (-1);
+	}
+
+	return (0);
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	struct iovec		iov[MAXQ];
+	int			target = fd;
+	int			i;
+
+	for (i = 0; i < optq; i++) {
+		/* aligned, so that O_DIRECT is happy */
+		if ((ts->ts_bufs[i] = valloc(opts)) == NULL) {
+			return (1);
+		}
+		(void) memset(ts->ts_bufs[i], 'a', opts);
+		iov[i].iov_base = ts->ts_bufs[i];
+		iov[i].iov_len = opts;
+		ts->ts_free[i] = i;
+	}
+	ts->ts_nfree = optq;
+
+	if (ring_setup(&ts->ts_ring, optq,
+	    optp ? IORING_SETUP_SQPOLL : 0) == -1) {
+		perror("io_uring_setup");
+		return (1);
+	}
+
+	if (optx == OP_SEND || optx == OP_RECV) {
+		if (prepare_socket(ts) == -1) {
+			perror("prepare_socket");
+			return (1);
+		}
+		if (pthread_create(&ts->ts_thread, NULL, peer, ts) != 0) {
+			return (1);
+		}
+		target = ts->ts_sock;
+	}
+
+	if (optr && syscall(__NR_io_uring_register, ts->ts_ring.r_fd,
+	    IORING_REGISTER_FILES, &target, 1) == -1) {
+		perror("IORING_REGISTER_FILES");
+		return (1);
+	}
+
+	if (optk && syscall(__NR_io_uring_register, ts->ts_ring.r_fd,
+	    IORING_REGISTER_BUFFERS, iov, optq) == -1) {
+		perror("IORING_REGISTER_BUFFERS");
+		return (1);
+	}
+
+	return (0);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	int			issued = 0;
+	int			done = 0;
+	int			queued, wait;
+
+	while (done < lm_optB) {
+		for (queued = 0; ts->ts_nfree > 0 && queued < optb &&
+		    issued + queued < lm_optB; queued++) {
+			prep(ts, ts->ts_free[--ts->ts_nfree]);
+		}
+
+		/* only block once the queue is full or nothing's left */
+		wait = ts->ts_nfree == 0 || issued + queued == lm_optB;
+
+		if ((queued || wait) && ring_enter(&ts->ts_ring,
+		    queued, wait) == -1) {
+			res->re_errors++;
+			break;
+		}
+		issued += queued;
+
+		done += reap(ts, res);
+	}
+	res->re_count = done;
+
+	ts->ts_ops += done;
+	ts->ts_nsecs += getnsecs() - res->re_t0;
+
+	return (0);
+}
+
+int
+benchmark_finiworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	if (optx == OP_SEND) {
+		(void) shutdown(ts->ts_sock, SHUT_WR);
+		(void) pthread_join(ts->ts_thread, NULL);
+		(void) close(ts->ts_sock);
+		(void) close(ts->ts_peer);
+	} else if (optx == OP_RECV) {
+		/*
+		 * with -r the ring holds the socket too, so closing it
+		 * needn't reset the connection; fail the peer's send on
+		 * its own end instead
+		 */
+		(void) shutdown(ts->ts_peer, SHUT_RDWR);
+		(void) pthread_join(ts->ts_thread, NULL);
+		(void) close(ts->ts_sock);
+		(void) close(ts->ts_peer);
+	}
+
+	(void) close(ts->ts_ring.r_fd);
+
+	return (0);
+}
+
+int
+benchmark_finirun()
+{
+	if (scratch[0] != 0) {
+		(void) unlink(scratch);
+	}
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	char			flags[5];
+	tsd_t			*ts;
+	double			iops = 0.0;
+	long long		n = 0;
+	long long		lat = 0;
+	int			p, t;
+
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			if (ts->ts_nsecs > 0) {
+				iops += (double)ts->ts_ops * 1.0e9 /
+				    (double)ts->ts_nsecs;
+			}
+			n += ts->ts_ops;
+			lat += ts->ts_lat;
+		}
+	}
+
+	flags[0] = optd ? 'd' : '-';
+	flags[1] = optr ? 'r' : '-';
+	flags[2] = optk ? 'k' : '-';
+	flags[3] = optp ? 'p' : '-';
+	flags[4] = 0;
+
+	(void) sprintf(result, "%5s %7lld %4d %5d %5s %9.0f %8.2f",
+	    ops[optx], opts, optq, optb, flags, iops,
+	    n ? (double)lat / (double)n / 1000.0 : 0.0);
+
+	return (result);
+}
+
+/*
+ * fill in the next submission queue entry for a slot
+ */
+void
+prep(tsd_t *ts, int slot)
+{
+	ring_t			*r = &ts->ts_ring;
+	struct io_uring_sqe	*sqe;
+	unsigned		tail = *r->r_sqtail;
+	unsigned		idx = tail & *r->r_sqmask;
+
+	sqe = &r->r_sqes[idx];
+	(void) memset(sqe, 0, sizeof (*sqe));
+
+	switch (optx) {
+	case OP_NOP:
+		sqe->opcode = IORING_OP_NOP;
+		break;
+	case OP_READ:
+	case OP_WRITE:
+		if (optk) {
+			sqe->opcode = optx == OP_READ ?
+			    IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+			sqe->buf_index = slot;
+		} else {
+			sqe->opcode = optx == OP_READ ?
+			    IORING_OP_READ : IORING_OP_WRITE;
+		}
+		sqe->fd = fd;
+		sqe->off = ts->ts_off;
+		ts->ts_off += opts;
+		if (ts->ts_off >= fsize) {
+			ts->ts_off = 0;
+		}
+		break;
+	case OP_SEND:
+		sqe->opcode = IORING_OP_SEND;
+		sqe->fd = ts->ts_sock;
+		sqe->msg_flags = MSG_WAITALL;
+		break;
+	case OP_RECV:
+		sqe->opcode = IORING_OP_RECV;
+		sqe->fd = ts->ts_sock;
+		sqe->msg_flags = MSG_WAITALL;
+		break;
+	}
+
+	if (optx != OP_NOP) {
+		sqe->addr = (unsigned long)ts->ts_bufs[slot];
+		sqe->len = opts;
+	}
+
+	/* registered files are named by their index, and we have one */
+	if (optr && optx != OP_NOP) {
+		sqe->fd = 0;
+		sqe->flags |= IOSQE_FIXED_FILE;
+	}
+
+	sqe->user_data = slot;
+	r->r_sqarray[idx] = idx;
+	ts->ts_t0[slot] = getnsecs();
+
+	__atomic_store_n(r->r_sqtail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * collect whatever has completed, returning the slots
+ */
+int
+reap(tsd_t *ts, result_t *res)
+{
+	ring_t			*r = &ts->ts_ring;
+	struct io_uring_cqe	*cqe;
+	unsigned		head = *r->r_cqhead;
+	unsigned		tail;
+	long long		now = getnsecs();
+	int			n = 0;
+	int			slot;
+
+	tail = __atomic_load_n(r->r_cqtail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; head++, n++) {
+		cqe = &r->r_cqes[head & *r->r_cqmask];
+		slot = (int)cqe->user_data;
+
+		if (cqe->res < 0 ||
+		    (optx != OP_NOP && cqe->res != opts)) {
+			res->re_errors++;
+		}
+
+		ts->ts_lat += now - ts->ts_t0[slot];
+		ts->ts_free[ts->ts_nfree++] = slot;
+	}
+
+	__atomic_store_n(r->r_cqhead, head, __ATOMIC_RELEASE);
+
+	return (n);
+}
+
+/*
+ * submit what's been queued and optionally wait for a completion;
+ * with SQPOLL the kernel thread picks up the queue by itself and
+ * only needs a nudge once it has gone idle
+ */
+int
+ring_enter(ring_t *r, int submit, int wait)
+{
+	unsigned		flags = wait ? IORING_ENTER_GETEVENTS : 0;
+
+	if (optp) {
+		/*
+		 * the tail we published must be seen before we look at
+		 * the flags, or the thread may go idle without seeing
+		 * it while we read a stale flag and don't wake it
+		 */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (submit && (__atomic_load_n(r->r_sqflags,
+		    __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP)) {
+			flags |= IORING_ENTER_SQ_WAKEUP;
+		}
+		if (flags == 0) {
+			return (0);
+		}
+		submit = 0;
+	}
+
+	for (;;) {
+		if (syscall(__NR_io_uring_enter, r->r_fd, submit,
+		    wait, flags, NULL, 0) != -1) {
+			return (0);
+		}
+		if (errno != EINTR) {
+			return (-1);
+		}
+	}
+}
+
+
+/*
+ * the other end of the connection: a sink for send, a source
+ * for recv, running until the benchmark thread hangs up
+ */
+void *
+peer(void *arg)
+{
+	tsd_t			*ts = (tsd_t *)arg;
+	char			*buf;
+
+	if ((buf = calloc(1, opts)) == NULL) {
+		return (NULL);
+	}
+
+	if (optx == OP_SEND) {
+		while (recv(ts->ts_peer, buf, opts, MSG_TRUNC) > 0)
+			;
+	} else {
+		while (send(ts->ts_peer, buf, opts, MSG_NOSIGNAL) > 0)
+			;
+	}
+
+	free(buf);
+
+	return (NULL);
+}
+
+int
+prepare_socket(tsd_t *ts)
+{
+	struct sockaddr_in	add;
+	socklen_t		size = sizeof (struct sockaddr_in);
+	int			lsn;
+
+	if ((lsn = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+		return (-1);
+	}
+
+	(void) memset(&add, 0, sizeof (struct sockaddr_in));
+	add.sin_family = AF_INET;
+	add.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(lsn, (struct sockaddr *)&add, size) == -1 ||
+	    getsockname(lsn, (struct sockaddr *)&add, &size) == -1 ||
+	    listen(lsn, 1) == -1) {
+		return (-1);
+	}
+
+	if ((ts->ts_sock = socket(AF_INET, SOCK_STREAM, 0)) == -1 ||
+	    connect(ts->ts_sock, (struct sockaddr *)&add, size) == -1) {
+		return (-1);
+	}
+
+	ts->ts_peer = accept(lsn, NULL, NULL);
+	(void) close(lsn);
+
+	return (ts->ts_peer == -1 ? -1 : 0);
+}
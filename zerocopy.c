@@ -0,0 +1,548 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms
+ * of the Common Development and Distribution License
+ * (the "License").  You may not use this file except
+ * in compliance with the License.
+ *
+ * You can obtain a copy of the license at
+ * src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing
+ * permissions and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL
+ * HEADER in each file and include the License file at
+ * usr/src/OPENSOLARIS.LICENSE.  If applicable,
+ * add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your
+ * own identifying information: Portions Copyright [yyyy]
+ * [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * zero-copy data paths (sendfile, splice, vmsplice, tee and
+ * copy_file_range) against the read()/write() loop doing the
+ * same job; Linux only
+ */
+
+#define	_GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "libmicro.h"
+
+typedef struct {
+	int			ts_in;		/* file we read from */
+	int			ts_out;		/* scratch file we write to */
+	int			ts_sock;	/* our end of the connection */
+	int			ts_peer;	/* sink's or source's end */
+	int			ts_null;
+	int			ts_pa[2];
+	int			ts_pb[2];
+	off_t			ts_off;
+	char			*ts_buf;
+	pthread_t		ts_thread;
+	long long		ts_bytes;
+	long long		ts_nsecs;
+} tsd_t;
+
+static char			*paths[] = {"sendfile", "splice", "splicein",
+				    "vmsplice", "tee", "cfr", NULL};
+#define	ZC_SENDFILE		0	/* file -> socket */
+#define	ZC_SPLICE		1	/* file -> pipe -> socket */
+#define	ZC_SPLICEIN		2	/* socket -> pipe -> file */
+#define	ZC_VMSPLICE		3	/* memory -> pipe -> socket */
+#define	ZC_TEE			4	/* memory -> pipe -> socket + /dev/null */
+#define	ZC_CFR			5	/* file -> file */
+
+#define	DEFS			(64 * 1024)
+#define	DEFX			ZC_SENDFILE
+#define	DEFFSIZE		(16 * 1024 * 1024)
+
+static long long		opts = DEFS;
+static int			optx = DEFX;
+static int			optc = 0;
+static char			*optf = NULL;
+static char			scratch[256];
+static off_t			fsize;
+
+int lookup(char *x, char *names[]);
+int prepare_socket(tsd_t *ts);
+int move(tsd_t *ts);
+int copy(tsd_t *ts);
+int drain(int from, int to, loff_t *off, size_t len);
+void *sink(void *arg);
+void *source(void *arg);
+
+int
+benchmark_init()
+{
+	lm_defB = 64;
+	lm_tsdsize = sizeof (tsd_t);
+
+	(void) sprintf(lm_optstr, "cf:s:x:");
+
+	(void) sprintf(lm_usage,
+	    "       [-c] (copy with the equivalent read()/write() loop)\n"
+	    "       [-f file (default scratch file of %d bytes)]\n"
+	    "       [-s bytes per operation (default %d)]\n"
+	    "       [-x path (sendfile|splice|splicein|vmsplice|tee|cfr,"
+	    " default %s)]\n"
+	    "notes: measures zero-copy data movement; sendfile and\n"
+	    "       splice send file data to a loopback TCP socket,\n"
+	    "       splicein receives into a file, vmsplice and tee\n"
+	    "       send user memory (tee also duplicates it to\n"
+	    "       /dev/null) and cfr is copy_file_range() between\n"
+	    "       files.  -c does the same with read()/write()\n",
+	    DEFFSIZE, DEFS, paths[DEFX]);
+
+	(void) sprintf(lm_header, "%8s %8s %4s %9s",
+	    "size", "path", "how", "MB/sec");
+
+	return (0);
+}
+
+int
+benchmark_optswitch(int opt, char *optarg)
+{
+	switch (opt) {
+	case 'c':
+		optc = 1;
+		break;
+	case 'f':
+		optf = optarg;
+		break;
+	case 's':
+		opts = sizetoll(optarg);
+		break;
+	case 'x':
+		optx = lookup(optarg, paths);
+		if (optx == -1)
+			return (-1);
+		break;
+	default:
+		return (-1);
+	}
+	return (0);
+}
+
+int
+benchmark_initrun()
+{
+	struct stat		st;
+	char			*buf;
+	long long		i;
+	int			fd;
+
+	if (opts <= 0) {
+		(void) printf("ERROR: -s must be positive\n");
+		return (-1);
+	}
+
+	if (optf == NULL) {
+		/* make a file big enough to stay clear of readahead edges */
+		fsize = opts > DEFFSIZE ? opts : DEFFSIZE;
+
+		(void) strcpy(scratch, "/tmp/zerocopy.XXXXXX");
+		if ((fd = mkstemp(scratch)) == -1 ||
+		    (buf = calloc(1, 1024 * 1024)) == NULL) {
+			perror("scratch file");
+			return (-1);
+		}
+		for (i = 0; i < fsize; i += 1024 * 1024) {
+			if (write(fd, buf, 1024 * 1024) == -1) {
+				perror("scratch file");
+				return (-1);
+			}
+		}
+		fsize = i;
+		free(buf);
+		(void) close(fd);
+		optf = scratch;
+	}
+
+	if (stat(optf, &st) == -1 || !S_ISREG(st.st_mode)) {
+		(void) printf("ERROR: %s is not a regular file\n", optf);
+		return (-1);
+	}
+	fsize = st.st_size;
+
+	if (fsize < opts) {
+		(void) printf("ERROR: %s is smaller than -s\n", optf);
+		return (-1);
+	}
+
+	(void) setfdlimit(9 * lm_optT + 10);
+
+	return (0);
+}
+
+int
+benchmark_initworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	char			path[1024];
+	int			size = opts;
+
+	ts->ts_in = open(optf, O_RDONLY);
+	if (ts->ts_in == -1) {
+		perror(optf);
+		return (1);
+	}
+
+	/* output goes next to the input so cfr can stay on one fs */
+	(void) sprintf(path, "%.1000s.XXXXXX", optf);
+	ts->ts_out = mkstemp(path);
+	if (ts->ts_out == -1) {
+		perror(path);
+		return (1);
+	}
+	(void) unlink(path);
+
+	ts->ts_null = open("/dev/null", O_WRONLY);
+
+	ts->ts_buf = valloc(opts);
+	if (ts->ts_buf == NULL) {
+		return (1);
+	}
+	(void) memset(ts->ts_buf, 'a', opts);
+
+	/* let a whole operation fit in the pipes where we may */
+	if (pipe(ts->ts_pa) == -1 || pipe(ts->ts_pb) == -1) {
+		return (1);
+	}
+	(void) fcntl(ts->ts_pa[1], F_SETPIPE_SZ, size);
+	(void) fcntl(ts->ts_pb[1], F_SETPIPE_SZ, size);
+
+	if (optx != ZC_CFR) {
+		if (prepare_socket(ts) == -1) {
+			perror("socket");
+			return (1);
+		}
+		if (pthread_create(&ts->ts_thread, NULL,
+		    optx == ZC_SPLICEIN ? source : sink, ts) != 0) {
+			return (1);
+		}
+	}
+
+	return (0);
+}
+
+int
+benchmark(void *tsd, result_t *res)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+	int			i;
+
+	for (i = 0; i < lm_optB; i++) {
+		if ((optc ? copy(ts) : move(ts)) == -1) {
+			res->re_errors++;
+		}
+
+		ts->ts_off += opts;
+		if (ts->ts_off + opts > fsize) {
+			ts->ts_off = 0;
+		}
+	}
+	res->re_count = i;
+
+	ts->ts_bytes += (long long)i * opts;
+	ts->ts_nsecs += getnsecs() - res->re_t0;
+
+	return (0);
+}
+
+int
+benchmark_finiworker(void *tsd)
+{
+	tsd_t			*ts = (tsd_t *)tsd;
+
+	if (optx == ZC_SPLICEIN) {
+		/* closing with unread data resets the source's send() */
+		(void) close(ts->ts_sock);
+		(void) pthread_join(ts->ts_thread, NULL);
+		(void) close(ts->ts_peer);
+	} else if (optx != ZC_CFR) {
+		/* and the sink sees EOF */
+		(void) shutdown(ts->ts_sock, SHUT_WR);
+		(void) pthread_join(ts->ts_thread, NULL);
+		(void) close(ts->ts_sock);
+		(void) close(ts->ts_peer);
+	}
+
+	(void) close(ts->ts_in);
+	(void) close(ts->ts_out);
+	(void) close(ts->ts_null);
+	(void) close(ts->ts_pa[0]);
+	(void) close(ts->ts_pa[1]);
+	(void) close(ts->ts_pb[0]);
+	(void) close(ts->ts_pb[1]);
+
+	return (0);
+}
+
+int
+benchmark_finirun()
+{
+	if (scratch[0] != 0) {
+		(void) unlink(scratch);
+	}
+
+	return (0);
+}
+
+char *
+benchmark_result()
+{
+	static char		result[256];
+	tsd_t			*ts;
+	double			rate = 0.0;
+	int			p, t;
+
+	/* each thread moves its own data, so their rates add up */
+	for (p = 0; p < lm_optP; p++) {
+		for (t = 0; t < lm_optT; t++) {
+			ts = (tsd_t *)gettsd(p, t);
+			if (ts->ts_nsecs > 0) {
+				rate += (double)ts->ts_bytes * 1.0e9 /
+				    (double)ts->ts_nsecs;
+			}
+		}
+	}
+
+	(void) sprintf(result, "%8lld %8s %4s %9.1f",
+	    opts, paths[optx], optc ? "copy" : "zero",
+	    rate / (1024.0 * 1024.0));
+
+	return (result);
+}
+
+/*
+ * move one operation's worth of data without it passing
+ * through user space
+ */
+int
+move(tsd_t *ts)
+{
+	off_t			soff = ts->ts_off;
+	loff_t			off = ts->ts_off;
+	loff_t			out = ts->ts_off;
+	struct iovec		iov;
+	size_t			left = opts;
+	ssize_t			n;
+
+	while (left > 0) {
+		switch (optx) {
+		case ZC_SENDFILE:
+			n = sendfile(ts->ts_sock, ts->ts_in, &soff, left);
+			break;
+		case ZC_SPLICE:
+			n = splice(ts->ts_in, &off, ts->ts_pa[1], NULL, left,
+			    SPLICE_F_MOVE);
+			if (n > 0 &&
+			    drain(ts->ts_pa[0], ts->ts_sock, NULL, n) == -1)
+				return (-1);
+			break;
+		case ZC_SPLICEIN:
+			n = splice(ts->ts_sock, NULL, ts->ts_pa[1], NULL, left,
+			    SPLICE_F_MOVE);
+			if (n > 0 &&
+			    drain(ts->ts_pa[0], ts->ts_out, &out, n) == -1)
+				return (-1);
+			break;
+		case ZC_VMSPLICE:
+			/* the pages are a gift; the pipe may steal them */
+			iov.iov_base = ts->ts_buf + opts - left;
+			iov.iov_len = left;
+			n = vmsplice(ts->ts_pa[1], &iov, 1, SPLICE_F_GIFT);
+			if (n > 0 &&
+			    drain(ts->ts_pa[0], ts->ts_sock, NULL, n) == -1)
+				return (-1);
+			break;
+		case ZC_TEE:
+			iov.iov_base = ts->ts_buf + opts - left;
+			iov.iov_len = left;
+			n = vmsplice(ts->ts_pa[1], &iov, 1, 0);
+			if (n <= 0)
+				break;
+			/* the pipes are the same size so tee takes it all */
+			if (tee(ts->ts_pa[0], ts->ts_pb[1], n, 0) != n ||
+			    drain(ts->ts_pa[0], ts->ts_sock, NULL, n) == -1 ||
+			    drain(ts->ts_pb[0], ts->ts_null, NULL, n) == -1)
+				return (-1);
+			break;
+		case ZC_CFR:
+		default:
+			n = copy_file_range(ts->ts_in, &off, ts->ts_out, &out,
+			    left, 0);
+			break;
+		}
+
+		if (n <= 0) {
+			return (-1);
+		}
+		left -= n;
+	}
+
+	return (0);
+}
+
+/*
+ * the same job the way it is done without the zero-copy calls
+ */
+int
+copy(tsd_t *ts)
+{
+	size_t			len = opts;
+
+	switch (optx) {
+	case ZC_SENDFILE:
+	case ZC_SPLICE:
+		if (pread(ts->ts_in, ts->ts_buf, len, ts->ts_off) != len ||
+		    write(ts->ts_sock, ts->ts_buf, len) != len)
+			return (-1);
+		break;
+	case ZC_SPLICEIN:
+		if (recv(ts->ts_sock, ts->ts_buf, len, MSG_WAITALL) != len ||
+		    pwrite(ts->ts_out, ts->ts_buf, len, ts->ts_off) != len)
+			return (-1);
+		break;
+	case ZC_VMSPLICE:
+		if (write(ts->ts_sock, ts->ts_buf, len) != len)
+			return (-1);
+		break;
+	case ZC_TEE:
+		if (write(ts->ts_sock, ts->ts_buf, len) != len ||
+		    write(ts->ts_null, ts->ts_buf, len) != len)
+			return (-1);
+		break;
+	case ZC_CFR:
+	default:
+		if (pread(ts->ts_in, ts->ts_buf, len, ts->ts_off) != len ||
+		    pwrite(ts->ts_out, ts->ts_buf, len, ts->ts_off) != len)
+			return (-1);
+		break;
+	}
+
+	return (0);
+}
+
+/*
+ * splice len bytes out of a pipe; off is only for files
+ */
+int
+drain(int from, int to, loff_t *off, size_t len)
+{
+	ssize_t			n;
+
+	while (len > 0) {
+		n = splice(from, NULL, to, off, len,
+		    SPLICE_F_MOVE | SPLICE_F_MORE);
+		if (n <= 0) {
+			return (-1);
+		}
+		len -= n;
+	}
+
+	return (0);
+}
+
+/*
+ * the far end of the connection; the sink throws data away
+ * without copying it (MSG_TRUNC on TCP), the source keeps the
+ * socket full
+ */
+void *
+sink(void *arg)
+{
+	tsd_t			*ts = (tsd_t *)arg;
+
+	while (recv(ts->ts_peer, NULL, 1024 * 1024, MSG_TRUNC) > 0)
+		;
+
+	return (NULL);
+}
+
+void *
+source(void *arg)
+{
+	tsd_t			*ts = (tsd_t *)arg;
+	char			*buf;
+
+	if ((buf = calloc(1, opts)) == NULL) {
+		return (NULL);
+	}
+
+	while (send(ts->ts_peer, buf, opts, MSG_NOSIGNAL) > 0)
+		;
+
+	free(buf);
+
+	return (NULL);
+}
+
+int
+prepare_socket(tsd_t *ts)
+{
+	struct sockaddr_in	add;
+	socklen_t		size = sizeof (struct sockaddr_in);
+	int			lsn;
+
+	lsn = socket(AF_INET, SOCK_STREAM, 0);
+	if (lsn == -1) {
+		return (-1);
+	}
+
+	/* let the kernel pick the port, there may be many of us */
+	(void) memset(&add, 0, sizeof (struct sockaddr_in));
+	add.sin_family = AF_INET;
+	add.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(lsn, (struct sockaddr *)&add, size) == -1 ||
+	    getsockname(lsn, (struct sockaddr *)&add, &size) == -1 ||
+	    listen(lsn, 1) == -1) {
+		return (-1);
+	}
+
+	ts->ts_sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (ts->ts_sock == -1 ||
+	    connect(ts->ts_sock, (struct sockaddr *)&add, size) == -1) {
+		return (-1);
+	}
+
+	ts->ts_peer = accept(lsn, NULL, NULL);
+	(void) close(lsn);
+
+	return (ts->ts_peer == -1 ? -1 : 0);
+}
+
+int
+lookup(char *x, char *names[])
+{
+	int			i = 0;
+
+	while (names[i] != NULL) {
+		if (strcmp(names[i], x) == 0) {
+			return (i);
+		}
+		i++;
+	}
+	return (-1);
+}